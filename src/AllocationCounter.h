@@ -0,0 +1,22 @@
+#ifndef GEGELATI_TETRIS_ALLOCATIONCOUNTER_H
+#define GEGELATI_TETRIS_ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+/**
+ * \brief Counters of the allocations made through the global operator new.
+ *
+ * Linking AllocationCounter.cpp replaces all the global operator new and operator delete, including the array,
+ * nothrow and aligned ones, with versions counting the allocations and allocated bytes before calling malloc. The
+ * replacements live in their own translation unit, so that they are never inlined in their callers.
+ */
+namespace AllocationCounter {
+    /// Number of allocations since the beginning of the program.
+    uint64_t getNbAllocations();
+
+    /// Number of bytes allocated since the beginning of the program.
+    uint64_t getNbAllocatedBytes();
+}
+
+
+#endif //GEGELATI_TETRIS_ALLOCATIONCOUNTER_H
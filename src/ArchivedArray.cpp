@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "ArchivedArray.h"
+
+std::mutex PackedValues::internedMutex;
+
+std::unordered_multimap<size_t, const PackedValues*> PackedValues::interned;
+
+size_t PackedValues::internedBytes = 0;
+
+PackedValues::Pointer::Pointer(const PackedValues* values) : values(values) {}
+
+PackedValues::Pointer::Pointer(const Pointer& other) : values(other.values) {
+    if(this->values != nullptr)
+        this->values->nbReferences.fetch_add(1, std::memory_order_relaxed);
+}
+
+PackedValues::Pointer& PackedValues::Pointer::operator=(const Pointer& other) {
+    if(other.values != nullptr)
+        other.values->nbReferences.fetch_add(1, std::memory_order_relaxed);
+    if(this->values != nullptr)
+        this->values->release();
+    this->values = other.values;
+    return *this;
+}
+
+PackedValues::Pointer::~Pointer() {
+    if(this->values != nullptr)
+        this->values->release();
+}
+
+PackedValues::PackedValues(uint32_t nbValues, uint16_t width, uint8_t bitsPerValue, size_t hash) : nbReferences(1),
+        nbValues(nbValues), width(width), bitsPerValue(bitsPerValue), hash(hash) {}
+
+size_t PackedValues::getNbWords(size_t nbValues, uint8_t bitsPerValue) {
+    return std::max<size_t>(1, (nbValues * bitsPerValue + 63) / 64);
+}
+
+size_t PackedValues::size() const {
+    return this->nbValues;
+}
+
+size_t PackedValues::getWidth() const {
+    return this->width;
+}
+
+void PackedValues::release() const {
+    if(this->nbReferences.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    // Interned values without reference are never returned by pack(), so they can't be referenced again
+    const size_t size = sizeof(PackedValues) + getNbWords(this->nbValues, this->bitsPerValue) * sizeof(uint64_t);
+    {
+        std::lock_guard<std::mutex> lock(internedMutex);
+        auto range = interned.equal_range(this->hash);
+        for(auto entry = range.first; entry != range.second; entry++){
+            if(entry->second == this){
+                interned.erase(entry);
+                break;
+            }
+        }
+        internedBytes -= size;
+    }
+
+    this->~PackedValues();
+    ::operator delete((void*)this);
+}
+
+PackedValues::Pointer PackedValues::pack(const uint32_t* values, size_t nbValues, size_t width) {
+    if(width == 0 || width > UINT16_MAX || nbValues % width != 0 || nbValues > UINT32_MAX)
+        throw std::runtime_error("Can't pack " + std::to_string(nbValues) + " values in rows of "
+                                 + std::to_string(width) + ".");
+
+    uint32_t maxValue = 0;
+    for(size_t i = 0; i < nbValues; i++)
+        maxValue = std::max(maxValue, values[i]);
+    if(maxValue > MAX_VALUE)
+        throw std::runtime_error("Can't pack value " + std::to_string(maxValue) + " : values are at most 16 bits.");
+
+    uint8_t bitsPerValue = 0;
+    while((maxValue >> bitsPerValue) != 0)
+        bitsPerValue++;
+
+    // Words are packed in a buffer of the thread, so that values already interned are not allocated
+    static thread_local std::vector<uint64_t> words;
+    const size_t nbWords = getNbWords(nbValues, bitsPerValue);
+    words.assign(nbWords, 0);
+    for(size_t i = 0; i < nbValues && bitsPerValue > 0; i++){
+        const size_t bit = i * bitsPerValue;
+        const size_t shift = bit % 64;
+        words[bit / 64] |= (uint64_t)values[i] << shift;
+        if(shift + bitsPerValue > 64)
+            words[bit / 64 + 1] |= (uint64_t)values[i] >> (64 - shift);
+    }
+
+    size_t hash = Data::Hash<uint64_t>()(nbValues) ^ Data::Hash<uint64_t>()(width) ^ bitsPerValue;
+    for(uint64_t word : words){
+        hash = (hash >> 1) | (hash << 63);
+        hash ^= Data::Hash<uint64_t>()(word);
+    }
+
+    std::lock_guard<std::mutex> lock(internedMutex);
+    auto range = interned.equal_range(hash);
+    for(auto entry = range.first; entry != range.second; entry++){
+        const PackedValues* other = entry->second;
+        if(other->nbValues != nbValues || other->width != width || other->bitsPerValue != bitsPerValue
+           || memcmp(other->getWords(), words.data(), nbWords * sizeof(uint64_t)) != 0)
+            continue;
+
+        // Values whose last reference is being released are skipped
+        uint32_t nbReferences = other->nbReferences.load(std::memory_order_relaxed);
+        while(nbReferences != 0
+              && !other->nbReferences.compare_exchange_weak(nbReferences, nbReferences + 1, std::memory_order_relaxed));
+        if(nbReferences != 0)
+            return Pointer(other);
+    }
+
+    const size_t size = sizeof(PackedValues) + nbWords * sizeof(uint64_t);
+    void* memory = ::operator new(size);
+    PackedValues* packed = new (memory) PackedValues((uint32_t)nbValues, (uint16_t)width, bitsPerValue, hash);
+    memcpy(new (packed + 1) uint64_t[nbWords], words.data(), nbWords * sizeof(uint64_t));
+
+    interned.emplace(hash, packed);
+    internedBytes += size;
+    return Pointer(packed);
+}
+
+void PackedValues::getInternedSize(size_t& nbPackedValues, size_t& nbBytes) {
+    std::lock_guard<std::mutex> lock(internedMutex);
+    nbPackedValues = interned.size();
+    nbBytes = internedBytes;
+}
+
+namespace {
+    /// Empty array of the given size
+    template <typename T, class Array>
+    Array makeArray(size_t width, size_t height) {
+        if constexpr (std::is_same<Array, Data::PrimitiveTypeArray2D<T>>::value)
+            return Array(width, height);
+        else
+            return Array(width * height);
+    }
+
+    /// Array unpacked by a thread
+    template <typename T, class Array>
+    class UnpackedArray : public Array {
+    public:
+        /// Size of the array
+        const size_t width;
+        const size_t height;
+
+        /// Archived array the values were unpacked from, nullptr before the first unpacking
+        std::unique_ptr<ArchivedArray<T, Array>> source;
+
+        UnpackedArray(size_t width, size_t height) : Array(makeArray<T, Array>(width, height)), width(width),
+                height(height) {}
+
+        /// Values of the array, written when unpacking
+        T* getValues() {
+            return this->data.data();
+        }
+    };
+
+    /// Index of the value of an address in the packed values, in row order of the untransposed array
+    size_t getPackedIndex(size_t address, size_t width, size_t height, bool transposed) {
+        return transposed ? (address % width) * height + address / width : address;
+    }
+}
+
+template <typename T, class Array>
+ArchivedArray<T, Array>::ArchivedArray(const Data::DataHandler& source, PackedValues::Pointer values,
+                                       bool transposed, size_t nbOverlayTiles, const uint16_t* overlayAddresses,
+                                       const uint8_t* overlayValues) :
+        Data::DataHandler(source), values(std::move(values)), transposed(transposed),
+        nbOverlayTiles((uint8_t)nbOverlayTiles), overlayAddresses(), overlayValues() {
+    std::copy_n(overlayAddresses, nbOverlayTiles, this->overlayAddresses);
+    std::copy_n(overlayValues, nbOverlayTiles, this->overlayValues);
+
+    // The hash of the source, which the archive already computed
+    this->cachedHash = source.getHash();
+    this->invalidCachedHash = false;
+}
+
+template <typename T, class Array>
+bool ArchivedArray<T, Array>::hasSameData(const ArchivedArray& other) const {
+    return this->values.get() == other.values.get() && this->transposed == other.transposed && this->nbOverlayTiles == other.nbOverlayTiles
+           && std::equal(this->overlayAddresses, this->overlayAddresses + this->nbOverlayTiles, other.overlayAddresses)
+           && std::equal(this->overlayValues, this->overlayValues + this->nbOverlayTiles, other.overlayValues);
+}
+
+template <typename T, class Array>
+const Array& ArchivedArray<T, Array>::unpack() const {
+    // Arrays of the thread, replaced in turn
+    static thread_local std::array<std::unique_ptr<UnpackedArray<T, Array>>, 4> arrays;
+    static thread_local size_t nextArray = 0;
+
+    for(auto& array : arrays){
+        if(array != nullptr && array->source != nullptr && array->source->hasSameData(*this))
+            return *array;
+    }
+
+    const size_t size = this->values->size();
+    const size_t width = this->transposed ? size / this->values->getWidth() : this->values->getWidth();
+    const size_t height = size / width;
+
+    auto& array = arrays[nextArray];
+    nextArray = (nextArray + 1) % arrays.size();
+    if(array == nullptr || array->width != width || array->height != height)
+        array = std::make_unique<UnpackedArray<T, Array>>(width, height);
+    array->source = std::make_unique<ArchivedArray>(*this);
+
+    T* values = array->getValues();
+    for(size_t address = 0; address < size; address++)
+        values[address] = (T)this->values->get(getPackedIndex(address, width, height, this->transposed));
+    for(size_t i = 0; i < this->nbOverlayTiles; i++)
+        values[this->overlayAddresses[i]] = (T)this->overlayValues[i];
+
+    return *array;
+}
+
+template <typename T, class Array>
+Data::DataHandler* ArchivedArray<T, Array>::clone() const {
+    return new ArchivedArray(*this);
+}
+
+template <typename T, class Array>
+bool ArchivedArray<T, Array>::canHandle(const std::type_info& type) const {
+    return unpack().canHandle(type);
+}
+
+template <typename T, class Array>
+size_t ArchivedArray<T, Array>::getAddressSpace(const std::type_info& type) const {
+    return unpack().getAddressSpace(type);
+}
+
+template <typename T, class Array>
+size_t ArchivedArray<T, Array>::getLargestAddressSpace() const {
+    return unpack().getLargestAddressSpace();
+}
+
+template <typename T, class Array>
+void ArchivedArray<T, Array>::resetData() {
+    throw std::runtime_error("Archived data sources are read-only.");
+}
+
+template <typename T, class Array>
+const Data::UntypedSharedPtr ArchivedArray<T, Array>::getDataAt(const std::type_info& type,
+                                                                const size_t address) const {
+    return unpack().getDataAt(type, address);
+}
+
+template <typename T, class Array>
+std::vector<size_t> ArchivedArray<T, Array>::getAddressesAccessed(const std::type_info& type,
+                                                                  const size_t address) const {
+    return unpack().getAddressesAccessed(type, address);
+}
+
+template <typename T, class Array>
+size_t ArchivedArray<T, Array>::updateHash() const {
+    return this->cachedHash;
+}
+
+template <typename T, class Array>
+ArchivableArray<T, Array>::ArchivableArray(size_t width, size_t height, bool transposed) :
+        Array(makeArray<T, Array>(width, height)), width(width), height(height), transposed(transposed),
+        nbOverlayTiles(0), overlayAddresses() {}
+
+template <typename T, class Array>
+void ArchivableArray<T, Array>::setOverlay(const size_t* addresses, size_t nbTiles) {
+    this->nbOverlayTiles = 0;
+    for(size_t i = 0; i < nbTiles && this->nbOverlayTiles < MAX_OVERLAY_SIZE; i++){
+        uint16_t* end = this->overlayAddresses + this->nbOverlayTiles;
+        if(addresses[i] < this->width * this->height && addresses[i] <= UINT16_MAX
+           && std::find(this->overlayAddresses, end, addresses[i]) == end)
+            this->overlayAddresses[this->nbOverlayTiles++] = (uint16_t)addresses[i];
+    }
+}
+
+template <typename T, class Array>
+void ArchivableArray<T, Array>::clearOverlay() {
+    this->nbOverlayTiles = 0;
+}
+
+template <typename T, class Array>
+Data::DataHandler* ArchivableArray<T, Array>::clone() const {
+    const size_t size = this->width * this->height;
+    if(this->width > UINT16_MAX || this->height > UINT16_MAX)
+        return Array::clone();
+
+    // Values in row order of the untransposed array, each one being checked to be packed without loss
+    static thread_local std::vector<uint32_t> values;
+    values.resize(size);
+    for(size_t address = 0; address < size; address++){
+        const double value = (double)this->data[address];
+        if(!(value >= 0 && value <= PackedValues::MAX_VALUE) || std::signbit(value) || value != std::floor(value))
+            return Array::clone();
+        values[getPackedIndex(address, this->width, this->height, this->transposed)] = (uint32_t)value;
+    }
+
+    // Overlay tiles are taken out of the packed values
+    size_t nbOverlayTiles = 0;
+    uint16_t overlayAddresses[MAX_OVERLAY_SIZE];
+    uint8_t overlayValues[MAX_OVERLAY_SIZE];
+    for(size_t i = 0; i < this->nbOverlayTiles; i++){
+        uint32_t& value = values[getPackedIndex(this->overlayAddresses[i], this->width, this->height,
+                                                this->transposed)];
+        if(value > UINT8_MAX)
+            continue;
+        overlayAddresses[nbOverlayTiles] = this->overlayAddresses[i];
+        overlayValues[nbOverlayTiles++] = (uint8_t)value;
+        value = 0;
+    }
+
+    // Rows of the untransposed array are the columns of a transposed one
+    PackedValues::Pointer packed = PackedValues::pack(values.data(), size,
+                                                      this->transposed ? this->height : this->width);
+    return new ArchivedArray<T, Array>(*this, packed, this->transposed, nbOverlayTiles, overlayAddresses,
+                                       overlayValues);
+}
+
+template class ArchivedArray<double>;
+template class ArchivedArray<uint8_t>;
+template class ArchivedArray<double, Data::PrimitiveTypeArray<double>>;
+template class ArchivableArray<double>;
+template class ArchivableArray<uint8_t>;
+template class ArchivableArray<double, Data::PrimitiveTypeArray<double>>;
@@ -0,0 +1,262 @@
+#ifndef GEGELATI_TETRIS_ARCHIVEDARRAY_H
+#define GEGELATI_TETRIS_ARCHIVEDARRAY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <gegelati.h>
+
+/**
+ * \brief Immutable sequence of small unsigned integers, each one packed on the number of bits of the largest one.
+ *
+ * Packed values are the values of an array in row order, with the width of its rows, and are stored with their
+ * words in a single allocation. They are interned : packing values equal to those of living PackedValues returns
+ * them instead of new ones. Archived observations sharing a board, such as the grid and its transposed copy or the
+ * successive frames of a falling tetromino, thus share its memory.
+ */
+class PackedValues {
+public:
+
+    /// Largest value that can be packed
+    static constexpr uint32_t MAX_VALUE = UINT16_MAX;
+
+    /// Counted reference to packed values, deleted with their last reference
+    class Pointer {
+    private:
+        const PackedValues* values;
+
+    public:
+        /// Constructor, taking a reference already counted for it.
+        explicit Pointer(const PackedValues* values = nullptr);
+
+        Pointer(const Pointer& other);
+
+        Pointer& operator=(const Pointer& other);
+
+        ~Pointer();
+
+        const PackedValues* get() const {
+            return this->values;
+        }
+
+        const PackedValues* operator->() const {
+            return this->values;
+        }
+    };
+
+    /**
+     * \brief Packs values, or returns the living packed values equal to them.
+     *
+     * \param values the values, at most MAX_VALUE.
+     * \param nbValues the number of values.
+     * \param width the width of the rows of the array, which divides nbValues.
+     * \throws std::runtime_error if a value or the width is too large.
+     */
+    static Pointer pack(const uint32_t* values, size_t nbValues, size_t width);
+
+    /// Number of living packed values, and number of bytes of their allocations.
+    static void getInternedSize(size_t& nbPackedValues, size_t& nbBytes);
+
+    /// Value at index.
+    uint32_t get(size_t index) const {
+        if(this->bitsPerValue == 0)
+            return 0;
+
+        const uint64_t* words = getWords();
+        const size_t bit = index * this->bitsPerValue;
+        const size_t shift = bit % 64;
+        uint64_t value = words[bit / 64] >> shift;
+        if(shift + this->bitsPerValue > 64)
+            value |= words[bit / 64 + 1] << (64 - shift);
+        return (uint32_t)(value & (((uint64_t)1 << this->bitsPerValue) - 1));
+    }
+
+    /// Number of values.
+    size_t size() const;
+
+    /// Width of the rows of the array.
+    size_t getWidth() const;
+
+    PackedValues(const PackedValues& other) = delete;
+
+    PackedValues& operator=(const PackedValues& other) = delete;
+
+private:
+
+    /// Number of Pointer to the values, which are no longer shared once it reached 0
+    mutable std::atomic<uint32_t> nbReferences;
+
+    /// Number of values, and width of the rows of the array
+    uint32_t nbValues;
+    uint16_t width;
+
+    /// Number of bits of each value, 0 when all values are 0
+    uint8_t bitsPerValue;
+
+    /// Hash of the values, key of the interned values
+    size_t hash;
+
+    /// Living packed values, by hash
+    static std::mutex internedMutex;
+    static std::unordered_multimap<size_t, const PackedValues*> interned;
+
+    /// Bytes allocated for the living packed values
+    static size_t internedBytes;
+
+    PackedValues(uint32_t nbValues, uint16_t width, uint8_t bitsPerValue, size_t hash);
+
+    /// Number of words holding nbValues values of bitsPerValue bits.
+    static size_t getNbWords(size_t nbValues, uint8_t bitsPerValue);
+
+    /// Words of the values, from the lowest bits of the first word, allocated after the object.
+    const uint64_t* getWords() const {
+        return reinterpret_cast<const uint64_t*>(this + 1);
+    }
+
+    /// Removes a reference, deleting the values with the last one.
+    void release() const;
+};
+
+/// Maximum number of tiles of an ArchivableArray stored apart from its packed values
+constexpr size_t MAX_OVERLAY_SIZE = 4;
+
+/**
+ * \brief Archived copy of an ArchivableArray, holding its values packed instead of a full array.
+ *
+ * Values are the packed values of the array, read in row order of the untransposed array, and the tiles of its
+ * overlay, stored apart. The copy keeps the id and the hash of the array, so that the archive sees the same data.
+ * Its size is the one of the packed values, transposed if the array is.
+ *
+ * Data is unpacked when read, in a thread-local array kept for the next reads, so that a program executed on an
+ * archived recording only unpacks it once. Returned pointers stay valid until data sources of 4 other archived
+ * copies with the same type are read by the thread, which is more than the data sources of a recording.
+ *
+ * Archived copies are read-only : resetData() throws a std::runtime_error.
+ *
+ * \tparam T type of the values.
+ * \tparam Array type of the array, PrimitiveTypeArray2D<T> or PrimitiveTypeArray<T>.
+ */
+template <typename T, class Array = Data::PrimitiveTypeArray2D<T>>
+class ArchivedArray : public Data::DataHandler {
+private:
+
+    /// Packed values of the array, without its overlay
+    PackedValues::Pointer values;
+
+    /// Are the values packed in column order of the array, the array being the transposed one of the packed values
+    bool transposed;
+
+    /// Tiles of the overlay, as addresses in the array, and their values
+    uint8_t nbOverlayTiles;
+    uint16_t overlayAddresses[MAX_OVERLAY_SIZE];
+    uint8_t overlayValues[MAX_OVERLAY_SIZE];
+
+    /// Unpacked array, in the arrays of the calling thread.
+    const Array& unpack() const;
+
+    /// Is other a copy of the same data.
+    bool hasSameData(const ArchivedArray& other) const;
+
+public:
+
+    /**
+     * \brief Constructor.
+     *
+     * \param source the archived array, whose id and hash are kept.
+     * \param values the packed values of the array, without its overlay.
+     * \param transposed are the values packed in column order of the array.
+     * \param nbOverlayTiles the number of tiles of the overlay.
+     * \param overlayAddresses the addresses of the tiles of the overlay in the array.
+     * \param overlayValues the values of the tiles of the overlay.
+     */
+    ArchivedArray(const Data::DataHandler& source, PackedValues::Pointer values, bool transposed,
+                  size_t nbOverlayTiles, const uint16_t* overlayAddresses, const uint8_t* overlayValues);
+
+    /// Inherited via DataHandler, copying the packed values.
+    virtual Data::DataHandler* clone() const override;
+
+    /// Inherited via DataHandler, as the archived array.
+    virtual bool canHandle(const std::type_info& type) const override;
+
+    /// Inherited via DataHandler, as the archived array.
+    virtual size_t getAddressSpace(const std::type_info& type) const override;
+
+    /// Inherited via DataHandler, as the archived array.
+    virtual size_t getLargestAddressSpace() const override;
+
+    /// Inherited via DataHandler, throws a std::runtime_error.
+    virtual void resetData() override;
+
+    /// Inherited via DataHandler, reading the unpacked array.
+    virtual const Data::UntypedSharedPtr getDataAt(const std::type_info& type, const size_t address) const override;
+
+    /// Inherited via DataHandler, as the archived array.
+    virtual std::vector<size_t> getAddressesAccessed(const std::type_info& type,
+                                                     const size_t address) const override;
+
+    /// Inherited via DataHandler, the hash of the archived array.
+    virtual size_t updateHash() const override;
+};
+
+/**
+ * \brief Observed array whose clones, made by the archive of the learning agent, are ArchivedArray.
+ *
+ * Observations of Tetris are small non-negative integers (colours, occupancy or board features), so that archived
+ * recordings hold them on a few bits instead of full doubles. Arrays with other values are cloned as full copies.
+ *
+ * The overlay is a set of tiles, those of the active tetromino, archived apart from the packed values. Packed values
+ * are then those of the locked blocks only, shared by all the recordings of the same board. A transposed array
+ * packs its values in column order, as those of the untransposed array, so that both share their packed values.
+ *
+ * \tparam T type of the values.
+ * \tparam Array type of the array, PrimitiveTypeArray2D<T> or PrimitiveTypeArray<T>.
+ */
+template <typename T, class Array = Data::PrimitiveTypeArray2D<T>>
+class ArchivableArray : public Array {
+private:
+
+    /// Size of the array, height being 1 for 1D arrays
+    size_t width;
+    size_t height;
+
+    /// Is the array the transposed copy of another one
+    bool transposed;
+
+    /// Addresses of the tiles of the overlay
+    size_t nbOverlayTiles;
+    uint16_t overlayAddresses[MAX_OVERLAY_SIZE];
+
+public:
+
+    /**
+     * \brief Constructor.
+     *
+     * \param width the width of the array, or its size for 1D arrays.
+     * \param height the height of the array, 1 for 1D arrays.
+     * \param transposed is the array the transposed copy of another one, whose values are packed in column order.
+     */
+    explicit ArchivableArray(size_t width, size_t height = 1, bool transposed = false);
+
+    /**
+     * \brief Sets the tiles of the overlay, archived apart from the packed values.
+     *
+     * The overlay only changes the memory of archived copies, which hold the same data whatever the overlay.
+     *
+     * \param addresses the addresses of the tiles, at most MAX_OVERLAY_SIZE.
+     * \param nbTiles the number of tiles.
+     */
+    void setOverlay(const size_t* addresses, size_t nbTiles);
+
+    /// Empties the overlay.
+    void clearOverlay();
+
+    /// Inherited via DataHandler, returns an ArchivedArray, or a full copy if a value can't be packed.
+    virtual Data::DataHandler* clone() const override;
+};
+
+
+#endif //GEGELATI_TETRIS_ARCHIVEDARRAY_H
@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <iostream>
+
+#include "AsyncDotExporter.h"
+#include "Profiler.h"
+
+AsyncDotExporter::AsyncDotExporter(size_t maxQueueSize) : maxQueueSize(std::max<size_t>(maxQueueSize, 1)),
+        closed(false) {
+    this->writer = std::thread(&AsyncDotExporter::writeExports, this);
+}
+
+AsyncDotExporter::~AsyncDotExporter() {
+    close();
+}
+
+void AsyncDotExporter::push(std::unique_ptr<PolicySnapshot> snapshot, const std::string& path) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->notFull.wait(lock, [this](){ return this->queue.size() < this->maxQueueSize; });
+    this->queue.push_back({std::move(snapshot), path});
+    lock.unlock();
+    this->notEmpty.notify_one();
+}
+
+void AsyncDotExporter::close() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+    }
+    this->notEmpty.notify_one();
+
+    if(this->writer.joinable())
+        this->writer.join();
+}
+
+void AsyncDotExporter::writeExports() {
+    while(true){
+        Export next;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->notEmpty.wait(lock, [this](){ return !this->queue.empty() || this->closed; });
+            if(this->queue.empty())
+                return;
+            next = std::move(this->queue.front());
+            this->queue.pop_front();
+        }
+        this->notFull.notify_one();
+
+        ProfileScope writeScope(ProfilePhase::DOT_WRITE);
+        try {
+            File::TPGGraphDotExporter dotExporter(next.path.c_str(), next.snapshot->getGraph());
+            dotExporter.print();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Can't export " << next.path << " : " << e.what() << std::endl;
+        }
+    }
+}
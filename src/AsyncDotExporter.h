@@ -0,0 +1,84 @@
+#ifndef GEGELATI_TETRIS_ASYNCDOTEXPORTER_H
+#define GEGELATI_TETRIS_ASYNCDOTEXPORTER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "PolicySnapshot.h"
+
+/**
+ * \brief Writes dot files of graph snapshots on a background thread.
+ *
+ * The training thread only copies the graph and queues the copy, the dot file being printed by the writer thread
+ * while the next generations are trained. The queue is bounded : when the writer falls behind, push() waits until
+ * a snapshot was taken from the queue, so that snapshots can't pile up in memory.
+ */
+class AsyncDotExporter {
+private:
+
+    /// Snapshot waiting to be written, with the path of its dot file
+    struct Export {
+        std::unique_ptr<PolicySnapshot> snapshot;
+        std::string path;
+    };
+
+    /// Maximum number of snapshots waiting to be written
+    const size_t maxQueueSize;
+
+    /// Snapshots waiting to be written
+    std::deque<Export> queue;
+
+    /// Protects queue and closed
+    std::mutex mutex;
+
+    /// Notified when a snapshot is queued or when the exporter is closed
+    std::condition_variable notEmpty;
+
+    /// Notified when a snapshot is taken from the queue
+    std::condition_variable notFull;
+
+    /// Set by close(), the writer stops once the queue is empty
+    bool closed;
+
+    /// Thread writing the dot files
+    std::thread writer;
+
+    /// Main loop of the writer thread
+    void writeExports();
+
+public:
+
+    /**
+     * \brief Constructor, starting the writer thread.
+     *
+     * \param maxQueueSize maximum number of snapshots waiting to be written, at least 1.
+     */
+    explicit AsyncDotExporter(size_t maxQueueSize = 4);
+
+    AsyncDotExporter(const AsyncDotExporter& other) = delete;
+
+    AsyncDotExporter& operator=(const AsyncDotExporter& other) = delete;
+
+    /// Destructor, closes the exporter.
+    ~AsyncDotExporter();
+
+    /**
+     * \brief Queues a snapshot, whose graph will be written in a dot file.
+     *
+     * Waits while the queue is full.
+     *
+     * \param snapshot the snapshot to write.
+     * \param path the path of the dot file.
+     */
+    void push(std::unique_ptr<PolicySnapshot> snapshot, const std::string& path);
+
+    /// Waits until all queued snapshots are written and stops the writer thread.
+    void close();
+};
+
+
+#endif //GEGELATI_TETRIS_ASYNCDOTEXPORTER_H
@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "BatchExecutionEngine.h"
+
+namespace {
+    /// Index of a type in types, added if missing
+    size_t getTypeIndex(std::vector<std::reference_wrapper<const std::type_info>>& types, const std::type_info& type) {
+        for(size_t i = 0; i < types.size(); i++){
+            if(types[i].get() == type)
+                return i;
+        }
+        types.push_back(type);
+        return types.size() - 1;
+    }
+
+    /**
+     * \brief Value at address 0 of a data source, if its values of type T are read in place.
+     *
+     * Values read in place are at the same address whenever they are read, and follow each other in memory. Values
+     * copied at each read would be at different addresses.
+     *
+     * \return the value at address 0, or nullptr if the values are copied.
+     */
+    template <typename T>
+    const uint8_t* getValuesInPlace(const Data::DataHandler& dataSource) {
+        const size_t addressSpace = dataSource.getAddressSpace(typeid(T));
+        if(addressSpace == 0)
+            return nullptr;
+
+        auto first = dataSource.getDataAt(typeid(T), 0).template getSharedPointer<const T>();
+        auto again = dataSource.getDataAt(typeid(T), 0).template getSharedPointer<const T>();
+        auto last = dataSource.getDataAt(typeid(T), addressSpace - 1).template getSharedPointer<const T>();
+        if(first.get() != again.get() || last.get() != first.get() + (addressSpace - 1))
+            return nullptr;
+        return reinterpret_cast<const uint8_t*>(first.get());
+    }
+}
+
+const std::vector<std::reference_wrapper<const std::type_info>>& BatchInstruction::getOperandTypes() const {
+    return this->operandTypes;
+}
+
+const std::vector<std::reference_wrapper<const std::type_info>>& BatchInstruction::getElementTypes() const {
+    return this->elementTypes;
+}
+
+const std::vector<size_t>& BatchInstruction::getOperandSizes() const {
+    return this->operandSizes;
+}
+
+size_t BatchInstructionSet::getNbInstructions() const {
+    return this->instructions.size();
+}
+
+const BatchInstruction& BatchInstructionSet::getInstruction(size_t index) const {
+    return *this->instructions.at(index);
+}
+
+BatchExecutionEngine::BatchExecutionEngine(
+        const Environment& env, const BatchInstructionSet& batchSet,
+        const std::vector<std::vector<std::reference_wrapper<const Data::DataHandler>>>& laneDataSources)
+        : env(env), batchSet(batchSet), nbLanes(laneDataSources.size()), nbRegisters(env.getNbRegisters()),
+          firstDataSource(env.getNbConstant() > 0 ? 2 : 1), nbDataSources(env.getDataSources().size()) {
+    const Instructions::Set& set = env.getInstructionSet();
+    if(batchSet.getNbInstructions() != set.getNbInstructions())
+        throw std::runtime_error("Batch instructions don't match the instruction set.");
+
+    // Operand types of the instructions, and types of their values
+    std::vector<std::reference_wrapper<const std::type_info>> operandTypes;
+    size_t maxNbOperands = 0;
+    for(size_t i = 0; i < set.getNbInstructions(); i++){
+        const auto& types = set.getInstruction(i).getOperandTypes();
+        const BatchInstruction& batchInstruction = batchSet.getInstruction(i);
+        const auto& batchTypes = batchInstruction.getOperandTypes();
+        if(types.size() != batchTypes.size()
+           || !std::equal(types.begin(), types.end(), batchTypes.begin(),
+                          [](const std::type_info& type, const std::type_info& batchType){
+                              return type == batchType;
+                          }))
+            throw std::runtime_error("Batch instruction " + std::to_string(i) + " doesn't match the instruction set.");
+
+        for(size_t o = 0; o < batchTypes.size(); o++){
+            getTypeIndex(operandTypes, batchTypes[o]);
+            getTypeIndex(this->elementTypes, batchInstruction.getElementTypes()[o]);
+        }
+        maxNbOperands = std::max(maxNbOperands, batchTypes.size());
+    }
+
+    for(const std::type_info& type : this->elementTypes){
+        if(type == typeid(double))
+            this->elementSizes.push_back(sizeof(double));
+        else if(type == typeid(uint8_t))
+            this->elementSizes.push_back(sizeof(uint8_t));
+        else
+            this->elementSizes.push_back(0);
+    }
+
+    // Data sources of the lanes, whose values are read in place
+    const auto& envDataSources = env.getDataSources();
+    for(size_t lane = 0; lane < this->nbLanes; lane++){
+        const auto& dataSources = laneDataSources[lane];
+        if(dataSources.size() != this->nbDataSources)
+            throw std::runtime_error("Data sources of lane " + std::to_string(lane)
+                                     + " don't match those of the environment.");
+
+        for(size_t d = 0; d < this->nbDataSources; d++){
+            const Data::DataHandler& dataSource = dataSources[d].get();
+            const Data::DataHandler& envDataSource = envDataSources[d].get();
+            for(const std::type_info& type : operandTypes){
+                if(dataSource.canHandle(type) != envDataSource.canHandle(type)
+                   || (dataSource.canHandle(type)
+                       && dataSource.getAddressSpace(type) != envDataSource.getAddressSpace(type)))
+                    throw std::runtime_error("Data sources of lane " + std::to_string(lane)
+                                             + " don't match those of the environment.");
+            }
+
+            for(size_t e = 0; e < this->elementTypes.size(); e++){
+                const std::type_info& type = this->elementTypes[e];
+                const uint8_t* values = nullptr;
+                if(dataSource.canHandle(type)){
+                    if(type == typeid(double))
+                        values = getValuesInPlace<double>(dataSource);
+                    else if(type == typeid(uint8_t))
+                        values = getValuesInPlace<uint8_t>(dataSource);
+                    if(values == nullptr && dataSource.getAddressSpace(type) > 0)
+                        throw std::runtime_error("Values of data source " + std::to_string(d)
+                                                 + " are not read in place.");
+                }
+                this->dataValues.push_back(values);
+            }
+        }
+    }
+
+    this->registers.resize(this->nbRegisters * this->nbLanes);
+    for(const double& reg : this->registers)
+        this->registerPointers.push_back(&reg);
+    this->operandPointers.resize(maxNbOperands * this->nbLanes);
+    this->operands.resize(maxNbOperands);
+    this->registerArrays.resize(maxNbOperands * this->nbLanes * this->nbRegisters);
+
+    this->currentVertices.resize(this->nbLanes);
+    this->visitedVertices.resize(this->nbLanes);
+}
+
+size_t BatchExecutionEngine::getNbLanes() const {
+    return this->nbLanes;
+}
+
+const BatchExecutionEngine::DecodedProgram& BatchExecutionEngine::decode(const Program::Program& program) {
+    auto found = this->programs.find(&program);
+    if(found != this->programs.end())
+        return found->second;
+
+    DecodedProgram decoded;
+    const size_t nbConstants = this->env.getNbConstant();
+    for(size_t c = 0; c < nbConstants; c++)
+        decoded.constants.push_back(program.getConstantAt(c));
+
+    const auto& envDataSources = this->env.getDataSources();
+    for(uint64_t l = 0; l < program.getNbLines(); l++){
+        // Introns don't change the bid
+        if(program.isIntron(l))
+            continue;
+
+        const Program::Line& line = program.getLine(l);
+        const BatchInstruction& instruction = this->batchSet.getInstruction(line.getInstructionIndex());
+        if(line.getDestinationIndex() >= this->nbRegisters)
+            throw std::runtime_error("Line " + std::to_string(l) + " writes a register that doesn't exist.");
+        decoded.lines.push_back({&instruction, line.getDestinationIndex(), decoded.operands.size()});
+
+        for(size_t o = 0; o < instruction.getOperandTypes().size(); o++){
+            const std::pair<uint64_t, uint64_t>& indexes = line.getOperand(o);
+            const std::type_info& type = instruction.getOperandTypes()[o];
+            const std::type_info& elementType = instruction.getElementTypes()[o];
+
+            Operand operand;
+            operand.dataSource = 0;
+            operand.elementType = getTypeIndex(this->elementTypes, elementType);
+            operand.size = instruction.getOperandSizes()[o];
+
+            // Locations are scaled as in Program::ProgramExecutionEngine, modulo the address space of the operand type
+            bool valid;
+            if(indexes.first == 0){
+                valid = elementType == typeid(double) && operand.size <= this->nbRegisters;
+                operand.source = (operand.size == 1) ? OperandSource::REGISTER : OperandSource::REGISTER_ARRAY;
+                operand.location = valid ? indexes.second % (this->nbRegisters - operand.size + 1) : 0;
+            }
+            else if(indexes.first < this->firstDataSource){
+                valid = type == typeid(Data::Constant);
+                operand.source = OperandSource::CONSTANT;
+                operand.location = valid ? indexes.second % nbConstants : 0;
+            }
+            else {
+                operand.source = OperandSource::DATA;
+                operand.dataSource = indexes.first - this->firstDataSource;
+                valid = operand.dataSource < this->nbDataSources
+                        && this->dataValues[operand.dataSource * this->elementTypes.size() + operand.elementType]
+                           != nullptr
+                        && envDataSources[operand.dataSource].get().getAddressSpace(type) > 0;
+                if(valid){
+                    // 2D operands are windows of the array, their address is not the index of their first value
+                    const Data::DataHandler& dataSource = envDataSources[operand.dataSource].get();
+                    const std::vector<size_t> accessed = dataSource.getAddressesAccessed(
+                            type, indexes.second % dataSource.getAddressSpace(type));
+                    operand.location = accessed.front();
+                    for(size_t i = 0; i < accessed.size(); i++)
+                        valid = valid && accessed[i] == operand.location + i;
+                    valid = valid && accessed.size() == operand.size;
+                }
+                else
+                    operand.location = 0;
+            }
+
+            if(!valid)
+                throw std::runtime_error("Operand " + std::to_string(o) + " of line " + std::to_string(l)
+                                         + " can't be read from data source " + std::to_string(indexes.first) + ".");
+            decoded.operands.push_back(operand);
+        }
+    }
+
+    return this->programs.emplace(&program, std::move(decoded)).first->second;
+}
+
+void BatchExecutionEngine::executeProgram(const Program::Program& program, const std::vector<size_t>& lanes,
+                                          std::vector<double>& bids) {
+    const DecodedProgram& decoded = decode(program);
+    const size_t nbExecutingLanes = lanes.size();
+    const size_t nbElementTypes = this->elementTypes.size();
+
+    // Registers of lane i are at index i of each register, whatever the lane
+    std::fill(this->registers.begin(), this->registers.end(), 0.0);
+
+    for(const Line& line : decoded.lines){
+        const size_t nbOperands = line.instruction->getOperandTypes().size();
+        for(size_t o = 0; o < nbOperands; o++){
+            const Operand& operand = decoded.operands[line.firstOperand + o];
+            const void** pointers = &this->operandPointers[o * this->nbLanes];
+
+            switch(operand.source){
+                case OperandSource::REGISTER:
+                    pointers = &this->registerPointers[operand.location * this->nbLanes];
+                    break;
+
+                case OperandSource::REGISTER_ARRAY:
+                    for(size_t i = 0; i < nbExecutingLanes; i++){
+                        double* array = &this->registerArrays[(o * this->nbLanes + i) * this->nbRegisters];
+                        for(size_t r = 0; r < operand.size; r++)
+                            array[r] = this->registers[(operand.location + r) * this->nbLanes + i];
+                        pointers[i] = array;
+                    }
+                    break;
+
+                case OperandSource::CONSTANT:
+                    std::fill(pointers, pointers + nbExecutingLanes, &decoded.constants[operand.location]);
+                    break;
+
+                case OperandSource::DATA: {
+                    const size_t offset = operand.location * this->elementSizes[operand.elementType];
+                    for(size_t i = 0; i < nbExecutingLanes; i++){
+                        const size_t index = (lanes[i] * this->nbDataSources + operand.dataSource) * nbElementTypes
+                                             + operand.elementType;
+                        pointers[i] = this->dataValues[index] + offset;
+                    }
+                    break;
+                }
+            }
+
+            this->operands[o] = pointers;
+        }
+
+        line.instruction->execute(this->operands.data(), &this->registers[line.destination * this->nbLanes],
+                                  nbExecutingLanes);
+    }
+
+    // The bid is register 0, NaN bids never win as in TPG::TPGExecutionEngine
+    bids.resize(nbExecutingLanes);
+    for(size_t i = 0; i < nbExecutingLanes; i++){
+        const double bid = this->registers[i];
+        bids[i] = std::isnan(bid) ? -std::numeric_limits<double>::infinity() : bid;
+    }
+}
+
+void BatchExecutionEngine::evaluateTeam(const TPG::TPGTeam& team, const std::vector<size_t>& lanes) {
+    this->bestEdges.assign(lanes.size(), nullptr);
+    this->bestBids.assign(lanes.size(), -std::numeric_limits<double>::infinity());
+
+    for(const TPG::TPGEdge* edge : team.getOutgoingEdges()){
+        // Lanes that did not go through the destination of the edge execute its program
+        this->edgeLanes.clear();
+        this->edgePositions.clear();
+        for(size_t i = 0; i < lanes.size(); i++){
+            const std::vector<const TPG::TPGVertex*>& visited = this->visitedVertices[lanes[i]];
+            if(std::find(visited.begin(), visited.end(), edge->getDestination()) == visited.end()){
+                this->edgeLanes.push_back(lanes[i]);
+                this->edgePositions.push_back(i);
+            }
+        }
+        if(this->edgeLanes.empty())
+            continue;
+
+        executeProgram(edge->getProgram(), this->edgeLanes, this->bids);
+
+        // Later edges win ties, as in TPG::TPGExecutionEngine::evaluateTeam
+        for(size_t j = 0; j < this->edgeLanes.size(); j++){
+            const size_t i = this->edgePositions[j];
+            if(this->bestEdges[i] == nullptr || this->bids[j] >= this->bestBids[i]){
+                this->bestEdges[i] = edge;
+                this->bestBids[i] = this->bids[j];
+            }
+        }
+    }
+
+    for(size_t i = 0; i < lanes.size(); i++){
+        if(this->bestEdges[i] == nullptr)
+            throw std::runtime_error("No outgoing edge to evaluate after excluding visited vertices.");
+
+        this->currentVertices[lanes[i]] = this->bestEdges[i]->getDestination();
+        this->visitedVertices[lanes[i]].push_back(this->bestEdges[i]->getDestination());
+    }
+}
+
+void BatchExecutionEngine::executeFromRoot(const TPG::TPGVertex& root, const std::vector<size_t>& lanes,
+                                           std::vector<uint64_t>& actionIDs) {
+    if(actionIDs.size() < this->nbLanes)
+        actionIDs.resize(this->nbLanes);
+
+    this->pendingLanes.clear();
+    for(size_t lane : lanes){
+        if(lane >= this->nbLanes)
+            throw std::runtime_error("Lane " + std::to_string(lane) + " doesn't exist.");
+        this->currentVertices[lane] = &root;
+        this->visitedVertices[lane].assign(1, &root);
+        this->pendingLanes.push_back(lane);
+    }
+
+    while(true){
+        // Lanes that reached an action are done
+        size_t nbPendingLanes = 0;
+        for(size_t lane : this->pendingLanes){
+            if(dynamic_cast<const TPG::TPGTeam*>(this->currentVertices[lane]) != nullptr)
+                this->pendingLanes[nbPendingLanes++] = lane;
+            else
+                actionIDs[lane] = ((const TPG::TPGAction*)this->currentVertices[lane])->getActionID();
+        }
+        this->pendingLanes.resize(nbPendingLanes);
+        if(this->pendingLanes.empty())
+            return;
+
+        // Lanes on the team of the first pending lane evaluate it together
+        const TPG::TPGVertex* team = this->currentVertices[this->pendingLanes.front()];
+        this->teamLanes.clear();
+        nbPendingLanes = 0;
+        for(size_t lane : this->pendingLanes){
+            if(this->currentVertices[lane] == team)
+                this->teamLanes.push_back(lane);
+            else
+                this->pendingLanes[nbPendingLanes++] = lane;
+        }
+        this->pendingLanes.resize(nbPendingLanes);
+
+        evaluateTeam(*(const TPG::TPGTeam*)team, this->teamLanes);
+        this->pendingLanes.insert(this->pendingLanes.end(), this->teamLanes.begin(), this->teamLanes.end());
+    }
+}
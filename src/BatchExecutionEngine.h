@@ -0,0 +1,323 @@
+#ifndef GEGELATI_TETRIS_BATCHEXECUTIONENGINE_H
+#define GEGELATI_TETRIS_BATCHEXECUTIONENGINE_H
+
+#include <cstdint>
+#include <memory>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gegelati.h>
+
+/// Access to an operand of type T from a pointer to its value, or to the first element of an array operand
+template <typename T>
+struct BatchOperand {
+    /// Type of the values of the operand, elements of arrays
+    using Element = T;
+
+    /// Number of values of the operand
+    static constexpr size_t SIZE = 1;
+
+    static const T& get(const void* pointer) {
+        return *static_cast<const T*>(pointer);
+    }
+};
+
+template <typename T, size_t N>
+struct BatchOperand<const T[N]> {
+    using Element = T;
+
+    static constexpr size_t SIZE = N;
+
+    static const T* get(const void* pointer) {
+        return static_cast<const T*>(pointer);
+    }
+};
+
+/// 2D array operands, whose M lines of N values follow each other in memory
+template <typename T, size_t M, size_t N>
+struct BatchOperand<const T[M][N]> {
+    using Element = T;
+
+    static constexpr size_t SIZE = M * N;
+
+    static const T (*get(const void* pointer))[N] {
+        return reinterpret_cast<const T (*)[N]>(pointer);
+    }
+};
+
+/**
+ * \brief Instruction executed for several lanes at once, each lane reading its own operands.
+ *
+ * A batch instruction is the counterpart of an instruction of an Instructions::Set : it has the same operand types
+ * and computes the same result for each lane as the instruction does for a single execution.
+ */
+class BatchInstruction {
+protected:
+
+    /// Types of the operands, the type of their values, elements of arrays, and their number of values
+    std::vector<std::reference_wrapper<const std::type_info>> operandTypes;
+    std::vector<std::reference_wrapper<const std::type_info>> elementTypes;
+    std::vector<size_t> operandSizes;
+
+public:
+
+    virtual ~BatchInstruction() = default;
+
+    /// Types of the operands, as those of Instructions::Instruction.
+    const std::vector<std::reference_wrapper<const std::type_info>>& getOperandTypes() const;
+
+    /// Types of the values of the operands, the elements of array operands.
+    const std::vector<std::reference_wrapper<const std::type_info>>& getElementTypes() const;
+
+    /// Number of values of the operands, 1 except for array operands.
+    const std::vector<size_t>& getOperandSizes() const;
+
+    /**
+     * \brief Executes the instruction for each lane.
+     *
+     * \param operands operands[i][lane] points to operand i of the lane, or to the first element of an array operand.
+     * \param results set to the result of each lane. results[lane] may be the storage of an operand of the same lane,
+     * but not of another lane.
+     * \param nbLanes number of lanes.
+     */
+    virtual void execute(const void* const* const* operands, double* results, size_t nbLanes) const = 0;
+};
+
+/**
+ * \brief Batch instruction applying a function to the operands of each lane.
+ *
+ * The function is the one of the matching Instructions::LambdaInstruction, so that both compute the same results.
+ *
+ * \tparam F type of the function.
+ * \tparam Ts types of the operands.
+ */
+template <class F, typename... Ts>
+class BatchLambdaInstruction : public BatchInstruction {
+private:
+
+    const F function;
+
+    template <size_t... I>
+    void execute(const void* const* const* operands, double* results, size_t nbLanes,
+                 std::index_sequence<I...>) const {
+        for(size_t lane = 0; lane < nbLanes; lane++)
+            results[lane] = this->function(BatchOperand<Ts>::get(operands[I][lane])...);
+    }
+
+public:
+
+    explicit BatchLambdaInstruction(F function) : function(function) {
+        this->operandTypes = {typeid(Ts)...};
+        this->elementTypes = {typeid(typename BatchOperand<Ts>::Element)...};
+        this->operandSizes = {BatchOperand<Ts>::SIZE...};
+    }
+
+    /// Inherited via BatchInstruction.
+    virtual void execute(const void* const* const* operands, double* results, size_t nbLanes) const override {
+        execute(operands, results, nbLanes, std::index_sequence_for<Ts...>());
+    }
+};
+
+/// Batch instructions, in the order of the instructions of an Instructions::Set
+class BatchInstructionSet {
+private:
+
+    std::vector<std::unique_ptr<const BatchInstruction>> instructions;
+
+public:
+
+    /**
+     * \brief Adds a batch instruction.
+     *
+     * \tparam Ts types of the operands of the function.
+     * \param function the function of the instruction.
+     */
+    template <typename... Ts, class F>
+    void add(F function) {
+        this->instructions.emplace_back(new BatchLambdaInstruction<F, Ts...>(function));
+    }
+
+    size_t getNbInstructions() const;
+
+    const BatchInstruction& getInstruction(size_t index) const;
+};
+
+/**
+ * \brief Executes a TPG from a root for several environments, called lanes, in lockstep.
+ *
+ * Lanes follow their own path in the graph. At each step, lanes on the same team evaluate its edges together : each
+ * program is executed once for all of them, each line running its instruction over the registers of every lane,
+ * stored side by side. Programs are decoded once, on their first execution, with their operand locations already
+ * scaled to the address spaces of the data sources, and operands are read in place, without the shared pointers of
+ * Program::ProgramExecutionEngine.
+ *
+ * The action of each lane is the one TPG::TPGExecutionEngine::executeFromRoot would return with the data sources of
+ * the lane : lines run in the same order, with the same functions, registers start at 0, NaN bids are -infinity and
+ * ties between bids go to the last edge. Nothing is recorded in an archive.
+ *
+ * Programs must not change during the life of the engine, and data sources must keep their storage.
+ */
+class BatchExecutionEngine {
+private:
+
+    /// Origin of the values of an operand
+    enum class OperandSource : uint8_t {
+        /// A register of each lane
+        REGISTER,
+        /// Consecutive registers of each lane, copied into an array
+        REGISTER_ARRAY,
+        /// A constant of the program, the same for all lanes
+        CONSTANT,
+        /// A data source of each lane
+        DATA
+    };
+
+    /// Decoded operand of a line
+    struct Operand {
+        OperandSource source;
+
+        /// Index of the data source in those of the environment, and of the type of its values in elementTypes
+        size_t dataSource;
+        size_t elementType;
+
+        /// Location of the value, already scaled to the address space of the operand type, and for data sources, index
+        /// of its first value in the data source
+        size_t location;
+
+        /// Number of values of array operands
+        size_t size;
+    };
+
+    /// Decoded line of a program
+    struct Line {
+        const BatchInstruction* instruction;
+        size_t destination;
+
+        /// Index of the first operand of the line in the operands of its program
+        size_t firstOperand;
+    };
+
+    /// Decoded program, without its introns
+    struct DecodedProgram {
+        std::vector<Line> lines;
+        std::vector<Operand> operands;
+        std::vector<Data::Constant> constants;
+    };
+
+    const Environment& env;
+
+    const BatchInstructionSet& batchSet;
+
+    const size_t nbLanes;
+    const size_t nbRegisters;
+
+    /// Index of the first data source of the environment in the operands of lines, after the registers and the
+    /// constants
+    const size_t firstDataSource;
+
+    /// Number of data sources of the environment
+    const size_t nbDataSources;
+
+    /// Types of the values of the operands of the instructions, elements of arrays, and their size
+    std::vector<std::reference_wrapper<const std::type_info>> elementTypes;
+    std::vector<size_t> elementSizes;
+
+    /// Value at address 0 of each type of values in each data source of each lane, the value at address a following
+    /// it by a values, at (lane * nbDataSources + dataSource) * elementTypes.size() + elementType. nullptr if the
+    /// data source has no values of the type.
+    std::vector<const uint8_t*> dataValues;
+
+    /// Decoded programs
+    std::unordered_map<const Program::Program*, DecodedProgram> programs;
+
+    /// Registers of the lanes, register r of lane l being at r * nbLanes + l
+    std::vector<double> registers;
+
+    /// Pointers to each register of the lanes, at the same index as the register
+    std::vector<const void*> registerPointers;
+
+    /// Operand pointers of the lanes, and copies of register arrays, for each operand of the current line
+    std::vector<const void*> operandPointers;
+    std::vector<const void* const*> operands;
+    std::vector<double> registerArrays;
+
+    /// Vertex reached by each lane, and vertices it went through
+    std::vector<const TPG::TPGVertex*> currentVertices;
+    std::vector<std::vector<const TPG::TPGVertex*>> visitedVertices;
+
+    /// Lanes still on teams, and lanes on the evaluated team
+    std::vector<size_t> pendingLanes;
+    std::vector<size_t> teamLanes;
+
+    /// Lanes executing the program of the evaluated edge, their index in teamLanes and their bid
+    std::vector<size_t> edgeLanes;
+    std::vector<size_t> edgePositions;
+    std::vector<double> bids;
+
+    /// Best edge of each lane of teamLanes, and its bid
+    std::vector<const TPG::TPGEdge*> bestEdges;
+    std::vector<double> bestBids;
+
+    /**
+     * \brief Decodes a program, on its first execution.
+     *
+     * \throws std::runtime_error if a line reads an operand that no data source can give, or whose values don't follow
+     * each other in the data source.
+     */
+    const DecodedProgram& decode(const Program::Program& program);
+
+    /**
+     * \brief Executes a program for some lanes.
+     *
+     * \param program the program.
+     * \param lanes the lanes executing the program.
+     * \param bids set to the result of each lane, in the order of lanes, NaN results being replaced with -infinity.
+     */
+    void executeProgram(const Program::Program& program, const std::vector<size_t>& lanes, std::vector<double>& bids);
+
+    /**
+     * \brief Evaluates the edges of a team for the lanes on it, moving each lane to the destination of its best edge.
+     *
+     * \throws std::runtime_error if all edges of the team lead to vertices already visited by a lane.
+     */
+    void evaluateTeam(const TPG::TPGTeam& team, const std::vector<size_t>& lanes);
+
+public:
+
+    /**
+     * \brief Constructor.
+     *
+     * \param env the environment of the graph.
+     * \param batchSet the batch instructions, matching the instruction set of the environment.
+     * \param laneDataSources the data sources of each lane, with the same types and address spaces as those of the
+     * environment.
+     * \throws std::runtime_error if the batch instructions don't match the instruction set, or if the data sources of
+     * a lane don't match those of the environment or are not arrays read in place.
+     */
+    BatchExecutionEngine(const Environment& env, const BatchInstructionSet& batchSet,
+                         const std::vector<std::vector<std::reference_wrapper<const Data::DataHandler>>>& laneDataSources);
+
+    BatchExecutionEngine(const BatchExecutionEngine& other) = delete;
+
+    BatchExecutionEngine& operator=(const BatchExecutionEngine& other) = delete;
+
+    /// Number of lanes.
+    size_t getNbLanes() const;
+
+    /**
+     * \brief Executes the graph from a root for some lanes.
+     *
+     * \param root the root.
+     * \param lanes the lanes executing the graph, each one at most once.
+     * \param actionIDs set to the ID of the action reached by each of the lanes, at the index of the lane, other
+     * lanes keeping their value. Resized to the number of lanes if needed.
+     * \throws std::runtime_error as TPG::TPGExecutionEngine::executeFromRoot.
+     */
+    void executeFromRoot(const TPG::TPGVertex& root, const std::vector<size_t>& lanes,
+                         std::vector<uint64_t>& actionIDs);
+};
+
+
+#endif //GEGELATI_TETRIS_BATCHEXECUTIONENGINE_H
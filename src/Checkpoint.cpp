@@ -0,0 +1,353 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Checkpoint.h"
+
+namespace {
+    const char MAGIC[8] = {'T', 'C', 'K', 'P', 0, 0, 0, 0};
+
+    /// Index of a team in the vertices section, and of a missing best root
+    const uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+    /// Number of words of the header, magic number included
+    const size_t HEADER_SIZE = 21;
+
+    /// Read only view on a whole file, memory mapped when possible
+    class MappedFile {
+    private:
+        const uint8_t* data;
+        size_t size;
+#ifdef _WIN32
+        std::vector<uint8_t> content;
+#endif
+
+    public:
+        explicit MappedFile(const std::string& path) : data(nullptr), size(0) {
+#ifdef _WIN32
+            std::ifstream file(path, std::ios::binary);
+            if(!file)
+                throw std::runtime_error("Error opening checkpoint file " + path + ".");
+            content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            data = content.data();
+            size = content.size();
+#else
+            int fd = open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+                throw std::runtime_error("Error opening checkpoint file " + path + ".");
+
+            struct stat fileStat;
+            if(fstat(fd, &fileStat) == 0 && fileStat.st_size > 0){
+                size = (size_t)fileStat.st_size;
+                void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(address == MAP_FAILED)
+                    size = 0;
+                else
+                    data = (const uint8_t*)address;
+            }
+            ::close(fd);
+
+            if(data == nullptr)
+                throw std::runtime_error("Error mapping checkpoint file " + path + ".");
+#endif
+        }
+
+        MappedFile(const MappedFile& other) = delete;
+
+        MappedFile& operator=(const MappedFile& other) = delete;
+
+        ~MappedFile() {
+#ifndef _WIN32
+            if(data != nullptr)
+                munmap((void*)data, size);
+#endif
+        }
+
+        const uint8_t* getData() const { return data; }
+
+        size_t getSize() const { return size; }
+    };
+
+    /// Sequential reader of the words of a checkpoint
+    class WordReader {
+    private:
+        const uint8_t* data;
+        size_t nbWords;
+        size_t position;
+
+    public:
+        WordReader(const uint8_t* data, size_t size) : data(data), nbWords(size / sizeof(uint64_t)), position(0) {}
+
+        /// Checks that count items of wordsPerItem words remain
+        void require(uint64_t count, uint64_t wordsPerItem = 1) const {
+            if(wordsPerItem > 0 && count > (nbWords - position) / wordsPerItem)
+                throw std::runtime_error("Truncated checkpoint file.");
+        }
+
+        uint64_t next() {
+            require(1);
+            uint64_t word;
+            memcpy(&word, data + sizeof(uint64_t) * position++, sizeof(uint64_t));
+            return word;
+        }
+
+        /// Reads an index, checking it is lower than bound
+        uint64_t nextIndex(uint64_t bound) {
+            uint64_t index = next();
+            if(index >= bound)
+                throw std::runtime_error("Invalid index in checkpoint file.");
+            return index;
+        }
+    };
+
+    /// Sizes of an Environment that saved programs depend on
+    std::vector<uint64_t> getEnvironmentSizes(const Environment& env) {
+        return {env.getNbInstructions(), env.getNbDataSources(), env.getNbRegisters(), env.getNbConstant(),
+                env.getMaxNbOperands()};
+    }
+}
+
+std::vector<uint64_t> serializeCheckpoint(const Checkpoint& checkpoint, const TPG::TPGGraph& graph,
+                                          const TPG::TPGVertex* bestRoot) {
+    const Environment& env = graph.getEnvironment();
+    const uint64_t nbConstants = env.getNbConstant();
+    const uint64_t nbOperands = env.getMaxNbOperands();
+
+    // Indexes of vertices and programs, edges being listed per source vertex
+    const std::vector<const TPG::TPGVertex*> vertices = graph.getVertices();
+    std::unordered_map<const TPG::TPGVertex*, uint64_t> vertexIndexes;
+    for(const TPG::TPGVertex* vertex : vertices)
+        vertexIndexes.emplace(vertex, vertexIndexes.size());
+
+    std::vector<uint64_t> edges;
+    std::vector<const Program::Program*> programs;
+    std::unordered_map<const Program::Program*, uint64_t> programIndexes;
+    uint64_t nbLines = 0;
+    for(const TPG::TPGVertex* vertex : vertices){
+        for(const TPG::TPGEdge* edge : vertex->getOutgoingEdges()){
+            const Program::Program* program = &edge->getProgram();
+            if(programIndexes.emplace(program, programs.size()).second){
+                programs.push_back(program);
+                nbLines += program->getNbLines();
+            }
+            edges.push_back(vertexIndexes.at(vertex));
+            edges.push_back(vertexIndexes.at(edge->getDestination()));
+            edges.push_back(programIndexes.at(program));
+        }
+    }
+
+    std::vector<uint64_t> words(sizeof(MAGIC) / sizeof(uint64_t));
+    memcpy(words.data(), MAGIC, sizeof(MAGIC));
+
+    uint64_t averageForbiddenMoves;
+    memcpy(&averageForbiddenMoves, &checkpoint.averageForbiddenMoves, sizeof(uint64_t));
+
+    words.insert(words.end(), {Checkpoint::FORMAT_VERSION, checkpoint.generation, checkpoint.seed, (uint64_t)checkpoint.width,
+                               (uint64_t)checkpoint.height, (uint64_t)checkpoint.actionMode,
+                               (uint64_t)checkpoint.randomizer, (uint64_t)checkpoint.observation,
+                               (uint64_t)(int64_t)checkpoint.gameScoreRecord,
+                               averageForbiddenMoves});
+    const std::vector<uint64_t> environmentSizes = getEnvironmentSizes(env);
+    words.insert(words.end(), environmentSizes.begin(), environmentSizes.end());
+    words.insert(words.end(), {vertices.size(), edges.size() / 3, programs.size(), nbLines,
+                               bestRoot != nullptr ? vertexIndexes.at(bestRoot) : NONE});
+
+    for(const TPG::TPGVertex* vertex : vertices){
+        auto action = dynamic_cast<const TPG::TPGAction*>(vertex);
+        words.push_back(action != nullptr ? action->getActionID() : NONE);
+    }
+
+    words.insert(words.end(), edges.begin(), edges.end());
+
+    uint64_t firstLine = 0;
+    for(const Program::Program* program : programs){
+        words.push_back(firstLine);
+        firstLine += program->getNbLines();
+    }
+    words.push_back(firstLine);
+
+    for(const Program::Program* program : programs)
+        for(uint64_t i = 0; i < nbConstants; i++)
+            words.push_back((uint64_t)(int64_t)(int32_t)program->getConstantAt(i));
+
+    for(const Program::Program* program : programs){
+        for(uint64_t l = 0; l < program->getNbLines(); l++){
+            const Program::Line& line = program->getLine(l);
+            words.push_back(line.getInstructionIndex());
+            words.push_back(line.getDestinationIndex());
+            for(uint64_t o = 0; o < nbOperands; o++){
+                words.push_back(line.getOperand(o).first);
+                words.push_back(line.getOperand(o).second);
+            }
+        }
+    }
+
+    return words;
+}
+
+void saveCheckpoint(const std::string& path, const Checkpoint& checkpoint, const TPG::TPGGraph& graph,
+                    const TPG::TPGVertex* bestRoot) {
+    const std::vector<uint64_t> words = serializeCheckpoint(checkpoint, graph, bestRoot);
+
+    // Written aside, then renamed over the previous checkpoint
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary);
+        file.write((const char*)words.data(), words.size() * sizeof(uint64_t));
+        if(!file)
+            throw std::runtime_error("Error writing checkpoint file " + tmpPath + ".");
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Error renaming checkpoint file " + tmpPath + ".");
+}
+
+const TPG::TPGVertex* loadCheckpoint(const std::string& path, Checkpoint& checkpoint, TPG::TPGGraph& graph) {
+    if(!isCheckpointFile(path))
+        throw std::runtime_error(path + " is not a checkpoint file.");
+
+    MappedFile file(path);
+    return deserializeCheckpoint(file.getData(), file.getSize(), checkpoint, graph);
+}
+
+const TPG::TPGVertex* deserializeCheckpoint(const uint8_t* data, size_t size, Checkpoint& checkpoint,
+                                            TPG::TPGGraph& graph) {
+    WordReader reader(data, size);
+    reader.require(HEADER_SIZE);
+    if(memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Not a checkpoint.");
+    for(size_t i = 0; i < sizeof(MAGIC) / sizeof(uint64_t); i++)
+        reader.next();
+
+    if(reader.next() != Checkpoint::FORMAT_VERSION)
+        throw std::runtime_error("Unsupported checkpoint file version.");
+
+    checkpoint.generation = reader.next();
+    checkpoint.seed = reader.next();
+    checkpoint.width = (int)reader.next();
+    checkpoint.height = (int)reader.next();
+    checkpoint.actionMode = (TetrisActionMode)reader.next();
+    checkpoint.randomizer = (TetrominoRandomizer)reader.next();
+    checkpoint.observation = (TetrisObservation)reader.next();
+    checkpoint.gameScoreRecord = (int)(int64_t)reader.next();
+    uint64_t averageForbiddenMoves = reader.next();
+    memcpy(&checkpoint.averageForbiddenMoves, &averageForbiddenMoves, sizeof(uint64_t));
+
+    const Environment& env = graph.getEnvironment();
+    for(uint64_t size : getEnvironmentSizes(env))
+        if(reader.next() != size)
+            throw std::runtime_error("The Environment of the checkpoint differs from the current one.");
+    const uint64_t nbConstants = env.getNbConstant();
+    const uint64_t nbOperands = env.getMaxNbOperands();
+
+    const uint64_t nbVertices = reader.next();
+    const uint64_t nbEdges = reader.next();
+    const uint64_t nbPrograms = reader.next();
+    const uint64_t nbLines = reader.next();
+    const uint64_t bestRootIndex = reader.next();
+
+    // Sizes are checked before anything is allocated
+    reader.require(nbVertices);
+    reader.require(nbEdges, 3);
+    if(bestRootIndex != NONE && bestRootIndex >= nbVertices)
+        throw std::runtime_error("Invalid index in checkpoint file.");
+
+    graph.clear();
+
+    std::vector<const TPG::TPGVertex*> vertices;
+    vertices.reserve(nbVertices);
+    for(uint64_t i = 0; i < nbVertices; i++){
+        uint64_t actionID = reader.next();
+        if(actionID == NONE)
+            vertices.push_back(&graph.addNewTeam());
+        else
+            vertices.push_back(&graph.addNewAction(actionID));
+    }
+
+    std::vector<uint64_t> edges;
+    edges.reserve(3 * nbEdges);
+    for(uint64_t i = 0; i < nbEdges; i++){
+        edges.push_back(reader.nextIndex(nbVertices));
+        edges.push_back(reader.nextIndex(nbVertices));
+        edges.push_back(reader.nextIndex(nbPrograms));
+    }
+
+    std::vector<uint64_t> firstLines;
+    reader.require(nbPrograms + 1);
+    firstLines.reserve(nbPrograms + 1);
+    for(uint64_t i = 0; i <= nbPrograms; i++){
+        firstLines.push_back(reader.next());
+        if(firstLines.back() > nbLines || (i > 0 && firstLines.back() < firstLines[i - 1]))
+            throw std::runtime_error("Invalid program lines in checkpoint file.");
+    }
+
+    std::vector<std::shared_ptr<Program::Program>> programs;
+    programs.reserve(nbPrograms);
+    reader.require(nbPrograms, nbConstants);
+    for(uint64_t i = 0; i < nbPrograms; i++){
+        programs.push_back(std::make_shared<Program::Program>(env));
+        for(uint64_t c = 0; c < nbConstants; c++)
+            programs.back()->setConstantAt(c, {(int32_t)(int64_t)reader.next()});
+    }
+
+    try {
+        reader.require(nbLines, 2 + 2 * nbOperands);
+        for(uint64_t i = 0; i < nbPrograms; i++){
+            for(uint64_t l = firstLines[i]; l < firstLines[i + 1]; l++){
+                Program::Line& line = programs[i]->addNewLine();
+                line.setInstructionIndex(reader.next());
+                line.setDestinationIndex(reader.next());
+                for(uint64_t o = 0; o < nbOperands; o++){
+                    uint64_t dataSource = reader.next();
+                    line.setOperand(o, {dataSource, reader.next()});
+                }
+            }
+            programs[i]->identifyIntrons();
+        }
+    }
+    catch (const std::out_of_range& e) {
+        throw std::runtime_error(std::string("Invalid program line in checkpoint file : ") + e.what());
+    }
+
+    for(uint64_t i = 0; i < nbEdges; i++)
+        graph.addNewEdge(*vertices[edges[3 * i]], *vertices[edges[3 * i + 1]], programs[edges[3 * i + 2]]);
+
+    return bestRootIndex != NONE ? vertices[bestRootIndex] : nullptr;
+}
+
+bool isCheckpointFile(const std::string& path) {
+    char magic[sizeof(MAGIC)];
+    std::ifstream file(path, std::ios::binary);
+    return file.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+const TPG::TPGVertex* loadPolicy(const std::string& path, Environment& env, TPG::TPGGraph& graph) {
+    const TPG::TPGVertex* root = nullptr;
+    if(isCheckpointFile(path)){
+        Checkpoint checkpoint;
+        root = loadCheckpoint(path, checkpoint, graph);
+    }
+    else {
+        File::TPGGraphDotImporter dot(path.c_str(), env, graph);
+        dot.importGraph();
+    }
+
+    if(root == nullptr)
+        root = graph.getRootVertices().back();
+    return root;
+}
@@ -0,0 +1,120 @@
+#ifndef GEGELATI_TETRIS_CHECKPOINT_H
+#define GEGELATI_TETRIS_CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gegelati.h>
+
+#include "Tetris.h"
+
+/**
+ * \brief State of a training run saved in a checkpoint file, next to its TPG graph.
+ *
+ * Checkpoint files are binary files of 64 bits words in the byte order of the machine, read through a memory
+ * mapping :
+ * - a header with the "TCKP" magic number, the format version, the fields of this structure, the size of the
+ * programs Environment, the number of vertices, edges, programs and program lines, and the index of the best root,
+ * - the vertices in the order of the graph, as their action ID or UINT64_MAX for teams,
+ * - the edges, as the indexes of their source, destination and program, in the order of the outgoing edges of each
+ * vertex,
+ * - the index of the first line of each program, followed by the total number of lines,
+ * - the constants of each program,
+ * - the program lines, as their instruction index, destination index and operands.
+ *
+ * The learning agent archive and the results of the previous evaluations of the roots are not saved : roots are
+ * evaluated again after a resume.
+ */
+struct Checkpoint {
+    /// Version of the file format written by saveCheckpoint()
+    static constexpr uint64_t FORMAT_VERSION = 2;
+
+    /// Last trained generation
+    uint64_t generation = 0;
+
+    /// Seed of the learning agent (see TetrisLearningAgent::init)
+    uint64_t seed = 0;
+
+    /// Grid geometry, action mode, randomizer and observation of the trained environment
+    int width = TETRIS_WIDTH;
+    int height = TETRIS_HEIGHT;
+    TetrisActionMode actionMode = TetrisActionMode::FRAME;
+    TetrominoRandomizer randomizer = TetrominoRandomizer::UNIFORM;
+    TetrisObservation observation = TetrisObservation::COLOURS;
+
+    /// Tetris global stats of the last trained generation
+    int gameScoreRecord = 0;
+    double averageForbiddenMoves = 0;
+};
+
+/**
+ * \brief Saves a checkpoint and a TPG graph in a file.
+ *
+ * The file is first written next to path, then renamed, so that a run killed while saving keeps its previous
+ * checkpoint.
+ *
+ * \param path path of the checkpoint file.
+ * \param checkpoint the training state to save.
+ * \param graph the graph to save.
+ * \param bestRoot the best root of graph, saved for inference, or nullptr.
+ * \throws std::runtime_error if the file can't be written.
+ */
+void saveCheckpoint(const std::string& path, const Checkpoint& checkpoint, const TPG::TPGGraph& graph,
+                    const TPG::TPGVertex* bestRoot);
+
+/**
+ * \brief Loads a checkpoint saved by saveCheckpoint().
+ *
+ * \param path path of the checkpoint file.
+ * \param checkpoint filled with the saved training state.
+ * \param graph cleared, then filled with the saved graph. Its Environment must have the same instruction set, data
+ * sources, number of registers and number of constants as the one of the saved graph.
+ * \return the saved best root in graph, or nullptr if none was saved.
+ * \throws std::runtime_error if the file can't be read, is not a valid checkpoint file, or doesn't match the
+ * Environment of graph.
+ */
+const TPG::TPGVertex* loadCheckpoint(const std::string& path, Checkpoint& checkpoint, TPG::TPGGraph& graph);
+
+/**
+ * \brief Serializes a checkpoint and a TPG graph in memory, in the format of checkpoint files.
+ *
+ * \param checkpoint the training state to save.
+ * \param graph the graph to save.
+ * \param bestRoot the best root of graph, saved for inference, or nullptr.
+ * \return the words of the checkpoint file.
+ */
+std::vector<uint64_t> serializeCheckpoint(const Checkpoint& checkpoint, const TPG::TPGGraph& graph,
+                                          const TPG::TPGVertex* bestRoot);
+
+/**
+ * \brief Loads a checkpoint serialized in memory, as loadCheckpoint() does for files.
+ *
+ * The vertices of graph are added in the order of the vertices of the serialized graph.
+ *
+ * \param data the serialized checkpoint.
+ * \param size the size of data, in bytes.
+ * \param checkpoint filled with the saved training state.
+ * \param graph cleared, then filled with the saved graph.
+ * \return the saved best root in graph, or nullptr if none was saved.
+ * \throws std::runtime_error if data is not a valid checkpoint or doesn't match the Environment of graph.
+ */
+const TPG::TPGVertex* deserializeCheckpoint(const uint8_t* data, size_t size, Checkpoint& checkpoint,
+                                            TPG::TPGGraph& graph);
+
+/// Is the file at path a checkpoint file.
+bool isCheckpointFile(const std::string& path);
+
+/**
+ * \brief Loads a policy from a checkpoint or from a dot file.
+ *
+ * \param path path of the checkpoint or dot file.
+ * \param env the Environment of graph.
+ * \param graph the graph in which the policy is loaded.
+ * \return the best root of the checkpoint, or the last root of the dot file.
+ * \throws std::runtime_error if the checkpoint can't be loaded.
+ */
+const TPG::TPGVertex* loadPolicy(const std::string& path, Environment& env, TPG::TPGGraph& graph);
+
+
+#endif //GEGELATI_TETRIS_CHECKPOINT_H
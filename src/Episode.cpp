@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "Episode.h"
+
+namespace {
+    const char MAGIC[4] = {'T', 'E', 'P', 'I'};
+
+    /// Appends value to out as a LEB128 varint
+    void writeVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while(value >= 0x80){
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    /// Reads a LEB128 varint at in[pos], advancing pos
+    uint64_t readVarint(const std::vector<uint8_t>& in, size_t& pos) {
+        uint64_t value = 0;
+        for(int shift = 0; shift < 64; shift += 7){
+            if(pos >= in.size())
+                throw std::runtime_error("Truncated episode file.");
+            uint8_t byte = in[pos++];
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0)
+                return value;
+        }
+        throw std::runtime_error("Invalid varint in episode file.");
+    }
+}
+
+Episode::Episode(int width, int height, TetrisActionMode actionMode, TetrominoRandomizer randomizer, uint64_t seed,
+                 Learn::LearningMode mode) : width(width), height(height), actionMode(actionMode),
+                 randomizer(randomizer), seed(seed), mode(mode), gameScore(0) {}
+
+void Episode::addAction(uint64_t actionID) {
+    this->actions.push_back(actionID);
+}
+
+void Episode::setGameScore(int score) {
+    this->gameScore = score;
+}
+
+int Episode::getWidth() const { return this->width; }
+
+int Episode::getHeight() const { return this->height; }
+
+TetrisActionMode Episode::getActionMode() const { return this->actionMode; }
+
+TetrominoRandomizer Episode::getRandomizer() const { return this->randomizer; }
+
+uint64_t Episode::getSeed() const { return this->seed; }
+
+Learn::LearningMode Episode::getMode() const { return this->mode; }
+
+const std::vector<uint64_t>& Episode::getActions() const { return this->actions; }
+
+int Episode::getGameScore() const { return this->gameScore; }
+
+uint64_t Episode::getNbActionIDs() const {
+    // Same action spaces as Tetris
+    return this->actionMode == TetrisActionMode::PLACEMENT ? 4 * this->width : 5;
+}
+
+unsigned int Episode::getNbBitsPerAction() const {
+    unsigned int nbBits = 1;
+    while(((uint64_t)1 << nbBits) < getNbActionIDs())
+        nbBits++;
+    return nbBits;
+}
+
+void Episode::save(const std::string& path) const {
+    std::vector<uint8_t> data(std::begin(MAGIC), std::end(MAGIC));
+    data.push_back(FORMAT_VERSION);
+    data.push_back((uint8_t)this->width);
+    data.push_back((uint8_t)this->height);
+    data.push_back((uint8_t)this->actionMode);
+    data.push_back((uint8_t)this->randomizer);
+    data.push_back((uint8_t)this->mode);
+    writeVarint(data, this->seed);
+    writeVarint(data, (uint64_t)this->gameScore);
+    writeVarint(data, this->actions.size());
+
+    // Packed actions
+    const unsigned int nbBits = getNbBitsPerAction();
+    uint64_t buffer = 0;
+    unsigned int nbBuffered = 0;
+    for(uint64_t action : this->actions){
+        buffer |= action << nbBuffered;
+        nbBuffered += nbBits;
+        while(nbBuffered >= 8){
+            data.push_back((uint8_t)buffer);
+            buffer >>= 8;
+            nbBuffered -= 8;
+        }
+    }
+    if(nbBuffered > 0)
+        data.push_back((uint8_t)buffer);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    if(!file)
+        throw std::runtime_error("Error writing episode file " + path + ".");
+}
+
+Episode Episode::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        throw std::runtime_error("Error opening episode file " + path + ".");
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    const size_t headerSize = sizeof(MAGIC) + 6;
+    if(data.size() < headerSize || !std::equal(std::begin(MAGIC), std::end(MAGIC), data.begin()))
+        throw std::runtime_error(path + " is not an episode file.");
+    if(data[4] != FORMAT_VERSION)
+        throw std::runtime_error("Unsupported episode file version " + std::to_string(data[4]) + ".");
+
+    // Values of an enum are those of its enumerators, in order
+    if(data[7] > (uint8_t)TetrisActionMode::PLACEMENT || data[8] > (uint8_t)TetrominoRandomizer::BAG
+       || data[9] > (uint8_t)Learn::LearningMode::TESTING)
+        throw std::runtime_error("Invalid game settings in episode file " + path + ".");
+
+    Episode episode(data[5], data[6], (TetrisActionMode)data[7], (TetrominoRandomizer)data[8], 0,
+                    (Learn::LearningMode)data[9]);
+    size_t pos = headerSize;
+    episode.seed = readVarint(data, pos);
+    episode.gameScore = (int)readVarint(data, pos);
+    const uint64_t nbActions = readVarint(data, pos);
+
+    // Unpacks actions
+    const unsigned int nbBits = episode.getNbBitsPerAction();
+    if(nbActions > (data.size() - pos) * 8 / nbBits)
+        throw std::runtime_error("Truncated episode file.");
+    episode.actions.reserve(nbActions);
+    uint64_t buffer = 0;
+    unsigned int nbBuffered = 0;
+    for(uint64_t i = 0; i < nbActions; i++){
+        while(nbBuffered < nbBits){
+            buffer |= (uint64_t)data[pos++] << nbBuffered;
+            nbBuffered += 8;
+        }
+        const uint64_t action = buffer & (((uint64_t)1 << nbBits) - 1);
+        if(action >= episode.getNbActionIDs())
+            throw std::runtime_error("Invalid action in episode file " + path + ".");
+        episode.actions.push_back(action);
+        buffer >>= nbBits;
+        nbBuffered -= nbBits;
+    }
+
+    return episode;
+}
+
+Episode recordEpisode(TPG::TPGExecutionEngine& tee, const TPG::TPGVertex& root, Tetris<>& le, uint64_t seed,
+                      Learn::LearningMode mode, uint64_t maxNbActions) {
+    Episode episode(Tetris<>::WIDTH, Tetris<>::HEIGHT, le.getActionMode(), le.getRandomizer(), seed, mode);
+    le.reset(seed, mode);
+
+    uint64_t actionID = 0;
+    uint64_t observationVersion = le.getObservationVersion();
+    for(uint64_t i = 0; i < maxNbActions && !le.isTerminal(); i++){
+        // The TPG is only executed when its observation changed, its action being the same otherwise
+        if(i == 0 || le.getObservationVersion() != observationVersion){
+            observationVersion = le.getObservationVersion();
+            auto vertexList = tee.executeFromRoot(root);
+            actionID = ((const TPG::TPGAction*)vertexList.back())->getActionID();
+        }
+        episode.addAction(actionID);
+        le.doAction(actionID);
+    }
+
+    episode.setGameScore(le.getGameScore());
+    return episode;
+}
@@ -0,0 +1,128 @@
+#ifndef GEGELATI_TETRIS_EPISODE_H
+#define GEGELATI_TETRIS_EPISODE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gegelati.h>
+
+#include "Tetris.h"
+
+/**
+ * \brief Actions of a Tetris game, with what is needed to play it again.
+ *
+ * Tetris games are deterministic : a game reset with the same seed and learning mode, on a grid of the same size
+ * with the same action mode and randomizer, goes through the same states when receiving the same actions.
+ * An episode thus replays a game without the policy that played it.
+ *
+ * Episodes are saved in a compact binary file :
+ * - the "TEPI" magic number and the format version,
+ * - the grid width and height, the action mode, the randomizer and the learning mode, one byte each,
+ * - the seed, the number of cleared lines and the number of actions, as LEB128 varints,
+ * - the actions, packed with the smallest number of bits holding all actions of the action mode (3 bits in frame
+ * mode), least significant bits first.
+ */
+class Episode {
+public:
+
+    /// Version of the file format written by save()
+    static constexpr uint8_t FORMAT_VERSION = 1;
+
+private:
+
+    /// Grid geometry of the game
+    int width;
+    int height;
+
+    /// Action mode of the game
+    TetrisActionMode actionMode;
+
+    /// Tetromino randomizer of the game
+    TetrominoRandomizer randomizer;
+
+    /// Seed and learning mode given to Tetris::reset
+    uint64_t seed;
+    Learn::LearningMode mode;
+
+    /// Actions given to Tetris::doAction, one per frame
+    std::vector<uint64_t> actions;
+
+    /// Number of cleared lines at the end of the episode, to check replays
+    int gameScore;
+
+    /// Number of bits of the packed actions
+    unsigned int getNbBitsPerAction() const;
+
+public:
+
+    /**
+     * \brief Constructor of an episode without actions.
+     *
+     * \param width width of the grid.
+     * \param height height of the grid.
+     * \param actionMode action mode of the game.
+     * \param randomizer tetromino randomizer of the game.
+     * \param seed seed given to Tetris::reset.
+     * \param mode learning mode given to Tetris::reset.
+     */
+    Episode(int width, int height, TetrisActionMode actionMode, TetrominoRandomizer randomizer, uint64_t seed,
+            Learn::LearningMode mode);
+
+    /// Appends an action to the episode.
+    void addAction(uint64_t actionID);
+
+    /// Sets the number of cleared lines at the end of the episode.
+    void setGameScore(int score);
+
+    int getWidth() const;
+
+    int getHeight() const;
+
+    TetrisActionMode getActionMode() const;
+
+    TetrominoRandomizer getRandomizer() const;
+
+    uint64_t getSeed() const;
+
+    Learn::LearningMode getMode() const;
+
+    const std::vector<uint64_t>& getActions() const;
+
+    int getGameScore() const;
+
+    /// Number of actions of the action mode of the episode.
+    uint64_t getNbActionIDs() const;
+
+    /**
+     * \brief Saves the episode in a file.
+     *
+     * \throws std::runtime_error if the file can't be written.
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * \brief Loads an episode saved by save().
+     *
+     * \throws std::runtime_error if the file can't be read or is not a valid episode file.
+     */
+    static Episode load(const std::string& path);
+};
+
+/**
+ * \brief Plays a game with a policy and records it.
+ *
+ * As during evaluations, the policy is only executed when the observation of the environment changed.
+ *
+ * \param tee execution engine whose Environment observes le.
+ * \param root root of the policy.
+ * \param le environment in which the game is played, reset with seed and mode.
+ * \param seed seed of the game.
+ * \param mode learning mode of the game.
+ * \param maxNbActions maximum number of actions of the game.
+ */
+Episode recordEpisode(TPG::TPGExecutionEngine& tee, const TPG::TPGVertex& root, Tetris<>& le, uint64_t seed,
+                      Learn::LearningMode mode, uint64_t maxNbActions);
+
+
+#endif //GEGELATI_TETRIS_EPISODE_H
@@ -0,0 +1,68 @@
+#include <map>
+
+#include "PolicySnapshot.h"
+
+PolicySnapshot::PolicySnapshot(const TPG::TPGGraph& graph, const TPG::TPGVertex& root, uint64_t generation) :
+        graph(std::make_unique<TPG::TPGGraph>(graph.getEnvironment())), root(nullptr), generation(generation) {
+    this->root = copyVertices({&root}).front();
+}
+
+PolicySnapshot::PolicySnapshot(const TPG::TPGGraph& graph, uint64_t generation) :
+        graph(std::make_unique<TPG::TPGGraph>(graph.getEnvironment())), root(nullptr), generation(generation) {
+    copyVertices(graph.getVertices());
+}
+
+std::vector<const TPG::TPGVertex*> PolicySnapshot::copyVertices(const std::vector<const TPG::TPGVertex*>& vertices) {
+
+    // Copies of the vertices to copy, in discovery order
+    std::map<const TPG::TPGVertex*, const TPG::TPGVertex*> copies;
+    std::vector<const TPG::TPGVertex*> originals;
+
+    auto copyVertex = [&](const TPG::TPGVertex* vertex){
+        if(copies.count(vertex) != 0)
+            return;
+
+        auto action = dynamic_cast<const TPG::TPGAction*>(vertex);
+        if(action != nullptr)
+            copies[vertex] = &this->graph->addNewAction(action->getActionID());
+        else
+            copies[vertex] = &this->graph->addNewTeam();
+        originals.push_back(vertex);
+    };
+
+    for(const TPG::TPGVertex* vertex : vertices)
+        copyVertex(vertex);
+    for(size_t i = 0; i < originals.size(); i++)
+        for(const TPG::TPGEdge* edge : originals[i]->getOutgoingEdges())
+            copyVertex(edge->getDestination());
+
+    // Edges are added in the order of the original outgoing edges, which the execution engine relies on to
+    // break ties between bids
+    std::map<const Program::Program*, std::shared_ptr<Program::Program>> programs;
+    for(const TPG::TPGVertex* vertex : originals){
+        for(const TPG::TPGEdge* edge : vertex->getOutgoingEdges()){
+            auto& program = programs[&edge->getProgram()];
+            if(program == nullptr)
+                program = std::make_shared<Program::Program>(edge->getProgram());
+
+            this->graph->addNewEdge(*copies[vertex], *copies[edge->getDestination()], program);
+        }
+    }
+
+    std::vector<const TPG::TPGVertex*> result;
+    for(const TPG::TPGVertex* vertex : vertices)
+        result.push_back(copies[vertex]);
+    return result;
+}
+
+const TPG::TPGGraph& PolicySnapshot::getGraph() const {
+    return *this->graph;
+}
+
+const TPG::TPGVertex* PolicySnapshot::getRoot() const {
+    return this->root;
+}
+
+uint64_t PolicySnapshot::getGeneration() const {
+    return this->generation;
+}
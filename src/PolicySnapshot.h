@@ -0,0 +1,77 @@
+#ifndef GEGELATI_TETRIS_POLICYSNAPSHOT_H
+#define GEGELATI_TETRIS_POLICYSNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gegelati.h>
+
+/**
+ * \brief Copy of the policy of a root, or of a whole graph, independent from the graph it was taken from.
+ *
+ * The snapshot holds a new graph containing the root and all the vertices reachable from it (or all the vertices of
+ * the graph), with their edges in the same order and copies of their programs. It can thus be executed or exported
+ * by another thread while the original graph is modified (mutations, removal of roots, intron clearing).
+ */
+class PolicySnapshot {
+private:
+
+    /// Graph containing the copied policy
+    std::unique_ptr<TPG::TPGGraph> graph;
+
+    /// Root of the policy in graph, nullptr for a copy of a whole graph
+    const TPG::TPGVertex* root;
+
+    /// Generation at which the policy was copied
+    uint64_t generation;
+
+    /**
+     * \brief Copies vertices and their outgoing edges into graph.
+     *
+     * Vertices reachable from the given ones are copied too, after them.
+     *
+     * \return the copies of the given vertices.
+     */
+    std::vector<const TPG::TPGVertex*> copyVertices(const std::vector<const TPG::TPGVertex*>& vertices);
+
+public:
+
+    /**
+     * \brief Copies the policy of a root.
+     *
+     * Programs shared by several edges of the original graph stay shared in the copy. The copied graph uses the
+     * same Environment as the original one.
+     *
+     * \param graph the graph containing the root.
+     * \param root the root of the policy to copy.
+     * \param generation the generation at which the policy is copied.
+     */
+    PolicySnapshot(const TPG::TPGGraph& graph, const TPG::TPGVertex& root, uint64_t generation);
+
+    /**
+     * \brief Copies a whole graph.
+     *
+     * Vertices are copied in the order of the original graph, programs shared by several edges stay shared.
+     *
+     * \param graph the graph to copy.
+     * \param generation the generation at which the graph is copied.
+     */
+    PolicySnapshot(const TPG::TPGGraph& graph, uint64_t generation);
+
+    PolicySnapshot(const PolicySnapshot& other) = delete;
+
+    PolicySnapshot& operator=(const PolicySnapshot& other) = delete;
+
+    /// Graph containing the copied policy.
+    const TPG::TPGGraph& getGraph() const;
+
+    /// Root of the copied policy, nullptr for a copy of a whole graph.
+    const TPG::TPGVertex* getRoot() const;
+
+    /// Generation at which the policy was copied.
+    uint64_t getGeneration() const;
+};
+
+
+#endif //GEGELATI_TETRIS_POLICYSNAPSHOT_H
@@ -0,0 +1,240 @@
+#include <iomanip>
+#include <iostream>
+
+#include "Profiler.h"
+
+/// Names of the phases in the CSV header and in the trace
+static const char* const PHASE_NAMES[(int)ProfilePhase::NB_PHASES] = {
+        "generation", "dotExport", "mutation", "evaluation", "decimation", "validation", "rootEvaluation", "episode",
+        "inference", "doAction", "checkpoint", "record", "replayHandoff", "dotWrite"
+};
+
+/// Names of the counters in the CSV header
+static const char* const COUNTER_NAMES[(int)ProfileCounter::NB_COUNTERS] = {
+        "episodes", "frames", "decisions", "locks", "lineClears", "forbiddenMoves"
+};
+
+/// Phases happening once per frame, too many to be kept in the trace
+static bool isTraced(ProfilePhase phase) {
+    return phase != ProfilePhase::EPISODE && phase != ProfilePhase::INFERENCE && phase != ProfilePhase::DO_ACTION;
+}
+
+std::atomic<bool> Profiler::enabled(false);
+std::mutex Profiler::mutex;
+std::vector<std::unique_ptr<Profiler::ThreadProfile>> Profiler::profiles;
+std::ofstream Profiler::csv;
+std::ofstream Profiler::trace;
+bool Profiler::hasTraceEvents = false;
+Profiler::Clock::time_point Profiler::origin;
+
+Profiler::ThreadProfile::ThreadProfile(size_t index) : index(index) {}
+
+Profiler::ThreadSlot::~ThreadSlot() {
+    if(this->profile != nullptr){
+        std::lock_guard<std::mutex> lock(Profiler::mutex);
+        this->profile->inUse = false;
+    }
+}
+
+bool Profiler::start(const std::string& csvPath, const std::string& tracePath) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!open(csvPath, tracePath))
+            return false;
+    }
+
+    // The calling thread, running the training loop, is the first thread of the CSV and of the trace
+    getThreadProfile();
+
+    origin = Clock::now();
+    enabled = true;
+    return true;
+}
+
+bool Profiler::open(const std::string& csvPath, const std::string& tracePath) {
+    csv.open(csvPath);
+    if(!csv.is_open()){
+        std::cerr << "Can't profile, " << csvPath << " opening failed" << std::endl;
+        return false;
+    }
+
+    csv << "generation,thread";
+    for(const char* name : PHASE_NAMES)
+        csv << "," << name << "Seconds";
+    for(const char* name : COUNTER_NAMES)
+        csv << "," << name;
+    csv << std::endl;
+
+    if(!tracePath.empty()){
+        trace.open(tracePath);
+        if(!trace.is_open())
+            std::cerr << "Can't save the profiler trace, " << tracePath << " opening failed" << std::endl;
+        else
+            trace << "{\"traceEvents\":[" << std::endl << std::fixed << std::setprecision(3);
+    }
+
+    return true;
+}
+
+void Profiler::stop() {
+    enabled = false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    csv.close();
+
+    if(trace.is_open()){
+        // Names of the threads, the first profile being the one of the training loop
+        for(const auto& profile : profiles){
+            std::string name = (profile->index == 0) ? "main" : "thread " + std::to_string(profile->index);
+            trace << (hasTraceEvents ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+                  << profile->index << ",\"args\":{\"name\":\"" << name << "\"}}";
+            hasTraceEvents = true;
+        }
+        trace << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+        trace.close();
+    }
+}
+
+Profiler::ThreadProfile& Profiler::getThreadProfile() {
+    static thread_local ThreadSlot slot;
+
+    if(slot.profile == nullptr){
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(const auto& profile : profiles){
+            if(!profile->inUse){
+                profile->inUse = true;
+                slot.profile = profile.get();
+                break;
+            }
+        }
+
+        if(slot.profile == nullptr){
+            profiles.push_back(std::make_unique<ThreadProfile>(profiles.size()));
+            slot.profile = profiles.back().get();
+        }
+    }
+
+    return *slot.profile;
+}
+
+void Profiler::record(ProfilePhase phase, Clock::time_point begin, Clock::time_point end) {
+    ThreadProfile& profile = getThreadProfile();
+
+    // Only the calling thread writes its totals
+    std::atomic<uint64_t>& total = profile.nanoseconds[(int)phase];
+    uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    total.store(total.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+
+    if(isTraced(phase)){
+        std::lock_guard<std::mutex> lock(profile.eventsMutex);
+        profile.events.push_back({phase, begin, end});
+    }
+}
+
+void Profiler::addCount(ProfileCounter counter, uint64_t value) {
+    std::atomic<uint64_t>& total = getThreadProfile().counters[(int)counter];
+    total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Profiler::endGeneration(uint64_t generation) {
+    if(!isEnabled())
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint64_t allNanoseconds[(int)ProfilePhase::NB_PHASES] = {};
+    uint64_t allCounters[(int)ProfileCounter::NB_COUNTERS] = {};
+
+    for(const auto& profile : profiles){
+        uint64_t nanoseconds[(int)ProfilePhase::NB_PHASES];
+        uint64_t counters[(int)ProfileCounter::NB_COUNTERS];
+        bool active = false;
+
+        for(int p = 0; p < (int)ProfilePhase::NB_PHASES; p++){
+            uint64_t total = profile->nanoseconds[p].load(std::memory_order_relaxed);
+            nanoseconds[p] = total - profile->writtenNanoseconds[p];
+            profile->writtenNanoseconds[p] = total;
+            allNanoseconds[p] += nanoseconds[p];
+            active = active || nanoseconds[p] != 0;
+        }
+        for(int c = 0; c < (int)ProfileCounter::NB_COUNTERS; c++){
+            uint64_t total = profile->counters[c].load(std::memory_order_relaxed);
+            counters[c] = total - profile->writtenCounters[c];
+            profile->writtenCounters[c] = total;
+            allCounters[c] += counters[c];
+            active = active || counters[c] != 0;
+        }
+
+        // Threads that did nothing during the generation are left out
+        if(active){
+            csv << generation << "," << profile->index;
+            for(uint64_t value : nanoseconds)
+                csv << "," << value * 1e-9;
+            for(uint64_t value : counters)
+                csv << "," << value;
+            csv << "\n";
+        }
+
+        std::vector<TraceEvent> events;
+        {
+            std::lock_guard<std::mutex> eventsLock(profile->eventsMutex);
+            events.swap(profile->events);
+        }
+
+        if(trace.is_open()){
+            for(const TraceEvent& event : events){
+                trace << (hasTraceEvents ? ",\n" : "") << "{\"name\":\"" << PHASE_NAMES[(int)event.phase]
+                      << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << profile->index << ",\"ts\":"
+                      << std::chrono::duration<double, std::micro>(event.begin - origin).count() << ",\"dur\":"
+                      << std::chrono::duration<double, std::micro>(event.end - event.begin).count() << "}";
+                hasTraceEvents = true;
+            }
+        }
+    }
+
+    csv << generation << ",all";
+    for(uint64_t value : allNanoseconds)
+        csv << "," << value * 1e-9;
+    for(uint64_t value : allCounters)
+        csv << "," << value;
+    csv << std::endl;
+
+    trace.flush();
+}
+
+ProfilerLogger::ProfilerLogger(Learn::LearningAgent& la) : Log::LALogger(la) {}
+
+void ProfilerLogger::endStep(ProfilePhase phase) {
+    Profiler::Clock::time_point now = Profiler::Clock::now();
+    if(Profiler::isEnabled())
+        Profiler::record(phase, this->stepBegin, now);
+    this->stepBegin = now;
+}
+
+void ProfilerLogger::logHeader() {}
+
+void ProfilerLogger::logNewGeneration(uint64_t&) {
+    this->stepBegin = Profiler::Clock::now();
+}
+
+void ProfilerLogger::logAfterPopulateTPG() {
+    endStep(ProfilePhase::MUTATION);
+}
+
+void ProfilerLogger::logAfterEvaluate(std::multimap<std::shared_ptr<Learn::EvaluationResult>,
+                                      const TPG::TPGVertex*>&) {
+    endStep(ProfilePhase::EVALUATION);
+}
+
+void ProfilerLogger::logAfterDecimate() {
+    endStep(ProfilePhase::DECIMATION);
+}
+
+void ProfilerLogger::logAfterValidate(std::multimap<std::shared_ptr<Learn::EvaluationResult>,
+                                      const TPG::TPGVertex*>&) {
+    endStep(ProfilePhase::VALIDATION);
+}
+
+void ProfilerLogger::logEndOfTraining() {}
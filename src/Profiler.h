@@ -0,0 +1,259 @@
+#ifndef GEGELATI_TETRIS_PROFILER_H
+#define GEGELATI_TETRIS_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gegelati.h>
+
+/// Timed phases of the training
+enum class ProfilePhase {
+    /// Whole generation, in the training loop
+    GENERATION,
+    /// Copy of the graph pushed to the dot export thread
+    DOT_EXPORT,
+    /// Steps of Learn::LearningAgent::trainOneGeneration
+    MUTATION,
+    EVALUATION,
+    DECIMATION,
+    VALIDATION,
+    /// Evaluation of a root by a worker thread
+    ROOT_EVALUATION,
+    /// Episode played during a root evaluation
+    EPISODE,
+    /// TPG execution and Tetris::doAction call during an episode
+    INFERENCE,
+    DO_ACTION,
+    /// Saving the checkpoint, recording the episode of the best root and posting its policy to the replay thread
+    CHECKPOINT,
+    RECORD,
+    REPLAY_HANDOFF,
+    /// Graph written by the dot export thread
+    DOT_WRITE,
+    NB_PHASES
+};
+
+/// Events counted during the evaluation of roots
+enum class ProfileCounter {
+    EPISODES,
+    FRAMES,
+    /// TPG executions
+    DECISIONS,
+    /// Locked tetrominos
+    LOCKS,
+    LINE_CLEARS,
+    FORBIDDEN_MOVES,
+    NB_COUNTERS
+};
+
+/**
+ * \brief Per thread timers and counters of the training, merged at the end of each generation.
+ *
+ * Each thread recording phases or counters gets its own profile, so that recording never waits for other threads :
+ * phase durations and counters are accumulated in the profile of the calling thread, and only the coarse phases
+ * (not EPISODE, INFERENCE and DO_ACTION, which happen once per frame) are also kept as events for the trace.
+ * Profiles of finished threads are reused by the next threads, gegelati starting new worker threads for every
+ * evaluation.
+ *
+ * At the end of each generation, endGeneration() writes a CSV row for each thread, with the seconds spent in each
+ * phase and the counters since the previous generation, followed by an "all" row summing the threads. The events
+ * are written to a Chrome trace-event JSON file (chrome://tracing or https://ui.perfetto.dev), when enabled.
+ *
+ * The profiler is disabled until start() : a disabled ProfileScope or count() then only costs a relaxed atomic load
+ * and a branch.
+ */
+class Profiler {
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * \brief Enables the profiler.
+     *
+     * \param csvPath path of the CSV file.
+     * \param tracePath path of the trace-event JSON file, empty for no trace.
+     * \return false if a file can't be opened, the profiler staying disabled.
+     */
+    static bool start(const std::string& csvPath, const std::string& tracePath = "");
+
+    /// Writes the end of the trace, closes the files and disables the profiler.
+    static void stop();
+
+    /// Is the profiler enabled.
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /// Adds a phase of the calling thread, from begin to end.
+    static void record(ProfilePhase phase, Clock::time_point begin, Clock::time_point end);
+
+    /// Adds value to a counter of the calling thread, if the profiler is enabled.
+    static void count(ProfileCounter counter, uint64_t value) {
+        if(isEnabled())
+            addCount(counter, value);
+    }
+
+    /**
+     * \brief Writes the phases and counters of all threads since the previous generation.
+     *
+     * Phases still running are written with the next generation.
+     *
+     * \param generation number of the generation, in the CSV rows.
+     */
+    static void endGeneration(uint64_t generation);
+
+private:
+
+    /// Phase kept for the trace
+    struct TraceEvent {
+        ProfilePhase phase;
+        Clock::time_point begin;
+        Clock::time_point end;
+    };
+
+    /// Timers and counters of a thread
+    struct ThreadProfile {
+        /// Index of the thread in the CSV and in the trace
+        size_t index;
+
+        /// Is the profile used by a running thread, protected by Profiler::mutex
+        bool inUse = true;
+
+        /// Totals since start, only written by the thread using the profile
+        std::atomic<uint64_t> nanoseconds[(int)ProfilePhase::NB_PHASES] = {};
+        std::atomic<uint64_t> counters[(int)ProfileCounter::NB_COUNTERS] = {};
+
+        /// Totals written in the CSV by the previous endGeneration(), protected by Profiler::mutex
+        uint64_t writtenNanoseconds[(int)ProfilePhase::NB_PHASES] = {};
+        uint64_t writtenCounters[(int)ProfileCounter::NB_COUNTERS] = {};
+
+        /// Events not written yet, protected by eventsMutex
+        std::mutex eventsMutex;
+        std::vector<TraceEvent> events;
+
+        explicit ThreadProfile(size_t index);
+    };
+
+    /// Gives the profile back when its thread exits
+    struct ThreadSlot {
+        ThreadProfile* profile = nullptr;
+
+        ~ThreadSlot();
+    };
+
+    /// Is the profiler enabled
+    static std::atomic<bool> enabled;
+
+    /// Protects the profiles list, the files and the written totals
+    static std::mutex mutex;
+
+    /// Profiles of all threads, never destroyed so that threads can keep pointers to them
+    static std::vector<std::unique_ptr<ThreadProfile>> profiles;
+
+    /// Output files
+    static std::ofstream csv;
+    static std::ofstream trace;
+
+    /// Is an event already written in the trace, for the separators
+    static bool hasTraceEvents;
+
+    /// Time of start(), origin of the trace timestamps
+    static Clock::time_point origin;
+
+    /// Opens the output files and writes their header, called by start().
+    static bool open(const std::string& csvPath, const std::string& tracePath);
+
+    /// Profile of the calling thread, taken from the free profiles or created on first use.
+    static ThreadProfile& getThreadProfile();
+
+    /// Adds value to a counter of the calling thread.
+    static void addCount(ProfileCounter counter, uint64_t value);
+};
+
+/**
+ * \brief Records the time between its construction and its destruction, or the call to stop(), as a phase of the
+ * calling thread.
+ *
+ * Nothing is recorded if the profiler was disabled at construction.
+ */
+class ProfileScope {
+private:
+
+    ProfilePhase phase;
+
+    bool active;
+
+    Profiler::Clock::time_point begin;
+
+public:
+
+    explicit ProfileScope(ProfilePhase phase) : phase(phase), active(Profiler::isEnabled()) {
+        if(this->active)
+            this->begin = Profiler::Clock::now();
+    }
+
+    ~ProfileScope() {
+        stop();
+    }
+
+    /// Records the phase now instead of at destruction.
+    void stop() {
+        if(this->active){
+            Profiler::record(this->phase, this->begin, Profiler::Clock::now());
+            this->active = false;
+        }
+    }
+};
+
+/**
+ * \brief Logger recording the steps of Learn::LearningAgent::trainOneGeneration as profiler phases.
+ *
+ * The mutation, evaluation, decimation and validation phases end at the matching logger calls of the learning agent.
+ */
+class ProfilerLogger : public Log::LALogger {
+private:
+
+    /// End of the previous step
+    Profiler::Clock::time_point stepBegin;
+
+    /// Records the step ending now as phase, if the profiler is enabled.
+    void endStep(ProfilePhase phase);
+
+public:
+
+    /// Constructor, adding the logger to the loggers of la.
+    explicit ProfilerLogger(Learn::LearningAgent& la);
+
+    /// Inherited via LALogger, does nothing.
+    virtual void logHeader() override;
+
+    /// Inherited via LALogger, starts the mutation.
+    virtual void logNewGeneration(uint64_t& generationNumber) override;
+
+    /// Inherited via LALogger, records the mutation.
+    virtual void logAfterPopulateTPG() override;
+
+    /// Inherited via LALogger, records the evaluation.
+    virtual void logAfterEvaluate(std::multimap<std::shared_ptr<Learn::EvaluationResult>,
+                                  const TPG::TPGVertex*>& results) override;
+
+    /// Inherited via LALogger, records the decimation.
+    virtual void logAfterDecimate() override;
+
+    /// Inherited via LALogger, records the validation.
+    virtual void logAfterValidate(std::multimap<std::shared_ptr<Learn::EvaluationResult>,
+                                  const TPG::TPGVertex*>& results) override;
+
+    /// Inherited via LALogger, does nothing.
+    virtual void logEndOfTraining() override;
+};
+
+
+#endif //GEGELATI_TETRIS_PROFILER_H
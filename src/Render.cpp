@@ -1,36 +1,42 @@
 #include "Render.h"
+#include "Episode.h"
 #include "Tetris.h"
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
 
-Render::Render(Tetris &t, int tileSize) : gameEnvironment(t), tileSize(tileSize), isInitialised(false), window(nullptr) {
-
-    this->tile_green = sf::RectangleShape(sf::Vector2f(tileSize, tileSize));
-    this->tile_red = sf::RectangleShape(sf::Vector2f(tileSize, tileSize));
-    this->tile_orange = sf::RectangleShape(sf::Vector2f(tileSize, tileSize));
-    this->tile_blue = sf::RectangleShape(sf::Vector2f(tileSize, tileSize));
-    this->tile_yellow = sf::RectangleShape(sf::Vector2f(tileSize, tileSize));
-    this->tile_cyan = sf::RectangleShape(sf::Vector2f(tileSize, tileSize));
-    this->tile_magenta = sf::RectangleShape(sf::Vector2f(tileSize, tileSize));
-
-    this->tile_green.setFillColor(sf::Color::Green);
-    this->tile_red.setFillColor(sf::Color::Red);
-    this->tile_orange.setFillColor(sf::Color(255, 153, 51));
-    this->tile_blue.setFillColor(sf::Color::Blue);
-    this->tile_yellow.setFillColor(sf::Color::Yellow);
-    this->tile_cyan.setFillColor(sf::Color::Cyan);
-    this->tile_magenta.setFillColor(sf::Color::Magenta);
-
-    this->allTiles[0] = &tile_cyan;
-    this->allTiles[1] = &tile_green;
-    this->allTiles[2] = &tile_red;
-    this->allTiles[3] = &tile_magenta;
-    this->allTiles[4] = &tile_orange;
-    this->allTiles[5] = &tile_blue;
-    this->allTiles[6] = &tile_yellow;
+template <int W, int H>
+const sf::Color Render<W, H>::TILE_COLOURS[8] = {
+        sf::Color::Transparent,
+        sf::Color::Cyan,            // I
+        sf::Color::Green,           // S
+        sf::Color::Red,             // Z
+        sf::Color::Magenta,         // T
+        sf::Color(255, 153, 51),    // L
+        sf::Color::Blue,            // J
+        sf::Color::Yellow           // O
+};
+
+template <int W, int H>
+Render<W, H>::Render(Tetris<W, H> &t, int tileSize) : gameEnvironment(t), tileSize(tileSize), isInitialised(false),
+        window(nullptr), boardVertices(sf::Quads, 4 * W * H), displayedTiles(), displayedVersion(0),
+        displayedScore(0) {
+
+    // Quads positions never change, only their colour is updated
+    for(int i = 0; i < H; i++){
+        for(int j = 0; j < W; j++){
+            sf::Vertex* quad = &this->boardVertices[4 * (i * W + j)];
+            quad[0].position = sf::Vector2f(j * tileSize, i * tileSize);
+            quad[1].position = sf::Vector2f((j + 1) * tileSize, i * tileSize);
+            quad[2].position = sf::Vector2f((j + 1) * tileSize, (i + 1) * tileSize);
+            quad[3].position = sf::Vector2f(j * tileSize, (i + 1) * tileSize);
+            for(int k = 0; k < 4; k++)
+                quad[k].color = TILE_COLOURS[0];
+        }
+    }
 
     this->gridEdges = sf::RectangleShape(
             sf::Vector2f(tileSize * gameEnvironment.WIDTH, tileSize * gameEnvironment.HEIGHT));
@@ -46,53 +52,67 @@ Render::Render(Tetris &t, int tileSize) : gameEnvironment(t), tileSize(tileSize)
     this->scoreTextLabel.setString("Cleared:");
     this->scoreTextLabel.setCharacterSize(24);
     this->scoreTextLabel.setFillColor(sf::Color::White);
+    this->scoreTextLabel.setPosition(this->tileSize * W + 20, 50);
 
     this->scoreLabel.setFont(font);
+    this->scoreLabel.setString(std::to_string(this->displayedScore));
     this->scoreLabel.setCharacterSize(24);
     this->scoreLabel.setFillColor(sf::Color::White);
+    this->scoreLabel.setPosition(this->tileSize * W + 55, 80);
 
 }
 
-void Render::initialise() {
+template <int W, int H>
+void Render<W, H>::initialise() {
     window = new sf::RenderWindow(sf::VideoMode(this->tileSize * this->gameEnvironment.WIDTH + 300,
                                                 this->tileSize * this->gameEnvironment.HEIGHT),
                                                 "Tetris LE view");
 }
 
-void Render::update(bool display) {
-    this->scoreLabel.setString(std::to_string(this->gameEnvironment.getGameScore()));
+template <int W, int H>
+void Render<W, H>::update(bool display) {
 
-    this->window->clear();
+    // The grid only changes when the observation version of the game does
+    const uint64_t version = this->gameEnvironment.getObservationVersion();
+    if(version != this->displayedVersion){
+        this->displayedVersion = version;
 
-    for(int i = 0; i < Tetris::HEIGHT; i++){
-        for(int j = 0; j < Tetris::WIDTH; j++){
+        for(int i = 0; i < H; i++){
+            uint8_t row[W];
+            for(int j = 0; j < W; j++)
+                row[j] = (uint8_t)this->gameEnvironment.getTileAt(j, i);
 
-            int tile = (int)this->gameEnvironment.getTileAt(j, i);
+            if(std::equal(row, row + W, this->displayedTiles[i]))
+                continue;
 
-            if(tile != 0){
-                sf::RectangleShape& tileToDraw = *this->allTiles[tile - 1];
-
-                tileToDraw.setPosition(j * this->tileSize, i * this->tileSize);
-                window->draw(tileToDraw);
+            // Rebuilds the colours of the changed row
+            for(int j = 0; j < W; j++){
+                sf::Vertex* quad = &this->boardVertices[4 * (i * W + j)];
+                for(int k = 0; k < 4; k++)
+                    quad[k].color = TILE_COLOURS[row[j]];
+                this->displayedTiles[i][j] = row[j];
             }
-
         }
     }
 
-    this->scoreTextLabel.setPosition(this->tileSize * Tetris::WIDTH + 20, 50);
-    this->window->draw(this->scoreTextLabel);
+    if(this->gameEnvironment.getGameScore() != this->displayedScore){
+        this->displayedScore = this->gameEnvironment.getGameScore();
+        this->scoreLabel.setString(std::to_string(this->displayedScore));
+    }
 
-    this->scoreLabel.setPosition(this->tileSize * Tetris::WIDTH + 55, 80);
-    this->scoreLabel.setString(std::to_string(this->gameEnvironment.getGameScore()));
-    this->window->draw(this->scoreLabel);
+    this->window->clear();
 
+    this->window->draw(this->boardVertices);
+    this->window->draw(this->scoreTextLabel);
+    this->window->draw(this->scoreLabel);
     this->window->draw(this->gridEdges);
 
     if(display)
         this->window->display();
 }
 
-void Render::close() {
+template <int W, int H>
+void Render<W, H>::close() {
     this->window->close();
     delete this->window;
     this->window = nullptr;
@@ -100,44 +120,51 @@ void Render::close() {
 
 
 
-Render::~Render() {
+template <int W, int H>
+Render<W, H>::~Render() {
     delete window;
 }
 
+TETRIS_INSTANTIATE(Render)
+
 
 
-void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, const TPG::TPGVertex** bestRoot,
-                  const Instructions::Set& set, Tetris& tetrisLE, const Learn::LearningParameters& params,
-                  std::atomic<uint64_t>& generation, int seed, int replaySpeed){
+void playFromRoot(std::atomic<bool>& exit, ReplayMailbox& mailbox, const Instructions::Set& set,
+                  Tetris<> tetrisLE, const Learn::LearningParameters& params, int seed, int replaySpeed){
 
     /* Replay display */
-    Tetris simuEnv(tetrisLE);   // Tetris environment used for replay, is a deep copy of tetrisLE
-    Render replayRender(simuEnv);
+    Tetris<> simuEnv(tetrisLE);   // Tetris environment used for replay, is a deep copy of tetrisLE
+    Render<> replayRender(simuEnv);
     replayRender.initialise();
 
     /* Replay computation */
     std::vector<uint64_t> replay;
-    Environment env(set, simuEnv.getDataSources(), params.nbRegisters, params.nbProgramConstant);
+    Environment env(set, tetrisLE.getDataSources(), params.nbRegisters, params.nbProgramConstant);
     TPG::TPGExecutionEngine tee(env);
     uint64_t frame = 0;
 
     /* Replay control */
     bool waitEndOfReplay = false;   // True if the current replay must end before playing the next one
+    bool fastForward = false;       // True if frames are displayed as fast as possible
     float sleepTime = 1.f/(float)replaySpeed;
 
+    // Window events are still handled at this period when no replay is displayed
+    const std::chrono::milliseconds idlePeriod(100);
+
     std::cout << "---- Replay control ----" << std::endl
                 << "[W] : Toggle wait end of replay" << std::endl
-                << "[S] : Stop current replay" << std::endl;
+                << "[S] : Stop current replay" << std::endl
+                << "[F] : Toggle fast forward" << std::endl;
 
     /* Render additional inforamtions */
     sf::Text generationLabel("Generation : ", replayRender.font, 24);
-    generationLabel.setPosition(replayRender.tileSize * Tetris::WIDTH + 10, 110);
+    generationLabel.setPosition(replayRender.tileSize * Tetris<>::WIDTH + 10, 110);
     sf::Text generationNumberLabel("0", replayRender.font, 24);
-    generationNumberLabel.setPosition(replayRender.tileSize * Tetris::WIDTH + 170, 110);
+    generationNumberLabel.setPosition(replayRender.tileSize * Tetris<>::WIDTH + 170, 110);
     sf::Text frameLabel("Frame :", replayRender.font, 24);
-    frameLabel.setPosition(replayRender.tileSize * Tetris::WIDTH + 10, 140);
+    frameLabel.setPosition(replayRender.tileSize * Tetris<>::WIDTH + 10, 140);
     sf::Text frameNumberLabel("0", replayRender.font, 24);
-    frameNumberLabel.setPosition(replayRender.tileSize * Tetris::WIDTH + 110, 140);
+    frameNumberLabel.setPosition(replayRender.tileSize * Tetris<>::WIDTH + 110, 140);
     sf::Text moveLabel;
     moveLabel.setFont(replayRender.font);
     moveLabel.setCharacterSize(24);
@@ -145,31 +172,24 @@ void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, cons
 
     bool isDisplay = false;
     sf::Event event;
-    exit = false;
 
     while(!exit){
 
-        if( resetDisplay && ( !waitEndOfReplay || (waitEndOfReplay && !isDisplay) )){
-            // Restarting tetris environments
-            tetrisLE.reset(seed, Learn::LearningMode::VALIDATION);
-            simuEnv.reset(seed, Learn::LearningMode::VALIDATION);
+        if(!isDisplay || !waitEndOfReplay){
+            // A new policy replaces the current replay. When nothing is displayed, sleeps until one is posted.
+            std::unique_ptr<PolicySnapshot> policy = isDisplay ? mailbox.take() : mailbox.waitAndTake(idlePeriod);
 
-            replay.clear();
-
-            // Computing replay
-            for(int i = 0; i < params.maxNbActionsPerEval && !tetrisLE.isTerminal(); i++){
-                auto vertexList = tee.executeFromRoot(**bestRoot);
-                const auto actionID = ((const TPG::TPGAction*)vertexList.back())->getActionID();
-                replay.push_back(actionID);
-                tetrisLE.doAction(actionID);
-            }
+            if(policy != nullptr){
+                // Computing replay
+                simuEnv.reset(seed, Learn::LearningMode::VALIDATION);
+                replay = recordEpisode(tee, *policy->getRoot(), tetrisLE, seed, Learn::LearningMode::VALIDATION,
+                                       params.maxNbActionsPerEval).getActions();
 
-            generationNumberLabel.setString(std::to_string(generation));
+                generationNumberLabel.setString(std::to_string(policy->getGeneration()));
 
-            isDisplay = true;
-            frame = 0;
-
-            resetDisplay = false;
+                isDisplay = !replay.empty();
+                frame = 0;
+            }
         }
 
         if(isDisplay){
@@ -187,7 +207,8 @@ void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, cons
 
             replayRender.window->display();
 
-            sf::sleep(sf::seconds(sleepTime));
+            if(!fastForward)
+                sf::sleep(sf::seconds(sleepTime));
 
             frame++;
             isDisplay = frame < replay.size();
@@ -205,7 +226,6 @@ void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, cons
                     switch (event.key.code) {
                         case sf::Keyboard::Escape :
                             exit = true;
-                            resetDisplay = false;   // In cas the main thread was waiting for a replay to end
                             break;
                         case sf::Keyboard::W :
                             waitEndOfReplay = !waitEndOfReplay;
@@ -214,6 +234,10 @@ void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, cons
                         case sf::Keyboard::S :
                             isDisplay = false;
                             break;
+                        case sf::Keyboard::F :
+                            fastForward = !fastForward;
+                            std::cout << "Fast forward : " << fastForward << std::endl;
+                            break;
                         default :
                             break;
                     }
@@ -228,4 +252,4 @@ void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, cons
 
     replayRender.close();
 
-}
+}
\ No newline at end of file
@@ -2,15 +2,23 @@
 #define GEGELATI_TETRIS_RENDER_H
 
 #include "Tetris.h"
+#include "ReplayMailbox.h"
 #include <SFML/Graphics.hpp>
 
 #include <thread>
 #include <atomic>
 
+/**
+ * \brief SFML display of a Tetris game.
+ *
+ * \tparam W width of the grid.
+ * \tparam H height of the grid.
+ */
+template <int W = TETRIS_WIDTH, int H = TETRIS_HEIGHT>
 class Render {
 
     /// The associated Tetris learning environment
-    Tetris& gameEnvironment;
+    Tetris<W, H>& gameEnvironment;
 
     /// Tile size in pixels
     int tileSize;
@@ -21,16 +29,20 @@ class Render {
     /// Pointer to the window for display
     sf::RenderWindow* window;
 
-    /// Coloured allTiles
-    sf::RectangleShape tile_cyan;       // I
-    sf::RectangleShape tile_green;      // S
-    sf::RectangleShape tile_red;        // Z
-    sf::RectangleShape tile_magenta;    // T
-    sf::RectangleShape tile_orange;     // L
-    sf::RectangleShape tile_blue;       // J
-    sf::RectangleShape tile_yellow;     // O
+    /// Colour of each tile value, index 0 being the empty tile
+    static const sf::Color TILE_COLOURS[8];
 
-    sf::RectangleShape* allTiles[7];
+    /// Quads of all the tiles of the board, drawn in a single call
+    sf::VertexArray boardVertices;
+
+    /// Tile values currently in boardVertices
+    uint8_t displayedTiles[H][W];
+
+    /// Observation version of the game when boardVertices was last updated
+    uint64_t displayedVersion;
+
+    /// Score currently displayed by scoreLabel
+    int displayedScore;
 
     /// Grid edges shape
     sf::RectangleShape gridEdges;
@@ -43,11 +55,10 @@ class Render {
     sf::Text scoreLabel;
 
 
-    friend class Tetris;
+    friend class Tetris<W, H>;
 
-    friend void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, const TPG::TPGVertex** bestRoot,
-                             const Instructions::Set& set, Tetris& tetrisLE, const Learn::LearningParameters& params,
-                             std::atomic<uint64_t>& generation, int seed, int replaySpeed);
+    friend void playFromRoot(std::atomic<bool>& exit, ReplayMailbox& mailbox, const Instructions::Set& set,
+                             Tetris<> tetrisLE, const Learn::LearningParameters& params, int seed, int replaySpeed);
 
 public:
 
@@ -57,7 +68,7 @@ public:
      * \param t the Tetris learning environment
      * \param tileSize the size in pixel of the allTiles on screen
      */
-    Render(Tetris& t, int tileSize = 18);
+    Render(Tetris<W, H>& t, int tileSize = 18);
 
     /// Destructor
     ~Render();
@@ -65,17 +76,36 @@ public:
     /// Initialises SFML and opens the main window
     void initialise();
 
-    /// Updates the window using the current data in the gameEnvironment.
+    /**
+     * \brief Updates the window using the current data in the gameEnvironment.
+     *
+     * Only the rows of the board whose tiles changed since the last update are rebuilt, and the score text is only
+     * updated when the score changed.
+     */
     void update(bool display = true);
 
     /// Closes the Render.
     void close();
 };
 
-/// Displays a game played using a TPG (replaySpeed is in frames/seconds)
-void playFromRoot(std::atomic<bool>& exit, std::atomic<bool>& resetDisplay, const TPG::TPGVertex** bestRoot,
-                  const Instructions::Set& set, Tetris& tetrisLE, const Learn::LearningParameters& params,
-                  std::atomic<uint64_t>& generation, int seed = 0, int replaySpeed = 10);
+/**
+ * \brief Displays games played by the policies posted in a mailbox, until exit is set.
+ *
+ * Replays are computed from the snapshots taken from the mailbox, on an environment owned by the replay thread,
+ * so that training goes on while replays are computed and displayed. The function sets exit when the window is
+ * closed.
+ *
+ * \param exit set to stop the replays, or by the replays when the window is closed.
+ * \param mailbox mailbox from which the policies to replay are taken.
+ * \param set instruction set of the policies.
+ * \param tetrisLE environment used to compute the replays, passed by copy so that std::thread copies it
+ * before the replay thread starts.
+ * \param params learning parameters of the policies.
+ * \param seed seed of the replayed games.
+ * \param replaySpeed replay speed in frames/seconds.
+ */
+void playFromRoot(std::atomic<bool>& exit, ReplayMailbox& mailbox, const Instructions::Set& set,
+                  Tetris<> tetrisLE, const Learn::LearningParameters& params, int seed = 0, int replaySpeed = 10);
 
 
 #endif //GEGELATI_TETRIS_RENDER_H
@@ -0,0 +1,37 @@
+#include "ReplayExecutionEngine.h"
+
+namespace {
+    /// Access to the archive of any execution engine, protected in TPG::TPGExecutionEngine
+    struct ArchiveAccess : TPG::TPGExecutionEngine {
+        static Archive* get(TPG::TPGExecutionEngine& tee) {
+            return tee.*(&ArchiveAccess::archive);
+        }
+    };
+}
+
+ReplayExecutionEngine::ReplayExecutionEngine(const Environment& env, TPG::TPGExecutionEngine& tee)
+        : TPG::TPGExecutionEngine(env, ArchiveAccess::get(tee)) {
+}
+
+double ReplayExecutionEngine::evaluateEdge(const TPG::TPGEdge& edge) {
+    double result = TPG::TPGExecutionEngine::evaluateEdge(edge);
+    this->evaluatedEdges.emplace_back(&edge, result);
+    return result;
+}
+
+uint64_t ReplayExecutionEngine::execute(const TPG::TPGVertex& root) {
+    this->evaluatedEdges.clear();
+    return ((const TPG::TPGAction*)this->executeFromRoot(root).back())->getActionID();
+}
+
+void ReplayExecutionEngine::replayLastExecution() {
+    if(this->archive == nullptr)
+        return;
+
+    // Same calls as TPGExecutionEngine::evaluateEdge, the data sources of the program engine being unchanged
+    for(const auto& evaluatedEdge : this->evaluatedEdges){
+        const Program::Program& program = evaluatedEdge.first->getProgram();
+        this->progExecutionEngine.setProgram(program);
+        this->archive->addRecording(&program, this->progExecutionEngine.getDataSources(), evaluatedEdge.second);
+    }
+}
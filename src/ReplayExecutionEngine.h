@@ -0,0 +1,48 @@
+#ifndef GEGELATI_TETRIS_REPLAYEXECUTIONENGINE_H
+#define GEGELATI_TETRIS_REPLAYEXECUTIONENGINE_H
+
+#include <utility>
+#include <vector>
+
+#include <gegelati.h>
+
+/**
+ * \brief TPG execution engine able to replay the archive recordings of its last execution.
+ *
+ * When the observation did not change, executing the deterministic TPG again gives the same action, but
+ * TPG::TPGExecutionEngine::executeFromRoot also records each executed program in the archive, which draws from the
+ * random number generator of the archive and may push older recordings out. Replaying the last execution makes the
+ * same calls to Archive::addRecording, with the same programs, data and results, without executing the programs.
+ */
+class ReplayExecutionEngine : public TPG::TPGExecutionEngine {
+private:
+
+    /// Edges evaluated by the last execution, with their result
+    std::vector<std::pair<const TPG::TPGEdge*, double>> evaluatedEdges;
+
+public:
+
+    /**
+     * \brief Constructor.
+     *
+     * \param env the environment of the graph.
+     * \param tee the engine whose archive, if any, is filled by this engine.
+     */
+    ReplayExecutionEngine(const Environment& env, TPG::TPGExecutionEngine& tee);
+
+    /// Inherited via TPGExecutionEngine, keeping the edge and its result for replayLastExecution.
+    virtual double evaluateEdge(const TPG::TPGEdge& edge) override;
+
+    /**
+     * \brief Executes the graph from a root.
+     *
+     * \return the ID of the reached action.
+     */
+    uint64_t execute(const TPG::TPGVertex& root);
+
+    /// Makes the archive recordings of the last call to execute again, on the current data sources.
+    void replayLastExecution();
+};
+
+
+#endif //GEGELATI_TETRIS_REPLAYEXECUTIONENGINE_H
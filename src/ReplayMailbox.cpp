@@ -0,0 +1,22 @@
+#include "ReplayMailbox.h"
+
+ReplayMailbox::ReplayMailbox() : slot(nullptr) {}
+
+ReplayMailbox::~ReplayMailbox() {
+    delete this->slot.load();
+}
+
+void ReplayMailbox::post(std::unique_ptr<PolicySnapshot> snapshot) {
+    delete this->slot.exchange(snapshot.release(), std::memory_order_acq_rel);
+    this->posted.notify_one();
+}
+
+std::unique_ptr<PolicySnapshot> ReplayMailbox::take() {
+    return std::unique_ptr<PolicySnapshot>(this->slot.exchange(nullptr, std::memory_order_acq_rel));
+}
+
+std::unique_ptr<PolicySnapshot> ReplayMailbox::waitAndTake(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->posted.wait_for(lock, timeout, [this](){ return this->slot.load(std::memory_order_acquire) != nullptr; });
+    return take();
+}
@@ -0,0 +1,53 @@
+#ifndef GEGELATI_TETRIS_REPLAYMAILBOX_H
+#define GEGELATI_TETRIS_REPLAYMAILBOX_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "PolicySnapshot.h"
+
+/**
+ * \brief Single slot mailbox handing policy snapshots from the trainer to the replay viewer.
+ *
+ * Posting never blocks : the slot is swapped atomically and a snapshot the viewer did not take yet is replaced by
+ * the new one, since only the latest policy is worth replaying.
+ * The viewer sleeps on a condition variable while the slot is empty. The poster notifies it without taking the
+ * mutex, so a wake-up can be missed, which only delays the viewer until the end of its wait timeout.
+ */
+class ReplayMailbox {
+private:
+
+    /// Snapshot waiting for the viewer, nullptr if none
+    std::atomic<PolicySnapshot*> slot;
+
+    /// Mutex and condition variable on which the viewer sleeps
+    std::mutex mutex;
+    std::condition_variable posted;
+
+public:
+
+    /// Constructor, with an empty slot.
+    ReplayMailbox();
+
+    ReplayMailbox(const ReplayMailbox& other) = delete;
+
+    ReplayMailbox& operator=(const ReplayMailbox& other) = delete;
+
+    /// Destructor, deletes the snapshot left in the slot.
+    ~ReplayMailbox();
+
+    /// Puts a snapshot in the slot, replacing the one the viewer did not take yet.
+    void post(std::unique_ptr<PolicySnapshot> snapshot);
+
+    /// Takes the snapshot of the slot, nullptr if it is empty.
+    std::unique_ptr<PolicySnapshot> take();
+
+    /// Takes the snapshot of the slot, waiting at most timeout for one to be posted if it is empty.
+    std::unique_ptr<PolicySnapshot> waitAndTake(std::chrono::milliseconds timeout);
+};
+
+
+#endif //GEGELATI_TETRIS_REPLAYMAILBOX_H
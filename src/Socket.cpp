@@ -0,0 +1,310 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Socket.h"
+
+#ifndef _WIN32
+namespace {
+    /// Splits an address in its protocol and the rest, checking the protocol
+    std::string getLocation(const std::string& address, bool& isUnix) {
+        if(address.compare(0, 5, "unix:") == 0){
+            isUnix = true;
+            return address.substr(5);
+        }
+        if(address.compare(0, 4, "tcp:") == 0){
+            isUnix = false;
+            return address.substr(4);
+        }
+        throw std::runtime_error("Invalid address " + address + ", expected unix:<path> or tcp:<host>:<port>.");
+    }
+
+    /// Unix domain socket address of a path
+    sockaddr_un getUnixAddress(const std::string& path) {
+        sockaddr_un unixAddress = {};
+        unixAddress.sun_family = AF_UNIX;
+        if(path.empty() || path.size() >= sizeof(unixAddress.sun_path))
+            throw std::runtime_error("Invalid socket path " + path + ".");
+        memcpy(unixAddress.sun_path, path.c_str(), path.size());
+        return unixAddress;
+    }
+
+    /// Resolved TCP addresses of "<host>:<port>", to be freed with freeaddrinfo
+    addrinfo* getTcpAddresses(const std::string& location, bool passive) {
+        size_t separator = location.rfind(':');
+        if(separator == std::string::npos)
+            throw std::runtime_error("Invalid TCP address " + location + ", expected <host>:<port>.");
+        std::string host = location.substr(0, separator);
+        std::string port = location.substr(separator + 1);
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+        addrinfo* addresses = nullptr;
+        int error = getaddrinfo((host.empty() || host == "*") ? nullptr : host.c_str(), port.c_str(), &hints,
+                                &addresses);
+        if(error != 0)
+            throw std::runtime_error("Can't resolve " + location + " : " + gai_strerror(error) + ".");
+        return addresses;
+    }
+
+    /// Seconds without traffic before the first keepalive probe, seconds between probes, and number of unanswered
+    /// probes after which the connection is closed
+    const int KEEPALIVE_IDLE_TIME = 30;
+    const int KEEPALIVE_INTERVAL = 10;
+    const int KEEPALIVE_NB_PROBES = 3;
+
+    /// Settings of connected sockets
+    void setupConnection(int fd, bool isTcp) {
+        int enable = 1;
+        if(isTcp){
+            // Jobs and results are small messages, sent one at a time
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            // Detects the loss of remote machines within a minute, instead of the 2 hours of the default timers
+            setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+#ifdef TCP_KEEPIDLE
+            int idleTime = KEEPALIVE_IDLE_TIME;
+            setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idleTime, sizeof(idleTime));
+#endif
+#ifdef TCP_KEEPINTVL
+            int interval = KEEPALIVE_INTERVAL;
+            setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPCNT
+            int nbProbes = KEEPALIVE_NB_PROBES;
+            setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &nbProbes, sizeof(nbProbes));
+#endif
+        }
+    }
+
+    std::string getError(const std::string& message) {
+        return message + " : " + strerror(errno) + ".";
+    }
+}
+
+MessageSocket::MessageSocket(int fd) : fd(fd) {}
+
+MessageSocket::~MessageSocket() {
+    ::close(this->fd);
+}
+
+std::unique_ptr<MessageSocket> MessageSocket::connect(const std::string& address) {
+    bool isUnix;
+    std::string location = getLocation(address, isUnix);
+
+    if(isUnix){
+        sockaddr_un unixAddress = getUnixAddress(location);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0)
+            throw std::runtime_error(getError("Can't create socket"));
+        if(::connect(fd, (const sockaddr*)&unixAddress, sizeof(unixAddress)) != 0){
+            std::string error = getError("Can't connect to " + address);
+            ::close(fd);
+            throw std::runtime_error(error);
+        }
+        return std::make_unique<MessageSocket>(fd);
+    }
+
+    addrinfo* addresses = getTcpAddresses(location, false);
+    for(addrinfo* candidate = addresses; candidate != nullptr; candidate = candidate->ai_next){
+        int fd = socket(candidate->ai_family, candidate->ai_socktype | SOCK_CLOEXEC, candidate->ai_protocol);
+        if(fd < 0)
+            continue;
+        if(::connect(fd, candidate->ai_addr, candidate->ai_addrlen) == 0){
+            freeaddrinfo(addresses);
+            setupConnection(fd, true);
+            return std::make_unique<MessageSocket>(fd);
+        }
+        ::close(fd);
+    }
+    freeaddrinfo(addresses);
+    throw std::runtime_error("Can't connect to " + address + ".");
+}
+
+void MessageSocket::send(uint64_t type, const uint64_t* words, size_t nbWords) {
+    const uint64_t header[2] = {type, nbWords};
+
+    // Header and payload in a single call, without copy
+    iovec parts[2] = {{(void*)header, sizeof(header)}, {(void*)words, nbWords * sizeof(uint64_t)}};
+    msghdr message = {};
+    message.msg_iov = parts;
+    message.msg_iovlen = 2;
+
+    size_t remaining = sizeof(header) + nbWords * sizeof(uint64_t);
+    while(remaining > 0){
+        ssize_t sent = sendmsg(this->fd, &message, MSG_NOSIGNAL);
+        if(sent < 0){
+            if(errno == EINTR)
+                continue;
+            throw std::runtime_error(getError("Connection lost"));
+        }
+        remaining -= sent;
+
+        // Skips what was sent
+        while(message.msg_iovlen > 0 && (size_t)sent >= message.msg_iov->iov_len){
+            sent -= message.msg_iov->iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if(message.msg_iovlen > 0){
+            message.msg_iov->iov_base = (uint8_t*)message.msg_iov->iov_base + sent;
+            message.msg_iov->iov_len -= sent;
+        }
+    }
+}
+
+void MessageSocket::send(uint64_t type, const std::vector<uint64_t>& words) {
+    send(type, words.data(), words.size());
+}
+
+bool MessageSocket::receive(uint64_t& type, std::vector<uint64_t>& words) {
+    // Reads size bytes, false if the connection was closed before the first one
+    auto read = [this](void* data, size_t size, bool first) {
+        size_t received = 0;
+        while(received < size){
+            ssize_t nbBytes = recv(this->fd, (uint8_t*)data + received, size - received, 0);
+            if(nbBytes < 0 && errno == EINTR)
+                continue;
+            if(nbBytes == 0 && first && received == 0)
+                return false;
+            if(nbBytes <= 0)
+                throw std::runtime_error(nbBytes == 0 ? std::string("Connection closed.") : getError("Connection lost"));
+            received += nbBytes;
+        }
+        return true;
+    };
+
+    uint64_t header[2];
+    if(!read(header, sizeof(header), true))
+        return false;
+    if(header[1] > MAX_MESSAGE_SIZE)
+        throw std::runtime_error("Received message is too large.");
+
+    type = header[0];
+    words.resize(header[1]);
+    read(words.data(), words.size() * sizeof(uint64_t), false);
+    return true;
+}
+
+int MessageSocket::getDescriptor() const {
+    return this->fd;
+}
+
+SocketListener::SocketListener(const std::string& address) : fd(-1) {
+    bool isUnix;
+    std::string location = getLocation(address, isUnix);
+
+    if(isUnix){
+        sockaddr_un unixAddress = getUnixAddress(location);
+        this->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(this->fd < 0)
+            throw std::runtime_error(getError("Can't create socket"));
+        unlink(location.c_str());
+        if(bind(this->fd, (const sockaddr*)&unixAddress, sizeof(unixAddress)) != 0){
+            std::string error = getError("Can't listen on " + address);
+            ::close(this->fd);
+            throw std::runtime_error(error);
+        }
+        this->unixPath = location;
+    }
+    else {
+        addrinfo* addresses = getTcpAddresses(location, true);
+        for(addrinfo* candidate = addresses; candidate != nullptr && this->fd < 0; candidate = candidate->ai_next){
+            this->fd = socket(candidate->ai_family, candidate->ai_socktype | SOCK_CLOEXEC, candidate->ai_protocol);
+            if(this->fd < 0)
+                continue;
+            int enable = 1;
+            setsockopt(this->fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            if(bind(this->fd, candidate->ai_addr, candidate->ai_addrlen) != 0){
+                ::close(this->fd);
+                this->fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        if(this->fd < 0)
+            throw std::runtime_error("Can't listen on " + address + ".");
+    }
+
+    // Connections are accepted when the socket is polled as readable, without waiting
+    if(listen(this->fd, SOMAXCONN) != 0 || fcntl(this->fd, F_SETFL, fcntl(this->fd, F_GETFL) | O_NONBLOCK) != 0){
+        std::string error = getError("Can't listen on " + address);
+        ::close(this->fd);
+        throw std::runtime_error(error);
+    }
+}
+
+SocketListener::~SocketListener() {
+    ::close(this->fd);
+    if(!this->unixPath.empty())
+        unlink(this->unixPath.c_str());
+}
+
+std::unique_ptr<MessageSocket> SocketListener::accept() {
+    sockaddr_storage address;
+    socklen_t addressSize = sizeof(address);
+    int connection = accept4(this->fd, (sockaddr*)&address, &addressSize, SOCK_CLOEXEC);
+    if(connection < 0)
+        return nullptr;
+
+    setupConnection(connection, address.ss_family != AF_UNIX);
+    return std::make_unique<MessageSocket>(connection);
+}
+
+int SocketListener::getDescriptor() const {
+    return this->fd;
+}
+
+#else
+
+MessageSocket::MessageSocket(int fd) : fd(fd) {}
+
+MessageSocket::~MessageSocket() {}
+
+std::unique_ptr<MessageSocket> MessageSocket::connect(const std::string& address) {
+    throw std::runtime_error("Sockets are not supported on this system.");
+}
+
+void MessageSocket::send(uint64_t type, const uint64_t* words, size_t nbWords) {
+    throw std::runtime_error("Sockets are not supported on this system.");
+}
+
+void MessageSocket::send(uint64_t type, const std::vector<uint64_t>& words) {
+    send(type, words.data(), words.size());
+}
+
+bool MessageSocket::receive(uint64_t& type, std::vector<uint64_t>& words) {
+    throw std::runtime_error("Sockets are not supported on this system.");
+}
+
+int MessageSocket::getDescriptor() const {
+    return this->fd;
+}
+
+SocketListener::SocketListener(const std::string& address) : fd(-1) {
+    throw std::runtime_error("Sockets are not supported on this system.");
+}
+
+SocketListener::~SocketListener() {}
+
+std::unique_ptr<MessageSocket> SocketListener::accept() {
+    return nullptr;
+}
+
+int SocketListener::getDescriptor() const {
+    return this->fd;
+}
+
+#endif
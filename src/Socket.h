@@ -0,0 +1,105 @@
+#ifndef GEGELATI_TETRIS_SOCKET_H
+#define GEGELATI_TETRIS_SOCKET_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Connected stream socket exchanging messages of 64 bits words.
+ *
+ * Each message is a type and a payload of words, sent as its type, its number of words and its words, in the byte
+ * order of the machine (as checkpoint files).
+ *
+ * Addresses are written "unix:<path>" for Unix domain sockets, and "tcp:<host>:<port>" for TCP sockets.
+ * Sockets are only available on POSIX systems : elsewhere, connecting or listening throws a std::runtime_error.
+ */
+class MessageSocket {
+private:
+
+    /// File descriptor of the socket
+    int fd;
+
+public:
+
+    /// Maximum number of words of a received message
+    static constexpr uint64_t MAX_MESSAGE_SIZE = (uint64_t)1 << 28;
+
+    /// Constructor, taking ownership of a connected socket.
+    explicit MessageSocket(int fd);
+
+    MessageSocket(const MessageSocket& other) = delete;
+
+    MessageSocket& operator=(const MessageSocket& other) = delete;
+
+    /// Destructor, closing the socket.
+    ~MessageSocket();
+
+    /**
+     * \brief Connects to a listening socket.
+     *
+     * \param address address of the listening socket.
+     * \throws std::runtime_error if the address is invalid or the connection fails.
+     */
+    static std::unique_ptr<MessageSocket> connect(const std::string& address);
+
+    /**
+     * \brief Sends a message.
+     *
+     * \throws std::runtime_error if the connection was lost.
+     */
+    void send(uint64_t type, const uint64_t* words, size_t nbWords);
+
+    /// Sends a message.
+    void send(uint64_t type, const std::vector<uint64_t>& words);
+
+    /**
+     * \brief Waits for the next message.
+     *
+     * \return false if the peer closed the connection.
+     * \throws std::runtime_error if the connection was lost or the message is too large.
+     */
+    bool receive(uint64_t& type, std::vector<uint64_t>& words);
+
+    /// File descriptor of the socket, to poll it.
+    int getDescriptor() const;
+};
+
+/// Socket accepting connections on an address.
+class SocketListener {
+private:
+
+    /// File descriptor of the socket
+    int fd;
+
+    /// Path of the socket file of Unix domain sockets, removed by the destructor
+    std::string unixPath;
+
+public:
+
+    /**
+     * \brief Listens on an address, "tcp:*:<port>" listening on all interfaces.
+     *
+     * A previous socket file at the path of a Unix domain socket is replaced.
+     *
+     * \throws std::runtime_error if the address is invalid or can't be listened on.
+     */
+    explicit SocketListener(const std::string& address);
+
+    SocketListener(const SocketListener& other) = delete;
+
+    SocketListener& operator=(const SocketListener& other) = delete;
+
+    /// Destructor, closing the socket.
+    ~SocketListener();
+
+    /// Accepts a pending connection, nullptr if there is none.
+    std::unique_ptr<MessageSocket> accept();
+
+    /// File descriptor of the socket, to poll it.
+    int getDescriptor() const;
+};
+
+
+#endif //GEGELATI_TETRIS_SOCKET_H
@@ -1,43 +1,34 @@
+#include <algorithm>
+
 #include <SFML/System/Clock.hpp>
 #include <SFML/System/Sleep.hpp>
 #include <SFML/Window/Event.hpp>
 
 #include "Tetris.h"
+#include "TetrisPool.h"
 #include "Render.h"
 
-const int Tetris::HEIGHT = 20;
-const int Tetris::WIDTH = 10;
-const int Tetris::NB_ACTIONS = 5;
-const sf::Vector2<int> Tetris::TETROMINO_INITIAL_POSITION = sf::Vector2<int>(4,0);
-const int Tetris::FRAMES_PER_FALL = 20;
-
-const int Tetris::TETROMINO_TEMPLATES[7][4] = {
-        1, 3, 5, 7, // I
-        2, 4, 5, 7, // S
-        3, 4, 5, 6, // Z
-        3, 5, 4, 7, // T
-        2, 5, 3, 7, // L
-        3, 5, 7, 6, // J
-        2, 3, 4, 5  // O
-};
-
-void Tetris::reset(size_t seed, Learn::LearningMode mode) {
+template <int W, int H>
+void Tetris<W, H>::reset(size_t seed, Learn::LearningMode mode) {
     // Create seed from seed and mode
     size_t hash_seed = Data::Hash<size_t>()(seed) ^ Data::Hash<Learn::LearningMode>()(mode);
 
-    // Reset the rng generator
-    this->rng.setSeed(hash_seed);
+    // Restart the tetromino sequence of the seed
+    this->tetrominoSource.reset(hash_seed, this->randomizer);
 
     // Set the initial state
-    for(int i = 0; i < this->grid.getAddressSpace(typeid(double)); i++)
-        this->grid.setDataAt(typeid(double), i, 0.0);
+    clearObservation();
+
+    std::fill(std::begin(this->board), std::end(this->board), 0);
+    std::fill(&this->boardColours[0][0], &this->boardColours[0][0] + HEIGHT * WIDTH, 0);
+    this->features.reset();
+    this->observationVersion++;
 
     this->getNewTetromino();
     this->nbTetroRotations = 0;
 
     // Placing block on grid
-    for(auto& block : this->activeTetrominoPos)
-        setTileAt(block.x, block.y, this->activeTetrominoType);
+    drawActiveTetromino();
 
     this->fallCounter = 0;
     this->gameScore = 0;
@@ -51,63 +42,164 @@ void Tetris::reset(size_t seed, Learn::LearningMode mode) {
     this->gameOver = false;
 }
 
-void Tetris::resetGlobalData(){
+template <int W, int H>
+void Tetris<W, H>::resetGlobalData(){
     this->gameScoreRecord = 0;
     this->accumulateForbiddenMoves = 0;
     this->nbGames = 0;
 }
 
-std::vector<std::reference_wrapper<const Data::DataHandler>> Tetris::getDataSources() {
+template <int W, int H>
+TetrisState<W, H> Tetris<W, H>::saveState() const {
+    TetrisState<W, H> state;
+
+    std::copy(std::begin(this->board), std::end(this->board), state.board);
+    std::copy(&this->boardColours[0][0], &this->boardColours[0][0] + HEIGHT * WIDTH, &state.boardColours[0][0]);
+    state.features = this->features.save();
+
+    state.activeTetrominoType = this->activeTetrominoType;
+    state.activeTetrominoRotation = this->activeTetrominoRotation;
+    state.activeTetrominoX = this->activeTetrominoOrigin.x;
+    state.activeTetrominoY = this->activeTetrominoOrigin.y;
+    state.fallCounter = this->fallCounter;
+    state.accelerateFall = this->accelerateFall;
+    state.gameOver = this->gameOver;
+    state.reachablePlacements = this->reachablePlacements;
+    state.tetrominoSeed = this->tetrominoSource.getSeed();
+    state.nbGeneratedTetrominos = this->tetrominoSource.getNbGenerated();
+    state.gameScore = this->gameScore;
+    state.nbForbiddenMoves = this->nbForbiddenMoves;
+    state.nbPlayedTetrominos = this->nbPlayedTetrominos;
+    state.nbPlayedFrames = this->nbPlayedFrames;
+    state.nbTetroRotations = this->nbTetroRotations;
+
+    return state;
+}
+
+template <int W, int H>
+void Tetris<W, H>::restoreState(const TetrisState<W, H>& state) {
+    // The active tetromino is erased from the observation, so that it only differs from the restored one where the
+    // boards differ. An environment that was never reset has no active tetromino.
+    if(this->activeTetrominoType != 0){
+        Tetromino blocks;
+        getTetrominoBlocks(blocks, this->activeTetrominoType, this->activeTetrominoRotation,
+                           this->activeTetrominoOrigin);
+        for(auto& block : blocks)
+            observeActiveTile(block.x, block.y, false);
+        setObservationOverlay(nullptr);
+    }
+
+    std::copy(std::begin(state.board), std::end(state.board), this->board);
+    for(int y = 0; y < HEIGHT; y++){
+        if(std::equal(std::begin(state.boardColours[y]), std::end(state.boardColours[y]), this->boardColours[y]))
+            continue;
+
+        for(int x = 0; x < WIDTH; x++){
+            if(this->boardColours[y][x] != state.boardColours[y][x]){
+                this->boardColours[y][x] = state.boardColours[y][x];
+                observeBoardTile(x, y);
+            }
+        }
+    }
+    this->features.restore(state.features);
+
+    this->activeTetrominoType = state.activeTetrominoType;
+    this->activeTetrominoRotation = state.activeTetrominoRotation;
+    this->activeTetrominoOrigin = sf::Vector2<int>(state.activeTetrominoX, state.activeTetrominoY);
+    this->lastTetrominoRotation = this->activeTetrominoRotation;
+    this->lastTetrominoOrigin = this->activeTetrominoOrigin;
+    this->fallCounter = state.fallCounter;
+    this->accelerateFall = state.accelerateFall;
+    this->gameOver = state.gameOver;
+    this->reachablePlacements = state.reachablePlacements;
+    this->gameScore = state.gameScore;
+    this->nbForbiddenMoves = state.nbForbiddenMoves;
+    this->nbPlayedTetrominos = state.nbPlayedTetrominos;
+    this->nbPlayedFrames = state.nbPlayedFrames;
+    this->nbTetroRotations = state.nbTetroRotations;
+
+    this->tetrominoSource.restore(state.tetrominoSeed, this->randomizer, state.nbGeneratedTetrominos);
+
+    drawActiveTetromino();
+}
+
+template <int W, int H>
+void* Tetris<W, H>::operator new(size_t size) {
+    return TetrisPool<W, H>::allocate(size);
+}
+
+template <int W, int H>
+void Tetris<W, H>::operator delete(void* ptr, size_t size) {
+    TetrisPool<W, H>::deallocate(ptr, size);
+}
+
+template <int W, int H>
+std::vector<std::reference_wrapper<const Data::DataHandler>> Tetris<W, H>::getDataSources() {
     auto result = std::vector<std::reference_wrapper<const Data::DataHandler>>();
-    result.push_back(this->grid);
+    if(this->observation == TetrisObservation::COLOURS){
+        result.push_back(this->grid);
+        result.push_back(this->features.getFeatures());
+        result.push_back(this->columns);
+    }
+    else {
+        result.push_back(this->lockedPlane);
+        result.push_back(this->features.getFeatures());
+        result.push_back(this->lockedColumns);
+        result.push_back(this->activePlane);
+    }
     return result;
 }
 
-double Tetris::getScore() const {
+template <int W, int H>
+double Tetris<W, H>::getScore() const {
     return this->gameScore * 100 + this->nbPlayedTetrominos - this->nbForbiddenMoves * 0.1;
 }
 
-bool Tetris::isTerminal() const {
+template <int W, int H>
+bool Tetris<W, H>::isTerminal() const {
     return this->gameOver;
 }
 
-Learn::LearningEnvironment *Tetris::clone() const {
+template <int W, int H>
+Learn::LearningEnvironment *Tetris<W, H>::clone() const {
     return new Tetris(*this);
 }
 
-bool Tetris::isCopyable() const {
+template <int W, int H>
+bool Tetris<W, H>::isCopyable() const {
     return true;
 }
 
-void Tetris::doAction(uint64_t actionID) {
+template <int W, int H>
+void Tetris<W, H>::doAction(uint64_t actionID) {
     Learn::LearningEnvironment::doAction(actionID);
 
     if(isTerminal())
         return;
 
-    this->nbPlayedFrames++;
+    if(this->actionMode == TetrisActionMode::PLACEMENT){
+        doPlacement(actionID);
+        return;
+    }
 
-    // Remove active tetromino from the grid to avoid false collision when checking
-    for(auto& block : this->activeTetrominoPos)
-        setTileAt(block.x, block.y, 0);
+    this->nbPlayedFrames++;
 
-    for (int i = 0; i < 4; ++i)
-        this->lastTetrominoPos[i] = this->activeTetrominoPos[i];
+    // The board does not contain the active tetromino, so there is no need to remove it before checking
+    this->lastTetrominoRotation = this->activeTetrominoRotation;
+    this->lastTetrominoOrigin = this->activeTetrominoOrigin;
 
     switch (actionID) {
         // Move right
         case 0:
-            for(auto& block : this->activeTetrominoPos)
-                block.x += 1;
+            this->activeTetrominoOrigin.x += 1;
             break;
         // Move left
         case 1:
-            for(auto& block : this->activeTetrominoPos)
-                block.x -= 1;
+            this->activeTetrominoOrigin.x -= 1;
             break;
         // Rotate
         case 2:
-            rotateTetromino(this->activeTetrominoPos);
+            this->activeTetrominoRotation = (this->activeTetrominoRotation + 1) % 4;
             this->nbTetroRotations++;
             break;
         // Accelerate fall
@@ -121,8 +213,8 @@ void Tetris::doAction(uint64_t actionID) {
 
     // Revert position if invalid
     if(!checkActiveTetromino()){
-        for (int i = 0; i < 4; ++i)
-            this->activeTetrominoPos[i] = this->lastTetrominoPos[i];
+        this->activeTetrominoRotation = this->lastTetrominoRotation;
+        this->activeTetrominoOrigin = this->lastTetrominoOrigin;
 
         if(actionID == 2)
             this->nbTetroRotations--;
@@ -138,8 +230,7 @@ void Tetris::doAction(uint64_t actionID) {
     this->fallCounter++;
 
     if(this->fallCounter == FRAMES_PER_FALL || this->accelerateFall){
-        for(auto& block : this->activeTetrominoPos)
-            block.y += 1;
+        this->activeTetrominoOrigin.y += 1;
 
         this->fallCounter = 0;
         this->accelerateFall = false;
@@ -148,145 +239,337 @@ void Tetris::doAction(uint64_t actionID) {
     if(!checkActiveTetromino()){
         // Active tetromino can't fall
 
-        for(auto& block : this->activeTetrominoPos)
-            block.y -= 1;
+        this->activeTetrominoOrigin.y -= 1;
+
+        placeActiveTetromino();
+    }
+    else {
+        // Moving active tetromino in grid for learning agent, if it actually moved
+        redrawActiveTetromino();
+    }
 
-        // Freezing tetromino in grid
-        for(auto& block : this->activeTetrominoPos)
-            setTileAt(block.x, block.y, this->activeTetrominoType);
+}
 
-        clearLines();
+template <int W, int H>
+void Tetris<W, H>::placeActiveTetromino() {
+    // Freezing tetromino in board
+    redrawActiveTetromino();
+    lockActiveTetromino();
 
-        getNewTetromino();
-        this->nbPlayedTetrominos++;
+    clearLines();
 
-        if(!checkActiveTetromino()){
-            this->gameOver = true;
-            if(this->gameScore > this->gameScoreRecord)
-                this->gameScoreRecord = this->gameScore;
+    getNewTetromino();
+    this->nbPlayedTetrominos++;
 
-            this->accumulateForbiddenMoves += this->nbForbiddenMoves;
-        }
+    if(!checkActiveTetromino()){
+        this->gameOver = true;
+        if(this->gameScore > this->gameScoreRecord)
+            this->gameScoreRecord = this->gameScore;
+
+        this->accumulateForbiddenMoves += this->nbForbiddenMoves;
     }
 
-    // Replacing active tetromino in grid for learning agent
-    for(auto& block : this->activeTetrominoPos)
-        setTileAt(block.x, block.y, this->activeTetrominoType);
+    // Placing new active tetromino in grid for learning agent
+    drawActiveTetromino();
+}
 
+template <int W, int H>
+void Tetris<W, H>::doPlacement(uint64_t placement) {
+    this->nbPlayedFrames++;
+
+    this->lastTetrominoRotation = this->activeTetrominoRotation;
+    this->lastTetrominoOrigin = this->activeTetrominoOrigin;
+
+    if(this->reachablePlacements[placement]){
+        this->activeTetrominoRotation = (int)placement / WIDTH;
+        this->activeTetrominoOrigin.x = (int)placement % WIDTH
+                - TETROMINO_SHAPES[this->activeTetrominoType - 1][this->activeTetrominoRotation].minX;
+    }
+    else {
+        // Unreachable placement, the tetromino is dropped from its initial position
+        this->nbForbiddenMoves++;
+    }
+
+    // Hard drop
+    sf::Vector2<int> below(this->activeTetrominoOrigin.x, this->activeTetrominoOrigin.y + 1);
+    while(checkTetromino(this->activeTetrominoType, this->activeTetrominoRotation, below))
+        below.y++;
+    this->activeTetrominoOrigin.y = below.y - 1;
+
+    placeActiveTetromino();
 }
 
-bool Tetris::checkActiveTetromino() {
+template <int W, int H>
+void Tetris<W, H>::computeReachablePlacements() {
+    this->reachablePlacements.reset();
 
-    for(auto& block : this->activeTetrominoPos){
+    for(int rotation = 0; rotation < 4; rotation++){
+        // Rotations are done at the initial position, a blocked rotation blocks the following ones
+        sf::Vector2<int> origin = this->activeTetrominoOrigin;
+        if(!checkTetromino(this->activeTetrominoType, rotation, origin))
+            break;
 
-        // Edges check
-        if(block.x < 0 || block.x >= WIDTH || block.y >= HEIGHT)
-            return false;
+        const int minX = TETROMINO_SHAPES[this->activeTetrominoType - 1][rotation].minX;
 
-        // Overlap with other blocks check
-        if(getTileAt(block.x, block.y) != 0)
-            return false;
-    }
+        for(; checkTetromino(this->activeTetrominoType, rotation, origin); origin.x++)
+            this->reachablePlacements.set(rotation * WIDTH + origin.x + minX);
 
-    return true;
+        origin.x = this->activeTetrominoOrigin.x - 1;
+        for(; checkTetromino(this->activeTetrominoType, rotation, origin); origin.x--)
+            this->reachablePlacements.set(rotation * WIDTH + origin.x + minX);
+    }
 }
 
-double Tetris::getTileAt(int x, int y) const {
-    return *this->grid.getDataAt(typeid(double), y*WIDTH + x).getSharedPointer<double>();
+template <int W, int H>
+bool Tetris<W, H>::checkActiveTetromino() {
+    return checkTetromino(this->activeTetrominoType, this->activeTetrominoRotation, this->activeTetrominoOrigin);
 }
 
-void Tetris::setTileAt(int x, int y, double value) {
-    this->grid.setDataAt(typeid(double), y*WIDTH + x, value);
+template <int W, int H>
+bool Tetris<W, H>::checkTetromino(int type, int rotation, const sf::Vector2<int>& origin) const {
+    const TetrominoShape& shape = TETROMINO_SHAPES[type - 1][rotation];
+
+    // Edges check
+    if(origin.x + shape.minX < 0 || origin.x + shape.maxX >= WIDTH || origin.y + shape.maxY >= HEIGHT)
+        return false;
+
+    // Overlap with other blocks check, unrolled over the 4 lines of the shape
+    return !overlapsBoard(shape, origin.x + shape.minX, origin.y + shape.minY, std::make_index_sequence<4>());
 }
 
-void Tetris::getNewTetromino(){
-    // Generates new tetromino type
-    this->activeTetrominoType = this->rng.getInt32(1, 7);
+template <int W, int H>
+void Tetris<W, H>::getTetrominoBlocks(Tetromino& t, int type, int rotation, const sf::Vector2<int>& origin) {
+    const TetrominoShape& shape = TETROMINO_SHAPES[type - 1][rotation];
 
     for(int i = 0; i < 4; i++){
-        // Column
-        this->activeTetrominoPos[i].x = TETROMINO_TEMPLATES[this->activeTetrominoType - 1][i] % 2
-                                  + TETROMINO_INITIAL_POSITION.x;
-        // Line
-        this->activeTetrominoPos[i].y = TETROMINO_TEMPLATES[this->activeTetrominoType - 1][i] / 2
-                                  + TETROMINO_INITIAL_POSITION.y;
+        t[i].x = origin.x + shape.x[i];
+        t[i].y = origin.y + shape.y[i];
     }
+}
 
+template <int W, int H>
+double Tetris<W, H>::getTileAt(int x, int y) const {
+    Tetromino blocks;
+    getTetrominoBlocks(blocks, this->activeTetrominoType, this->activeTetrominoRotation, this->activeTetrominoOrigin);
+
+    for(auto& block : blocks){
+        if(block.x == x && block.y == y)
+            return this->activeTetrominoType;
+    }
+
+    return this->boardColours[y][x];
 }
 
-void Tetris::rotateTetromino(Tetromino& t){
+template <int W, int H>
+void Tetris<W, H>::setTileAt(int x, int y, double value) {
+    if(value != 0)
+        this->board[y] |= ((Line)1 << x);
+    else
+        this->board[y] &= ~((Line)1 << x);
+    this->boardColours[y][x] = (uint8_t)value;
 
-    // Check for O tetromino because they don't rotate
-    if(activeTetrominoType != 7){
+    observeBoardTile(x, y);
+    this->observationVersion++;
+}
 
-        if(activeTetrominoType == 1){
-            // I tetromino don't have a central point of rotation
-            if(t[0].y == t[1].y){   // Tetromino is horizontal
-                t[0].x -= 2; t[0].y -= 2;
-                t[1].x -= 1; t[1].y -= 1;
-                t[3].x += 1; t[3].y += 1;
-            }
-            else{   // Tetromino is vertical
-                t[0].x += 2; t[0].y += 2;
-                t[1].x += 1; t[1].y += 1;
-                t[3].x -= 1; t[3].y -= 1;
-            }
+template <int W, int H>
+void Tetris<W, H>::setGridTile(int x, int y, double value) {
+    this->grid.setDataAt(typeid(double), y*WIDTH + x, value);
+    this->columns.setDataAt(typeid(double), x*HEIGHT + y, value);
+}
+
+template <int W, int H>
+void Tetris<W, H>::clearObservation() {
+    setObservationOverlay(nullptr);
+
+    if(this->observation == TetrisObservation::COLOURS){
+        for(int i = 0; i < WIDTH * HEIGHT; i++){
+            this->grid.setDataAt(typeid(double), i, 0.0);
+            this->columns.setDataAt(typeid(double), i, 0.0);
         }
-        else{
-            const sf::Vector2<int>& rotationPoint = t[1];
-
-            for(auto& block : t){
-                int x = block.y - rotationPoint.y;
-                int y = block.x - rotationPoint.x;
-                block.x = rotationPoint.x - x;
-                block.y = rotationPoint.y + y;
-            }
+    }
+    else {
+        for(int i = 0; i < WIDTH * HEIGHT; i++){
+            this->lockedPlane.setDataAt(typeid(uint8_t), i, 0);
+            this->lockedColumns.setDataAt(typeid(uint8_t), i, 0);
+            this->activePlane.setDataAt(typeid(uint8_t), i, 0);
         }
+    }
+}
 
+template <int W, int H>
+void Tetris<W, H>::observeBoardTile(int x, int y) {
+    if(this->observation == TetrisObservation::COLOURS){
+        setGridTile(x, y, this->boardColours[y][x]);
+    }
+    else {
+        uint8_t occupied = (this->boardColours[y][x] != 0) ? 1 : 0;
+        this->lockedPlane.setDataAt(typeid(uint8_t), y*WIDTH + x, occupied);
+        this->lockedColumns.setDataAt(typeid(uint8_t), x*HEIGHT + y, occupied);
     }
+}
 
+template <int W, int H>
+void Tetris<W, H>::observeActiveTile(int x, int y, bool drawn) {
+    if(this->observation == TetrisObservation::COLOURS)
+        setGridTile(x, y, drawn ? this->activeTetrominoType : this->boardColours[y][x]);
+    else
+        this->activePlane.setDataAt(typeid(uint8_t), y*WIDTH + x, drawn ? 1 : 0);
 }
 
-const Data::PrimitiveTypeArray2D<double>& Tetris::getGrid(){
-    return this->grid;
+template <int W, int H>
+int Tetris<W, H>::observedSize(TetrisObservation observation, TetrisObservation required, int size) {
+    return (observation == required) ? size : 1;
 }
 
-int Tetris::getGameScore() { return this->gameScore; }
+template <int W, int H>
+void Tetris<W, H>::drawActiveTetromino() {
+    Tetromino blocks;
+    getTetrominoBlocks(blocks, this->activeTetrominoType, this->activeTetrominoRotation, this->activeTetrominoOrigin);
 
-int Tetris::getGameScoreRecord() { return this->gameScoreRecord; }
+    for(auto& block : blocks)
+        observeActiveTile(block.x, block.y, true);
+    setObservationOverlay(&blocks);
+    this->observationVersion++;
+}
 
-double Tetris::getAverageForbiddenMoves() { return (this->accumulateForbiddenMoves / (double)this->nbGames); }
+template <int W, int H>
+void Tetris<W, H>::setObservationOverlay(const Tetromino* blocks) {
+    size_t tiles[4] = {};
+    size_t columnTiles[4] = {};
+    const size_t nbTiles = (blocks != nullptr) ? 4 : 0;
+    for(size_t i = 0; i < nbTiles; i++){
+        tiles[i] = (*blocks)[i].y * WIDTH + (*blocks)[i].x;
+        columnTiles[i] = (*blocks)[i].x * HEIGHT + (*blocks)[i].y;
+    }
 
-void Tetris::clearLines() {
+    if(this->observation == TetrisObservation::COLOURS){
+        this->grid.setOverlay(tiles, nbTiles);
+        this->columns.setOverlay(columnTiles, nbTiles);
+    }
+    else
+        this->activePlane.setOverlay(tiles, nbTiles);
+}
 
-    int k = HEIGHT-1;   // Destination line for falling lines
+template <int W, int H>
+void Tetris<W, H>::redrawActiveTetromino() {
+    if(this->lastTetrominoRotation == this->activeTetrominoRotation && this->lastTetrominoOrigin == this->activeTetrominoOrigin)
+        return;
 
-    for(int line = HEIGHT-1; line > 0; line--){
-        int count = 0;
+    // Restore board content under the previous position
+    Tetromino previous;
+    getTetrominoBlocks(previous, this->activeTetrominoType, this->lastTetrominoRotation, this->lastTetrominoOrigin);
 
-        for(int tile = 0; tile < WIDTH; tile++){
-            double currentTile = getTileAt(tile, line);
-            if(currentTile != 0)
-                count++;
+    for(auto& block : previous)
+        observeActiveTile(block.x, block.y, false);
 
-            setTileAt(tile, k, currentTile);
+    drawActiveTetromino();
+}
+
+template <int W, int H>
+void Tetris<W, H>::lockActiveTetromino() {
+    // The colour grid already displays the active tetromino at this position, occupancy observations move its
+    // blocks from the active plane to the locked one
+    Tetromino blocks;
+    getTetrominoBlocks(blocks, this->activeTetrominoType, this->activeTetrominoRotation, this->activeTetrominoOrigin);
+
+    for(auto& block : blocks){
+        this->board[block.y] |= ((Line)1 << block.x);
+        this->boardColours[block.y][block.x] = this->activeTetrominoType;
+        this->features.addBlock(block.x, block.y);
+
+        if(this->observation == TetrisObservation::OCCUPANCY){
+            observeActiveTile(block.x, block.y, false);
+            observeBoardTile(block.x, block.y);
         }
+    }
+    setObservationOverlay(nullptr);
+    this->observationVersion++;
+}
+
+template <int W, int H>
+void Tetris<W, H>::copyLine(int src, int dest) {
+    if(src == dest)
+        return;
 
-        if(count < WIDTH)
+    this->board[dest] = this->board[src];
+    for(int tile = 0; tile < WIDTH; tile++){
+        if(this->boardColours[dest][tile] != this->boardColours[src][tile]){
+            this->boardColours[dest][tile] = this->boardColours[src][tile];
+            observeBoardTile(tile, dest);
+        }
+    }
+    this->observationVersion++;
+}
+
+template <int W, int H>
+void Tetris<W, H>::getNewTetromino(){
+    // Generates new tetromino type
+    this->activeTetrominoType = this->tetrominoSource.next();
+
+    this->activeTetrominoRotation = 0;
+    this->activeTetrominoOrigin = sf::Vector2<int>(TETROMINO_INITIAL_X, TETROMINO_INITIAL_Y);
+
+    if(this->actionMode == TetrisActionMode::PLACEMENT)
+        computeReachablePlacements();
+}
+
+template <int W, int H>
+const Data::PrimitiveTypeArray2D<double>& Tetris<W, H>::getGrid(){
+    return this->grid;
+}
+
+template <int W, int H>
+TetrisActionMode Tetris<W, H>::getActionMode() const { return this->actionMode; }
+
+template <int W, int H>
+TetrominoRandomizer Tetris<W, H>::getRandomizer() const { return this->randomizer; }
+
+template <int W, int H>
+TetrisObservation Tetris<W, H>::getObservation() const { return this->observation; }
+
+template <int W, int H>
+bool Tetris<W, H>::isPlacementReachable(uint64_t placement) const { return this->reachablePlacements[placement]; }
+
+template <int W, int H>
+uint64_t Tetris<W, H>::getObservationVersion() const { return this->observationVersion; }
+
+template <int W, int H>
+int Tetris<W, H>::getGameScore() { return this->gameScore; }
+
+template <int W, int H>
+int Tetris<W, H>::getGameScoreRecord() { return this->gameScoreRecord; }
+
+template <int W, int H>
+double Tetris<W, H>::getAverageForbiddenMoves() { return (this->accumulateForbiddenMoves / (double)this->nbGames); }
+
+template <int W, int H>
+void Tetris<W, H>::clearLines() {
+
+    int k = HEIGHT-1;   // Destination line for falling lines
+
+    for(int line = HEIGHT-1; line > 0; line--){
+        copyLine(line, k);
+
+        if(this->board[line] != FULL_LINE)
             k--;
     }
 
     gameScore += k;
 
+    // Lines moved, features are recomputed from the whole board
+    if(k > 0)
+        this->features.update(this->board);
 }
 
 
 
-void Tetris::playSolo() {
+template <int W, int H>
+void Tetris<W, H>::playSolo() {
     this->reset(time(nullptr));
     int actionID = 0;
 
-    Render render(*this, 18);
+    Render<W, H> render(*this, 18);
     render.initialise();
     render.update();
 
@@ -298,6 +581,9 @@ void Tetris::playSolo() {
     int framePerMove = 5;
     int frameCounter = 0;
 
+    // Frames are played as fast as possible when fast forwarding
+    bool fastForward = false;
+
     while(!isTerminal()){
         clk.restart();
 
@@ -329,6 +615,9 @@ void Tetris::playSolo() {
                         case sf::Keyboard::Escape:
                             gameOver = true;
                             break;
+                        case sf::Keyboard::F:
+                            fastForward = !fastForward;
+                            break;
 
                         default:
                             break;
@@ -353,7 +642,7 @@ void Tetris::playSolo() {
 
         sf::Time activeFrameTime = clk.getElapsedTime();
         sf::Time endOfFrameDelay =  frameTime - activeFrameTime;
-        if(endOfFrameDelay.asMilliseconds() > 0)
+        if(!fastForward && endOfFrameDelay.asMilliseconds() > 0)
             sf::sleep(endOfFrameDelay);
     }
 
@@ -361,4 +650,6 @@ void Tetris::playSolo() {
 
     std::cout << "Game Over" << std::endl << "Score : " << this->gameScore << std::endl;
 
-}
\ No newline at end of file
+}
+
+TETRIS_INSTANTIATE(Tetris)
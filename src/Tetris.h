@@ -1,14 +1,227 @@
 #ifndef GEGELATI_TETRIS_TETRIS_H
 #define GEGELATI_TETRIS_TETRIS_H
 
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
 #include <gegelati.h>
 #include <SFML/System/Vector2.hpp>
 
+#include "ArchivedArray.h"
+#include "TetrisFeatures.h"
+#include "TetrominoSequence.h"
+
+/// Default grid geometry, can be set at configuration time (see CMakeLists.txt)
+#ifndef TETRIS_WIDTH
+#define TETRIS_WIDTH 10
+#endif
+#ifndef TETRIS_HEIGHT
+#define TETRIS_HEIGHT 20
+#endif
+
+/// Explicit instantiation of a class template parameterized by the grid geometry, for the supported geometries :
+/// 10 * 20, 12 * 24, 16 * 32 and the default one.
+#if (TETRIS_WIDTH == 10 && TETRIS_HEIGHT == 20) || (TETRIS_WIDTH == 12 && TETRIS_HEIGHT == 24) \
+    || (TETRIS_WIDTH == 16 && TETRIS_HEIGHT == 32)
+#define TETRIS_INSTANTIATE(CLASS) \
+    template class CLASS<10, 20>; template class CLASS<12, 24>; template class CLASS<16, 32>;
+#else
+#define TETRIS_INSTANTIATE(CLASS) \
+    template class CLASS<10, 20>; template class CLASS<12, 24>; template class CLASS<16, 32>; \
+    template class CLASS<TETRIS_WIDTH, TETRIS_HEIGHT>;
+#endif
+
 /// Tetromino's blocks coordinates in the grid,
 ///  each tetromino having 4 blocks
 using Tetromino = sf::Vector2<int>[4];
 
+/// Template for tetrominos, gives block position
+/// in a 2 columns * 4 lines grid
+constexpr int TETROMINO_TEMPLATES[7][4] = {
+        {1, 3, 5, 7}, // I
+        {2, 4, 5, 7}, // S
+        {3, 4, 5, 6}, // Z
+        {3, 5, 4, 7}, // T
+        {2, 5, 3, 7}, // L
+        {3, 5, 7, 6}, // J
+        {2, 3, 4, 5}  // O
+};
+
+/// Shape of a tetromino in one orientation.
+/// Block coordinates are relative to the top left corner of the tetromino template.
+struct TetrominoShape {
+    /// Block coordinates, in the same order as in TETROMINO_TEMPLATES
+    int x[4];
+    int y[4];
+
+    /// Bounding box of the blocks
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+
+    /// Blocks of the 4 lines starting at line minY, bit 0 being column minX
+    uint32_t lines[4];
+};
+
+/**
+ * \brief Builds the shape of a tetromino after a number of clockwise rotations.
+ *
+ * Rotation rules : O tetrominos don't rotate, I tetrominos don't have a central point of rotation and alternate
+ * between their vertical and horizontal positions, other tetrominos rotate around their second block.
+ *
+ * \param type the tetromino type, from 1 to 7.
+ * \param rotation the number of clockwise rotations from the template.
+ */
+constexpr TetrominoShape makeTetrominoShape(int type, int rotation) {
+    TetrominoShape shape{};
+
+    for(int i = 0; i < 4; i++){
+        shape.x[i] = TETROMINO_TEMPLATES[type - 1][i] % 2;
+        shape.y[i] = TETROMINO_TEMPLATES[type - 1][i] / 2;
+    }
+
+    for(int r = 0; r < rotation && type != 7; r++){
+        if(type == 1){
+            int d = (shape.y[0] == shape.y[1]) ? -1 : 1;   // Horizontal or vertical
+            shape.x[0] += 2 * d; shape.y[0] += 2 * d;
+            shape.x[1] += d;     shape.y[1] += d;
+            shape.x[3] -= d;     shape.y[3] -= d;
+        }
+        else{
+            const int px = shape.x[1];
+            const int py = shape.y[1];
+            for(int i = 0; i < 4; i++){
+                int x = shape.y[i] - py;
+                int y = shape.x[i] - px;
+                shape.x[i] = px - x;
+                shape.y[i] = py + y;
+            }
+        }
+    }
+
+    shape.minX = shape.maxX = shape.x[0];
+    shape.minY = shape.maxY = shape.y[0];
+    for(int i = 1; i < 4; i++){
+        shape.minX = shape.x[i] < shape.minX ? shape.x[i] : shape.minX;
+        shape.maxX = shape.x[i] > shape.maxX ? shape.x[i] : shape.maxX;
+        shape.minY = shape.y[i] < shape.minY ? shape.y[i] : shape.minY;
+        shape.maxY = shape.y[i] > shape.maxY ? shape.y[i] : shape.maxY;
+    }
+
+    for(int i = 0; i < 4; i++)
+        shape.lines[shape.y[i] - shape.minY] |= 1u << (shape.x[i] - shape.minX);
+
+    return shape;
+}
+
+/// Builds the shapes of the 7 tetrominos in their 4 orientations
+constexpr std::array<std::array<TetrominoShape, 4>, 7> makeTetrominoShapes() {
+    std::array<std::array<TetrominoShape, 4>, 7> shapes{};
+    for(int type = 1; type <= 7; type++){
+        for(int rotation = 0; rotation < 4; rotation++)
+            shapes[type - 1][rotation] = makeTetrominoShape(type, rotation);
+    }
+    return shapes;
+}
+
+/// Shapes of all tetrominos, indexed by [type - 1][rotation]
+constexpr std::array<std::array<TetrominoShape, 4>, 7> TETROMINO_SHAPES = makeTetrominoShapes();
+
+/// Meaning of the actions of a Tetris environment
+enum class TetrisActionMode {
+    /// One action per frame : moving right, moving left, rotating, accelerating the fall or doing nothing
+    FRAME,
+    /// One action per tetromino : its final rotation and column, the tetromino being dropped immediately
+    PLACEMENT
+};
+
+/// Data sources observed by the TPG in a Tetris environment
+enum class TetrisObservation {
+    /// Colour of each tile, including the active tetromino, in a double grid and in its transposed copy
+    COLOURS,
+    /// Occupancy of the locked blocks, in a uint8_t plane and in its transposed copy, and occupancy of the active
+    /// tetromino in a separate uint8_t plane
+    OCCUPANCY
+};
+
+/**
+ * \brief Snapshot of the state of a game of Tetris<W, H>.
+ *
+ * The snapshot is trivially copyable, so that games can be saved and restored with plain copies, for instance to
+ * explore several moves from the same state. Global scoring data is not part of the state.
+ */
+template <int W, int H>
+struct TetrisState {
+    /// Occupancy and colours of the locked blocks, as in Tetris
+    BoardLine<W> board[H + 3];
+    uint8_t boardColours[H][W];
+
+    /// Features of the locked blocks
+    typename TetrisFeatures<W, H>::State features;
+
+    /// Active tetromino
+    int32_t activeTetrominoType;
+    int32_t activeTetrominoRotation;
+    int32_t activeTetrominoX;
+    int32_t activeTetrominoY;
+
+    /// Frame counter since last fall
+    int32_t fallCounter;
+
+    /// Does the active tetromino has to fall faster
+    bool accelerateFall;
+
+    /// Is the game finished
+    bool gameOver;
+
+    /// Placements reachable by the active tetromino, in placement mode
+    std::bitset<4 * W> reachablePlacements;
+
+    /// Tetromino generation : seed of the game and number of tetrominos generated since reset
+    uint64_t tetrominoSeed;
+    uint64_t nbGeneratedTetrominos;
+
+    /// Scoring of the game
+    int32_t gameScore;
+    int32_t nbForbiddenMoves;
+    int32_t nbPlayedTetrominos;
+    int32_t nbPlayedFrames;
+    int32_t nbTetroRotations;
+};
+
+template <int W, int H> class TetrisBatch;
+template <int W, int H> class TetrisPool;
+
+/**
+ * \brief Tetris learning environment.
+ *
+ * \tparam W width of the grid.
+ * \tparam H height of the grid.
+ */
+template <int W = TETRIS_WIDTH, int H = TETRIS_HEIGHT>
 class Tetris : public Learn::LearningEnvironment {
+
+    static_assert(W >= 4 && W <= 32, "Board lines are stored in at most 32 bits masks.");
+    static_assert(H >= 4, "Tetrominos must fit in the grid.");
+    static_assert(std::is_trivially_copyable<TetrisState<W, H>>::value, "States are saved and restored by copy.");
+
+    /// TetrisBatch shares the rules and constants of the game
+    friend class TetrisBatch<W, H>;
+
+public:
+
+    /// Height of the grid
+    static constexpr int HEIGHT = H;
+    /// Width of the grid
+    static constexpr int WIDTH = W;
+
+    /// Bitmask of a board line, smallest unsigned type holding WIDTH bits
+    using Line = BoardLine<W>;
+
 private:
 
     /// The main grid of the game
@@ -20,33 +233,79 @@ private:
     /// 5 : Orange (L)
     /// 6 : Blue (J)
     /// 7 : Yellow (O)
-    /// Its size is 10 columns * 20 lines (original tetris grid size) (might be configurable in the future).
-    Data::PrimitiveTypeArray2D<double> grid;
+    /// Its size is W columns * H lines (original tetris grid size is 10 * 20).
+    /// The active tetromino is the overlay of the grid, so that archived grids share the packed locked blocks.
+    ArchivableArray<double> grid;
     // When accessing data with getDataAt, content is in the form of a 1D array, line after line
 
+    /// Transposed copy of grid, third observed data source, kept in sync with every write to grid.
+    /// Each of its H * W lines is a column of grid, so that column instructions read contiguous memory instead of
+    /// gathering one tile every W.
+    ArchivableArray<double> columns;
+
+    /// Occupancy observation : 1 for the locked blocks and 0 elsewhere, in a W columns * H lines plane and in its
+    /// transposed copy, and 1 for the blocks of the active tetromino in a separate plane.
+    /// Only the data sources of the observation of the environment are allocated, the others have a single tile.
+    ArchivableArray<uint8_t> lockedPlane;
+    ArchivableArray<uint8_t> lockedColumns;
+    ArchivableArray<uint8_t> activePlane;
+
+    /// Occupancy of the locked blocks, one bitmask per line where bit x is set if tile (x, line) is not empty.
+    /// The active tetromino is not part of the board, it is only drawn on top of it in grid.
+    /// This is the reference board for collisions and line clearing, grid is kept in sync with it.
+    /// The last 3 lines are always empty, so that the 4 lines of any shape can be read without bound checks.
+    Line board[HEIGHT + 3];
+
+    /// Colour of each locked tile of the board, with the same encoding as grid.
+    uint8_t boardColours[HEIGHT][WIDTH];
+
+    /// Features of the board (row fills, column heights, holes and bumpiness), second observed data source
+    TetrisFeatures<W, H> features;
+
+    /// Incremented each time the observed data sources may have changed
+    uint64_t observationVersion;
+
+    /// Bitmask of a complete line
+    static constexpr Line FULL_LINE = (Line)(((uint64_t)1 << WIDTH) - 1);
+
     /// Number of available actions, at the moment : moving right (0), moving left (1),
     /// rotate clockwise (2), accelerate fall (3) and do nothing (4)
-    static const int NB_ACTIONS;
+    static constexpr int NB_ACTIONS = 5;
 
-    /// Number fo frame between each time the active tetromino falls from one block
-    static const int FRAMES_PER_FALL;
+    /// Number of available actions in placement mode : 4 rotations * WIDTH columns.
+    /// Action rotation * WIDTH + column places the tetromino rotated clockwise rotation times, with its leftmost
+    /// block in the given column.
+    static constexpr int NB_PLACEMENTS = 4 * WIDTH;
 
-    /// Initial coordinate of the top left block of a newly generated tetromino
-    static const sf::Vector2<int> TETROMINO_INITIAL_POSITION;
+    /// Number fo frame between each time the active tetromino falls from one block
+    static constexpr int FRAMES_PER_FALL = 20;
 
-    /// Template for tetrominos, gives block position
-    /// in a 2 columns * 4 lines grid
-    static const int TETROMINO_TEMPLATES[7][4];
+    /// Initial coordinate of the top left corner of a newly generated tetromino's template
+    static constexpr int TETROMINO_INITIAL_X = WIDTH / 2 - 1;
+    static constexpr int TETROMINO_INITIAL_Y = 0;
 
     /// Type of the currently falling tetromino, this type follows the same association
     /// given for the grid content
     int activeTetrominoType;
 
-    /// Active tetromino's block coordinates
-    Tetromino activeTetrominoPos;
+    /// Number of clockwise rotations of the active tetromino, modulo 4
+    int activeTetrominoRotation;
+
+    /// Position of the top left corner of the active tetromino's template
+    sf::Vector2<int> activeTetrominoOrigin;
+
+    /// Active tetromino's last rotation and position, also drawn in grid during doAction
+    int lastTetrominoRotation;
+    sf::Vector2<int> lastTetrominoOrigin;
+
+    /// Meaning of the actions given to doAction
+    TetrisActionMode actionMode;
+
+    /// Data sources observed by the TPG
+    TetrisObservation observation;
 
-    /// Active tetromino's last coordinates
-    Tetromino lastTetrominoPos;
+    /// Placements of the active tetromino that can be reached from its initial position, in placement mode
+    std::bitset<NB_PLACEMENTS> reachablePlacements;
 
     /// Frame counter since last fall
     int fallCounter;
@@ -57,8 +316,11 @@ private:
     /// Does the active tetromino has to fall faster
     bool accelerateFall;
 
-    /// Randomness control, used for tetromino generation
-    Mutator::RNG rng;
+    /// Way of drawing the tetrominos
+    TetrominoRandomizer randomizer;
+
+    /// Tetrominos of the game, read from the sequence shared by all games with the same seed
+    TetrominoSource tetrominoSource;
 
     /* Scoring */
 
@@ -88,33 +350,105 @@ private:
     /// Total number of games launched (aka reset) since last global reset
     int nbGames;
 
+    /// Checks the lines of a shape against the board, one line mask per line of the shape.
+    template <size_t... L>
+    bool overlapsBoard(const TetrominoShape& shape, int x, int y, std::index_sequence<L...>) const {
+        return ((this->board[y + L] & ((Line)shape.lines[L] << x)) | ...) != 0;
+    }
+
 protected:
 
     /// Generates new active tetromino on top of the grid.
     void getNewTetromino();
 
-    /// Rotate clockwise a tetromino
-    void rotateTetromino(Tetromino& t);
+    /// Computes the block coordinates of a tetromino.
+    static void getTetrominoBlocks(Tetromino& t, int type, int rotation, const sf::Vector2<int>& origin);
+
+    /**
+     * \brief Checks if a tetromino can be placed on the board.
+     *
+     * \return false if it overlaps with other block or is out of bounds, true otherwise.
+     */
+    bool checkTetromino(int type, int rotation, const sf::Vector2<int>& origin) const;
 
     /// Clear completed lines and update the game Score
     void clearLines();
 
-    /// Sets tile value at (x,y) in the grid.
+    /// Freezes the active tetromino at its current position, then generates the next one.
+    void placeActiveTetromino();
+
+    /// Plays a placement action, dropping the active tetromino at once.
+    void doPlacement(uint64_t placement);
+
+    /**
+     * \brief Lists the placements reachable by the active tetromino.
+     *
+     * A placement is reachable if the tetromino can be rotated at its initial position, then moved
+     * horizontally to its column without colliding.
+     */
+    void computeReachablePlacements();
+
+    /// Sets tile value at (x,y) in the board and in the grid.
     void setTileAt(int x, int y, double value);
 
-public:
+    /// Sets tile value at (x,y) in the grid and in its transposed copy, without changing the board.
+    void setGridTile(int x, int y, double value);
 
-    /// Height of the grid
-    static const int HEIGHT;
-    /// Width of the grid
-    static const int WIDTH;
+    /// Clears all the tiles of the observed data sources.
+    void clearObservation();
+
+    /// Updates the observed data sources after a change of the board at (x,y).
+    void observeBoardTile(int x, int y);
+
+    /// Updates the observed data sources when a block of the active tetromino is drawn at (x,y), or erased from it.
+    void observeActiveTile(int x, int y, bool drawn);
+
+    /// Size of an observed data source dimension, 1 if the data source is not part of the observation.
+    static int observedSize(TetrisObservation observation, TetrisObservation required, int size);
+
+    /// Draws the active tetromino in the grid, on top of the board.
+    void drawActiveTetromino();
+
+    /// Sets the blocks of the active tetromino as the overlay of the observed data sources, nullptr to clear it.
+    void setObservationOverlay(const Tetromino* blocks);
+
+    /// Moves the active tetromino drawn in the grid from its last rotation and position.
+    /// Nothing is written if the active tetromino did not move.
+    void redrawActiveTetromino();
+
+    /// Freezes the active tetromino in the board, the grid must already display it.
+    void lockActiveTetromino();
+
+    /// Copies line src of the board into line dest, updating the grid accordingly.
+    void copyLine(int src, int dest);
+
+public:
 
     /**
      * \brief Default constructor.
+     *
+     * \param actionMode meaning of the actions, one per frame by default.
+     * \param randomizer way of drawing the tetrominos, uniformly by default.
+     * \param observation data sources observed by the TPG, colours by default.
      */
-    Tetris() : LearningEnvironment(NB_ACTIONS), gameScore(0), activeTetrominoType(0),
-               gameScoreRecord(0), accumulateForbiddenMoves(0), nbGames(0), nbPlayedFrames(0),
-               grid(WIDTH, HEIGHT), gameOver(false), accelerateFall(false) {};
+    explicit Tetris(TetrisActionMode actionMode = TetrisActionMode::FRAME,
+                    TetrominoRandomizer randomizer = TetrominoRandomizer::UNIFORM,
+                    TetrisObservation observation = TetrisObservation::COLOURS) :
+               LearningEnvironment(actionMode == TetrisActionMode::PLACEMENT ? NB_PLACEMENTS : NB_ACTIONS),
+               grid(observedSize(observation, TetrisObservation::COLOURS, WIDTH),
+                    observedSize(observation, TetrisObservation::COLOURS, HEIGHT)),
+               columns(observedSize(observation, TetrisObservation::COLOURS, HEIGHT),
+                       observedSize(observation, TetrisObservation::COLOURS, WIDTH), true),
+               lockedPlane(observedSize(observation, TetrisObservation::OCCUPANCY, WIDTH),
+                           observedSize(observation, TetrisObservation::OCCUPANCY, HEIGHT)),
+               lockedColumns(observedSize(observation, TetrisObservation::OCCUPANCY, HEIGHT),
+                             observedSize(observation, TetrisObservation::OCCUPANCY, WIDTH), true),
+               activePlane(observedSize(observation, TetrisObservation::OCCUPANCY, WIDTH),
+                           observedSize(observation, TetrisObservation::OCCUPANCY, HEIGHT)),
+               board(), boardColours(), observationVersion(0), activeTetrominoType(0), activeTetrominoRotation(0),
+               lastTetrominoRotation(0), actionMode(actionMode), observation(observation), gameOver(false),
+               accelerateFall(false), randomizer(randomizer), gameScore(0), nbPlayedFrames(0), gameScoreRecord(0),
+               accumulateForbiddenMoves(0), nbGames(0) {};
 
     /**
      * \brief Copy constructor.
@@ -126,9 +460,21 @@ public:
     /// Destructor
     ~Tetris() override = default;
 
+    /// Allocation of Tetris environments, reusing the memory of deleted ones (see TetrisPool).
+    static void* operator new(size_t size);
+
+    /// Deallocation of Tetris environments, keeping the memory for later allocations (see TetrisPool).
+    static void operator delete(void* ptr, size_t size);
+
     /* LearningEnvironment methods */
 
-    /// Clones the current Tetris learning environment.
+    /**
+     * \brief Clones the current Tetris learning environment.
+     *
+     * The clone is a copy keeping the ids of the data sources, which the archive hashes with their values, so only
+     * its memory block comes from the TetrisPool. Environments that are not archived, such as those of lockstep
+     * episodes, are borrowed with TetrisPool::acquire instead, reusing their data sources too.
+     */
     virtual Learn::LearningEnvironment *clone() const override;
 
     /// Returns true.
@@ -149,15 +495,27 @@ public:
     /// Inherited via LearningEnvironment.
     virtual bool isTerminal() const override;
 
-    /// Gets tile value at (x,y) in the grid.
+    /// Gets tile value at (x,y) in the grid, i.e. including the active tetromino.
     double getTileAt(int x, int y) const;
 
-    /// Returns a const reference to the grid PrimitiveTypeArray2D
+    /// Returns a const reference to the grid PrimitiveTypeArray2D, only maintained with the colours observation
     const Data::PrimitiveTypeArray2D<double>& getGrid();
 
     /// Resets global data field (such as gameScoreRecord)
     void resetGlobalData();
 
+    /// Saves the state of the game.
+    TetrisState<W, H> saveState() const;
+
+    /**
+     * \brief Restores a state of the game.
+     *
+     * The state must come from an environment with the same action mode and randomizer. The observed data sources
+     * are updated accordingly, whatever the observation of the environment the state comes from : only the tiles
+     * and features that differ from the current ones are written.
+     */
+    void restoreState(const TetrisState<W, H>& state);
+
     /* Game methods */
 
     /**
@@ -167,6 +525,26 @@ public:
      */
     bool checkActiveTetromino();
 
+    /// Meaning of the actions of the environment.
+    TetrisActionMode getActionMode() const;
+
+    /// Way of drawing the tetrominos.
+    TetrominoRandomizer getRandomizer() const;
+
+    /// Data sources observed by the TPG.
+    TetrisObservation getObservation() const;
+
+    /**
+     * \brief Version of the observed data sources.
+     *
+     * The version changes whenever the grid or the board features may have changed. While it stays the same,
+     * a deterministic policy observing the environment keeps choosing the same action.
+     */
+    uint64_t getObservationVersion() const;
+
+    /// Can a placement be reached by the active tetromino, in placement mode.
+    bool isPlacementReachable(uint64_t placement) const;
+
     int getGameScore();
 
     int getGameScoreRecord();
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "TetrisBatch.h"
+
+template <int W, int H>
+TetrisBatch<W, H>::TetrisBatch(size_t nbGames, bool observable, TetrominoRandomizer randomizer) : nbGames(nbGames),
+        board(nbGames * (H + 3), 0), boardColours(nbGames * H * W, 0),
+        activeTetrominoType(nbGames, 1),
+        rotation(nbGames, 0), originX(nbGames, 0), originY(nbGames, 0),
+        lastRotation(nbGames, 0), lastOriginX(nbGames, 0), lastOriginY(nbGames, 0),
+        nextRotation(nbGames, 0), nextOriginX(nbGames, 0), nextOriginY(nbGames, 0),
+        fallCounter(nbGames, 0), accelerateFall(nbGames, 0), gameOver(nbGames, 1), nbTetroRotations(nbGames, 0),
+        randomizer(randomizer), tetrominoSources(nbGames), gameScore(nbGames, 0), nbForbiddenMoves(nbGames, 0), nbPlayedTetrominos(nbGames, 0),
+        nbPlayedFrames(nbGames, 0), valid(nbGames, 0), locked(nbGames, 0), nbFullLines(nbGames, 0),
+        games(nbGames) {
+
+    if(observable){
+        this->grids.assign(nbGames, ArchivableArray<double>(W, H));
+        this->columns.assign(nbGames, ArchivableArray<double>(H, W, true));
+        this->features.resize(nbGames);
+    }
+}
+
+template <int W, int H>
+size_t TetrisBatch<W, H>::getNbGames() const {
+    return this->nbGames;
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::reset(size_t game, size_t seed, Learn::LearningMode mode) {
+    // Same seeding as Tetris::reset
+    size_t hash_seed = Data::Hash<size_t>()(seed) ^ Data::Hash<Learn::LearningMode>()(mode);
+    this->tetrominoSources[game].reset(hash_seed, this->randomizer);
+
+    for(int line = 0; line < H + 3; line++)
+        this->board[line * this->nbGames + game] = 0;
+    std::fill_n(this->boardColours.begin() + game * H * W, H * W, 0);
+
+    if(!this->grids.empty()){
+        for(int i = 0; i < H * W; i++){
+            this->grids[game].setDataAt(typeid(double), i, 0.0);
+            this->columns[game].setDataAt(typeid(double), i, 0.0);
+        }
+        this->features[game].reset();
+    }
+
+    getNewTetromino(game);
+    this->nbTetroRotations[game] = 0;
+
+    if(!this->grids.empty())
+        drawActiveTetromino(game);
+
+    this->fallCounter[game] = 0;
+    this->accelerateFall[game] = 0;
+    this->gameScore[game] = 0;
+    this->nbForbiddenMoves[game] = 0;
+    this->nbPlayedTetrominos[game] = 0;
+    this->nbPlayedFrames[game] = 0;
+    this->gameOver[game] = 0;
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::reset(const size_t* seeds, Learn::LearningMode mode) {
+    for(size_t game = 0; game < this->nbGames; game++)
+        reset(game, seeds[game], mode);
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::doActions(const uint64_t* actions) {
+    step(actions, 0, this->nbGames);
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::step(const uint64_t* actions, size_t first, size_t last) {
+    moveTetrominos(actions, first, last);
+    lockTetrominos(first, last);
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::checkNextTetrominos(size_t first, size_t last) {
+    const size_t n = this->nbGames;
+    const Line* board = this->board.data();
+    uint8_t* valid = this->valid.data();
+
+    for(size_t g = first; g < last; g++){
+        const TetrominoShape& shape = TETROMINO_SHAPES[this->activeTetrominoType[g] - 1][this->nextRotation[g]];
+        const int32_t x = this->nextOriginX[g];
+        const int32_t y = this->nextOriginY[g];
+
+        // Edges check (shapes never go above their origin, so lines are never negative)
+        const uint8_t inBounds = (x + shape.minX >= 0) & (x + shape.maxX < W) & (y + shape.maxY < H);
+
+        // Overlap with other blocks check, the 3 padding lines keep the 4 line reads in bounds
+        const int32_t x0 = inBounds ? x + shape.minX : 0;
+        const Line* lines = board + (inBounds ? y + shape.minY : 0) * n + g;
+        const Line overlap = (lines[0] & ((Line)shape.lines[0] << x0)) | (lines[n] & ((Line)shape.lines[1] << x0))
+                             | (lines[2 * n] & ((Line)shape.lines[2] << x0)) | (lines[3 * n] & ((Line)shape.lines[3] << x0));
+
+        valid[g] = inBounds & (overlap == 0);
+    }
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::moveTetrominos(const uint64_t* actions, size_t first, size_t last) {
+    // Candidate positions after the move
+    for(size_t g = first; g < last; g++){
+        const uint64_t action = actions[g - first];
+        this->lastRotation[g] = this->rotation[g];
+        this->lastOriginX[g] = this->originX[g];
+        this->lastOriginY[g] = this->originY[g];
+        this->nextRotation[g] = (this->rotation[g] + (action == 2)) & 3;
+        this->nextOriginX[g] = this->originX[g] + (action == 0) - (action == 1);
+        this->nextOriginY[g] = this->originY[g];
+    }
+
+    checkNextTetrominos(first, last);
+
+    // Keep valid moves, count forbidden ones and trigger falls
+    for(size_t g = first; g < last; g++){
+        const uint64_t action = actions[g - first];
+        const int32_t alive = !this->gameOver[g];
+        const int32_t accepted = alive & this->valid[g];
+
+        this->nbPlayedFrames[g] += alive;
+        this->nbForbiddenMoves[g] += alive & !this->valid[g];
+
+        this->nbTetroRotations[g] += accepted & (action == 2);
+        const int32_t fullTurn = this->nbTetroRotations[g] == 4;
+        this->nbTetroRotations[g] = fullTurn ? 0 : this->nbTetroRotations[g];
+        this->nbForbiddenMoves[g] += 4 * fullTurn;
+
+        this->accelerateFall[g] |= alive & (action == 3);
+        this->fallCounter[g] += alive;
+
+        const int32_t fall = alive & ((this->fallCounter[g] == Game_t::FRAMES_PER_FALL) | this->accelerateFall[g]);
+        this->fallCounter[g] = fall ? 0 : this->fallCounter[g];
+        this->accelerateFall[g] = fall ? 0 : this->accelerateFall[g];
+
+        this->rotation[g] = accepted ? this->nextRotation[g] : this->rotation[g];
+        this->originX[g] = accepted ? this->nextOriginX[g] : this->originX[g];
+        this->nextRotation[g] = this->rotation[g];
+        this->nextOriginX[g] = this->originX[g];
+        this->nextOriginY[g] = this->originY[g] + fall;
+    }
+
+    checkNextTetrominos(first, last);
+
+    // Apply falls, tetrominos that can't fall are locked
+    for(size_t g = first; g < last; g++){
+        const int32_t alive = !this->gameOver[g];
+        const int32_t falls = alive & this->valid[g];
+        this->locked[g] = alive & !this->valid[g];
+        this->originY[g] = falls ? this->nextOriginY[g] : this->originY[g];
+    }
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::lockTetrominos(size_t first, size_t last) {
+    const size_t n = this->nbGames;
+    const bool observable = !this->grids.empty();
+
+    // Freezing tetrominos in boards
+    for(size_t g = first; g < last; g++){
+        if(observable)
+            redrawActiveTetromino(g);
+
+        if(this->locked[g]){
+            Tetromino blocks;
+            Game_t::getTetrominoBlocks(blocks, this->activeTetrominoType[g], this->rotation[g],
+                                       sf::Vector2<int>(this->originX[g], this->originY[g]));
+
+            for(auto& block : blocks){
+                this->board[block.y * n + g] |= ((Line)1 << block.x);
+                this->boardColours[(g * H + block.y) * W + block.x] = this->activeTetrominoType[g];
+                if(observable)
+                    this->features[g].addBlock(block.x, block.y);
+            }
+        }
+    }
+
+    // Full lines detection, line 0 is never cleared by Tetris::clearLines
+    for(size_t g = first; g < last; g++)
+        this->nbFullLines[g] = 0;
+    for(int line = 1; line < H; line++){
+        const Line* boardLine = this->board.data() + line * n;
+        for(size_t g = first; g < last; g++)
+            this->nbFullLines[g] += this->locked[g] & (boardLine[g] == Game_t::FULL_LINE);
+    }
+
+    // Line shifting and new tetrominos, only for games whose tetromino locked
+    for(size_t g = first; g < last; g++){
+        if(!this->locked[g])
+            continue;
+
+        if(this->nbFullLines[g] > 0)
+            clearLines(g);
+
+        getNewTetromino(g);
+        this->nbPlayedTetrominos[g]++;
+
+        if(!checkActiveTetromino(g))
+            this->gameOver[g] = 1;
+
+        if(observable)
+            drawActiveTetromino(g);
+    }
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::clearLines(size_t game) {
+    int k = H - 1;   // Destination line for falling lines
+
+    for(int line = H - 1; line > 0; line--){
+        copyLine(game, line, k);
+
+        if(this->board[line * this->nbGames + game] != Game_t::FULL_LINE)
+            k--;
+    }
+
+    this->gameScore[game] += k;
+
+    // Lines moved, features are recomputed from the whole board
+    if(k > 0 && !this->features.empty())
+        this->features[game].update(this->board.data() + game, this->nbGames);
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::setGridTile(size_t game, int x, int y, double value) {
+    this->grids[game].setDataAt(typeid(double), y * W + x, value);
+    this->columns[game].setDataAt(typeid(double), x * H + y, value);
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::copyLine(size_t game, int src, int dest) {
+    if(src == dest)
+        return;
+
+    this->board[dest * this->nbGames + game] = this->board[src * this->nbGames + game];
+
+    uint8_t* srcColours = this->boardColours.data() + (game * H + src) * W;
+    uint8_t* destColours = this->boardColours.data() + (game * H + dest) * W;
+    for(int tile = 0; tile < W; tile++){
+        if(destColours[tile] != srcColours[tile]){
+            destColours[tile] = srcColours[tile];
+            if(!this->grids.empty())
+                setGridTile(game, tile, dest, srcColours[tile]);
+        }
+    }
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::getNewTetromino(size_t game) {
+    this->activeTetrominoType[game] = this->tetrominoSources[game].next();
+
+    this->rotation[game] = 0;
+    this->originX[game] = Game_t::TETROMINO_INITIAL_X;
+    this->originY[game] = Game_t::TETROMINO_INITIAL_Y;
+}
+
+template <int W, int H>
+bool TetrisBatch<W, H>::checkActiveTetromino(size_t game) const {
+    const TetrominoShape& shape = TETROMINO_SHAPES[this->activeTetrominoType[game] - 1][this->rotation[game]];
+    const int32_t x = this->originX[game];
+    const int32_t y = this->originY[game];
+
+    if(x + shape.minX < 0 || x + shape.maxX >= W || y + shape.maxY >= H)
+        return false;
+
+    for(int dy = 0; dy < 4; dy++){
+        if(this->board[(y + shape.minY + dy) * this->nbGames + game] & ((Line)shape.lines[dy] << (x + shape.minX)))
+            return false;
+    }
+
+    return true;
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::drawActiveTetromino(size_t game) {
+    Tetromino blocks;
+    Game_t::getTetrominoBlocks(blocks, this->activeTetrominoType[game], this->rotation[game],
+                               sf::Vector2<int>(this->originX[game], this->originY[game]));
+
+    size_t tiles[4];
+    size_t columnTiles[4];
+    for(int i = 0; i < 4; i++){
+        setGridTile(game, blocks[i].x, blocks[i].y, this->activeTetrominoType[game]);
+        tiles[i] = blocks[i].y * W + blocks[i].x;
+        columnTiles[i] = blocks[i].x * H + blocks[i].y;
+    }
+    this->grids[game].setOverlay(tiles, 4);
+    this->columns[game].setOverlay(columnTiles, 4);
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::redrawActiveTetromino(size_t game) {
+    if(this->lastRotation[game] == this->rotation[game] && this->lastOriginX[game] == this->originX[game]
+       && this->lastOriginY[game] == this->originY[game])
+        return;
+
+    // Restore board content under the previous position
+    Tetromino previous;
+    Game_t::getTetrominoBlocks(previous, this->activeTetrominoType[game], this->lastRotation[game],
+                               sf::Vector2<int>(this->lastOriginX[game], this->lastOriginY[game]));
+
+    for(auto& block : previous)
+        setGridTile(game, block.x, block.y, this->boardColours[(game * H + block.y) * W + block.x]);
+
+    drawActiveTetromino(game);
+}
+
+template <int W, int H>
+double TetrisBatch<W, H>::getScore(size_t game) const {
+    return this->gameScore[game] * 100 + this->nbPlayedTetrominos[game] - this->nbForbiddenMoves[game] * 0.1;
+}
+
+template <int W, int H>
+bool TetrisBatch<W, H>::isTerminal(size_t game) const {
+    return this->gameOver[game];
+}
+
+template <int W, int H>
+bool TetrisBatch<W, H>::allTerminal() const {
+    return std::all_of(this->gameOver.begin(), this->gameOver.end(), [](uint8_t over){ return over != 0; });
+}
+
+template <int W, int H>
+int TetrisBatch<W, H>::getGameScore(size_t game) const {
+    return this->gameScore[game];
+}
+
+template <int W, int H>
+double TetrisBatch<W, H>::getTileAt(size_t game, int x, int y) const {
+    Tetromino blocks;
+    Game_t::getTetrominoBlocks(blocks, this->activeTetrominoType[game], this->rotation[game],
+                               sf::Vector2<int>(this->originX[game], this->originY[game]));
+
+    for(auto& block : blocks){
+        if(block.x == x && block.y == y)
+            return this->activeTetrominoType[game];
+    }
+
+    return this->boardColours[(game * H + y) * W + x];
+}
+
+template <int W, int H>
+typename TetrisBatch<W, H>::Game& TetrisBatch<W, H>::getGame(size_t game) {
+    if(this->grids.empty())
+        throw std::runtime_error("Single game views need a TetrisBatch built with observations.");
+
+    if(this->games[game] == nullptr)
+        this->games[game] = std::make_unique<Game>(*this, game);
+
+    return *this->games[game];
+}
+
+template <int W, int H>
+TetrisBatch<W, H>::Game::Game(TetrisBatch& batch, size_t index) : LearningEnvironment(Game_t::NB_ACTIONS),
+        batch(batch), index(index) {}
+
+template <int W, int H>
+void TetrisBatch<W, H>::Game::doAction(uint64_t actionID) {
+    Learn::LearningEnvironment::doAction(actionID);
+
+    this->batch.step(&actionID, this->index, this->index + 1);
+}
+
+template <int W, int H>
+void TetrisBatch<W, H>::Game::reset(size_t seed, Learn::LearningMode mode) {
+    this->batch.reset(this->index, seed, mode);
+}
+
+template <int W, int H>
+std::vector<std::reference_wrapper<const Data::DataHandler>> TetrisBatch<W, H>::Game::getDataSources() {
+    auto result = std::vector<std::reference_wrapper<const Data::DataHandler>>();
+    result.push_back(this->batch.grids[this->index]);
+    result.push_back(this->batch.features[this->index].getFeatures());
+    result.push_back(this->batch.columns[this->index]);
+    return result;
+}
+
+template <int W, int H>
+double TetrisBatch<W, H>::Game::getScore() const {
+    return this->batch.getScore(this->index);
+}
+
+template <int W, int H>
+bool TetrisBatch<W, H>::Game::isTerminal() const {
+    return this->batch.isTerminal(this->index);
+}
+
+TETRIS_INSTANTIATE(TetrisBatch)
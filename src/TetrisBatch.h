@@ -0,0 +1,245 @@
+#ifndef GEGELATI_TETRIS_TETRISBATCH_H
+#define GEGELATI_TETRIS_TETRISBATCH_H
+
+#include <gegelati.h>
+
+#include <memory>
+#include <vector>
+
+#include "Tetris.h"
+
+/**
+ * \brief N independent Tetris games advanced in lockstep.
+ *
+ * The games are stored in struct-of-arrays form : each field of the game state is an array indexed by the game
+ * number, so that the collision checks and the full line detection of all games are branch-free loops over
+ * contiguous memory that the compiler vectorizes.
+ *
+ * The rules are those of Tetris::doAction and Tetris::clearLines, with the same TETROMINO_SHAPES : a game of the
+ * batch reset with a given seed and mode, then receiving a sequence of actions, goes through exactly the same
+ * states as a Tetris environment reset and played the same way.
+ *
+ * \tparam W width of the grid.
+ * \tparam H height of the grid.
+ */
+template <int W = TETRIS_WIDTH, int H = TETRIS_HEIGHT>
+class TetrisBatch {
+public:
+
+    /**
+     * \brief View on a single game of a TetrisBatch.
+     *
+     * This view behaves as a Tetris learning environment, for code that expects a Learn::LearningEnvironment.
+     * Its doAction() only advances its own game.
+     */
+    class Game : public Learn::LearningEnvironment {
+    private:
+
+        /// Batch containing the game
+        TetrisBatch& batch;
+
+        /// Index of the game in the batch
+        const size_t index;
+
+    public:
+
+        /**
+         * \brief Constructor.
+         *
+         * \param batch the TetrisBatch containing the game.
+         * \param index the index of the game in the batch.
+         */
+        Game(TetrisBatch& batch, size_t index);
+
+        /// Inherited via LearningEnvironment.
+        virtual void doAction(uint64_t actionID) override;
+
+        /// Inherited via LearningEnvironment.
+        virtual void reset(size_t seed = 0, Learn::LearningMode mode = Learn::LearningMode::TRAINING) override;
+
+        /// Inherited via LearningEnvironment.
+        virtual std::vector<std::reference_wrapper<const Data::DataHandler>> getDataSources() override;
+
+        /// Inherited via LearningEnvironment.
+        virtual double getScore() const override;
+
+        /// Inherited via LearningEnvironment.
+        virtual bool isTerminal() const override;
+    };
+
+private:
+
+    /// Rules and constants of the game
+    using Game_t = Tetris<W, H>;
+
+    /// Bitmask of a board line, same as Tetris
+    using Line = typename Game_t::Line;
+
+    /// Number of games in the batch
+    const size_t nbGames;
+
+    /// Occupancy of the locked blocks, at index line * nbGames + game (same bitmask encoding as Tetris).
+    /// As in Tetris, 3 always empty lines are kept below the board.
+    std::vector<Line> board;
+
+    /// Colour of each locked tile, at index (game * HEIGHT + line) * WIDTH + column
+    std::vector<uint8_t> boardColours;
+
+    /// Type of the active tetromino of each game
+    std::vector<int32_t> activeTetrominoType;
+
+    /// Active tetromino's rotation and position of its template top left corner
+    std::vector<int32_t> rotation;
+    std::vector<int32_t> originX;
+    std::vector<int32_t> originY;
+
+    /// Active tetromino's rotation and position at the beginning of the current frame
+    std::vector<int32_t> lastRotation;
+    std::vector<int32_t> lastOriginX;
+    std::vector<int32_t> lastOriginY;
+
+    /// Candidate rotation and position of the active tetromino
+    std::vector<int32_t> nextRotation;
+    std::vector<int32_t> nextOriginX;
+    std::vector<int32_t> nextOriginY;
+
+    /// Frame counter since last fall of each game
+    std::vector<int32_t> fallCounter;
+
+    /// Does the active tetromino of each game has to fall faster
+    std::vector<uint8_t> accelerateFall;
+
+    /// Is each game finished
+    std::vector<uint8_t> gameOver;
+
+    /// Number of rotations done on the active tetromino of each game
+    std::vector<int32_t> nbTetroRotations;
+
+    /// Way of drawing the tetrominos
+    const TetrominoRandomizer randomizer;
+
+    /// Tetrominos of each game, read from the sequences shared with all games using the same seed
+    std::vector<TetrominoSource> tetrominoSources;
+
+    /// Scoring of each game, same meaning as in Tetris
+    std::vector<int32_t> gameScore;
+    std::vector<int32_t> nbForbiddenMoves;
+    std::vector<int32_t> nbPlayedTetrominos;
+    std::vector<int32_t> nbPlayedFrames;
+
+    /// Result of the last collision check of each game
+    std::vector<uint8_t> valid;
+
+    /// Did the active tetromino of each game lock during the current frame
+    std::vector<uint8_t> locked;
+
+    /// Number of complete lines of each game during the current frame
+    std::vector<uint8_t> nbFullLines;
+
+    /// Grids observed by learning agents, in the same format as the Tetris grid, with the active tetromino as overlay.
+    /// Empty if the batch was built without observations.
+    std::vector<ArchivableArray<double>> grids;
+
+    /// Transposed copies of the grids, as the Tetris columns.
+    /// Empty if the batch was built without observations.
+    std::vector<ArchivableArray<double>> columns;
+
+    /// Board features observed by learning agents, as in Tetris.
+    /// Empty if the batch was built without observations.
+    std::vector<TetrisFeatures<W, H>> features;
+
+    /// Single game views, built on demand
+    std::vector<std::unique_ptr<Game>> games;
+
+    /**
+     * \brief Checks the candidate rotation and position of the active tetromino for games in [first, last).
+     *
+     * Result is stored in valid.
+     */
+    void checkNextTetrominos(size_t first, size_t last);
+
+    /// Moves and drops the active tetromino of games in [first, last), filling locked.
+    void moveTetrominos(const uint64_t* actions, size_t first, size_t last);
+
+    /// Locks the tetrominos that could not fall, clears lines and spawns new tetrominos for games in [first, last).
+    void lockTetrominos(size_t first, size_t last);
+
+    /// Clear completed lines of a game and update its score, as Tetris::clearLines
+    void clearLines(size_t game);
+
+    /// Generates a new active tetromino on top of the board of a game.
+    void getNewTetromino(size_t game);
+
+    /// Checks whether the active tetromino of a game has a valid position.
+    bool checkActiveTetromino(size_t game) const;
+
+    /// Sets tile value at (x,y) in the grid of a game and in its transposed copy.
+    void setGridTile(size_t game, int x, int y, double value);
+
+    /// Copies line src of the board of a game into line dest, updating its grid accordingly.
+    void copyLine(size_t game, int src, int dest);
+
+    /// Draws the active tetromino of a game in its grid.
+    void drawActiveTetromino(size_t game);
+
+    /// Moves the active tetromino of a game drawn in its grid from its position at the beginning of the frame.
+    void redrawActiveTetromino(size_t game);
+
+    /// Advances games in [first, last), actions[i] being the action of game first + i
+    void step(const uint64_t* actions, size_t first, size_t last);
+
+public:
+
+    /**
+     * \brief Constructor.
+     *
+     * \param nbGames number of games in the batch.
+     * \param observable if false, the grids observed by learning agents are not maintained and
+     * single game views are not available.
+     * \param randomizer way of drawing the tetrominos, as in Tetris.
+     */
+    explicit TetrisBatch(size_t nbGames, bool observable = true,
+                         TetrominoRandomizer randomizer = TetrominoRandomizer::UNIFORM);
+
+    TetrisBatch(const TetrisBatch& other) = delete;
+
+    TetrisBatch& operator=(const TetrisBatch& other) = delete;
+
+    /// Number of games in the batch.
+    size_t getNbGames() const;
+
+    /// Resets a single game, as Tetris::reset.
+    void reset(size_t game, size_t seed, Learn::LearningMode mode = Learn::LearningMode::TRAINING);
+
+    /// Resets all games, game g using seeds[g].
+    void reset(const size_t* seeds, Learn::LearningMode mode = Learn::LearningMode::TRAINING);
+
+    /**
+     * \brief Advances all games by one frame.
+     *
+     * \param actions the action of each game, with the same meaning as for Tetris::doAction.
+     * Finished games ignore their action.
+     */
+    void doActions(const uint64_t* actions);
+
+    /// Score of a game, as Tetris::getScore.
+    double getScore(size_t game) const;
+
+    /// Is a game finished.
+    bool isTerminal(size_t game) const;
+
+    /// Are all games finished.
+    bool allTerminal() const;
+
+    /// Number of cleared lines of a game.
+    int getGameScore(size_t game) const;
+
+    /// Gets tile value at (x,y) in a game, including its active tetromino.
+    double getTileAt(size_t game, int x, int y) const;
+
+    /// Single game view, usable as a learning environment.
+    Game& getGame(size_t game);
+};
+
+
+#endif //GEGELATI_TETRIS_TETRISBATCH_H
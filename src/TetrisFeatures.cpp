@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+
+#include "TetrisFeatures.h"
+#include "Tetris.h"
+
+template <int W, int H>
+TetrisFeatures<W, H>::TetrisFeatures() : features(SIZE), rowFills(), columnTops(), columnHoles(), nbHoles(0),
+        bumpiness(0) {
+    std::fill(std::begin(this->columnTops), std::end(this->columnTops), H);
+}
+
+template <int W, int H>
+void TetrisFeatures<W, H>::setFeature(size_t address, int value) {
+    this->features.setDataAt(typeid(double), address, value);
+}
+
+template <int W, int H>
+int TetrisFeatures<W, H>::heightDifference(int x) const {
+    return std::abs(this->columnTops[x] - this->columnTops[x + 1]);
+}
+
+template <int W, int H>
+void TetrisFeatures<W, H>::reset() {
+    std::fill(std::begin(this->rowFills), std::end(this->rowFills), 0);
+    std::fill(std::begin(this->columnTops), std::end(this->columnTops), H);
+    std::fill(std::begin(this->columnHoles), std::end(this->columnHoles), 0);
+    this->nbHoles = 0;
+    this->bumpiness = 0;
+
+    for(size_t i = 0; i < SIZE; i++)
+        setFeature(i, 0);
+}
+
+template <int W, int H>
+void TetrisFeatures<W, H>::addBlock(int x, int y) {
+    this->rowFills[y]++;
+    setFeature(ROW_FILLS + y, this->rowFills[y]);
+
+    if(y < this->columnTops[x]){
+        // New top of the column, empty tiles between the new and the previous top become holes
+        const int newHoles = this->columnTops[x] - y - 1;
+        this->columnHoles[x] += newHoles;
+        this->nbHoles += newHoles;
+
+        // Only the height differences with the neighbour columns change
+        if(x > 0)
+            this->bumpiness -= heightDifference(x - 1);
+        if(x < W - 1)
+            this->bumpiness -= heightDifference(x);
+
+        this->columnTops[x] = y;
+
+        if(x > 0)
+            this->bumpiness += heightDifference(x - 1);
+        if(x < W - 1)
+            this->bumpiness += heightDifference(x);
+
+        setFeature(COLUMN_HEIGHTS + x, H - y);
+        setFeature(BUMPINESS, this->bumpiness);
+    }
+    else {
+        // Block below the top of the column, filling a hole
+        this->columnHoles[x]--;
+        this->nbHoles--;
+    }
+
+    setFeature(COLUMN_HOLES + x, this->columnHoles[x]);
+    setFeature(NB_HOLES, this->nbHoles);
+}
+
+template <int W, int H>
+void TetrisFeatures<W, H>::update(const BoardLine<W>* board, size_t stride) {
+    std::fill(std::begin(this->columnTops), std::end(this->columnTops), H);
+    std::fill(std::begin(this->columnHoles), std::end(this->columnHoles), 0);
+
+    for(int y = 0; y < H; y++){
+        const BoardLine<W> line = board[y * stride];
+        this->rowFills[y] = (int)std::bitset<W>(line).count();
+
+        for(int x = 0; x < W; x++){
+            if((line >> x) & 1)
+                this->columnTops[x] = std::min(this->columnTops[x], y);
+            else if(this->columnTops[x] < y)
+                this->columnHoles[x]++;
+        }
+    }
+
+    this->nbHoles = 0;
+    this->bumpiness = 0;
+    for(int x = 0; x < W; x++){
+        this->nbHoles += this->columnHoles[x];
+        if(x < W - 1)
+            this->bumpiness += heightDifference(x);
+    }
+
+    for(int y = 0; y < H; y++)
+        setFeature(ROW_FILLS + y, this->rowFills[y]);
+    for(int x = 0; x < W; x++){
+        setFeature(COLUMN_HEIGHTS + x, H - this->columnTops[x]);
+        setFeature(COLUMN_HOLES + x, this->columnHoles[x]);
+    }
+    setFeature(NB_HOLES, this->nbHoles);
+    setFeature(BUMPINESS, this->bumpiness);
+}
+
+template <int W, int H>
+typename TetrisFeatures<W, H>::State TetrisFeatures<W, H>::save() const {
+    State state;
+    std::copy(std::begin(this->rowFills), std::end(this->rowFills), state.rowFills);
+    std::copy(std::begin(this->columnTops), std::end(this->columnTops), state.columnTops);
+    std::copy(std::begin(this->columnHoles), std::end(this->columnHoles), state.columnHoles);
+    state.nbHoles = this->nbHoles;
+    state.bumpiness = this->bumpiness;
+    return state;
+}
+
+template <int W, int H>
+void TetrisFeatures<W, H>::restore(const State& state) {
+    for(int y = 0; y < H; y++){
+        if(this->rowFills[y] != state.rowFills[y]){
+            this->rowFills[y] = state.rowFills[y];
+            setFeature(ROW_FILLS + y, this->rowFills[y]);
+        }
+    }
+
+    for(int x = 0; x < W; x++){
+        if(this->columnTops[x] != state.columnTops[x]){
+            this->columnTops[x] = state.columnTops[x];
+            setFeature(COLUMN_HEIGHTS + x, H - this->columnTops[x]);
+        }
+        if(this->columnHoles[x] != state.columnHoles[x]){
+            this->columnHoles[x] = state.columnHoles[x];
+            setFeature(COLUMN_HOLES + x, this->columnHoles[x]);
+        }
+    }
+
+    if(this->nbHoles != state.nbHoles){
+        this->nbHoles = state.nbHoles;
+        setFeature(NB_HOLES, this->nbHoles);
+    }
+    if(this->bumpiness != state.bumpiness){
+        this->bumpiness = state.bumpiness;
+        setFeature(BUMPINESS, this->bumpiness);
+    }
+}
+
+template <int W, int H>
+const Data::PrimitiveTypeArray<double>& TetrisFeatures<W, H>::getFeatures() const {
+    return this->features;
+}
+
+template <int W, int H>
+int TetrisFeatures<W, H>::getRowFill(int y) const {
+    return this->rowFills[y];
+}
+
+template <int W, int H>
+int TetrisFeatures<W, H>::getColumnHeight(int x) const {
+    return H - this->columnTops[x];
+}
+
+template <int W, int H>
+int TetrisFeatures<W, H>::getNbHoles() const {
+    return this->nbHoles;
+}
+
+template <int W, int H>
+int TetrisFeatures<W, H>::getBumpiness() const {
+    return this->bumpiness;
+}
+
+TETRIS_INSTANTIATE(TetrisFeatures)
@@ -0,0 +1,121 @@
+#ifndef GEGELATI_TETRIS_TETRISFEATURES_H
+#define GEGELATI_TETRIS_TETRISFEATURES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <gegelati.h>
+
+#include "ArchivedArray.h"
+
+/// Bitmask of a board line of width W, smallest unsigned type holding W bits
+template <int W>
+using BoardLine = std::conditional_t<(W <= 16), uint16_t, uint32_t>;
+
+/**
+ * \brief Features of the locked blocks of a Tetris board, observable by learning agents.
+ *
+ * Features are updated incrementally when a tetromino is locked, only the rows and columns of its blocks being
+ * touched, so that programs read them directly instead of recomputing them from the grid.
+ * They are fully recomputed from the board when lines are cleared.
+ *
+ * \tparam W width of the grid.
+ * \tparam H height of the grid.
+ */
+template <int W, int H>
+class TetrisFeatures {
+public:
+
+    /// Address of the number of blocks of each row, from top to bottom
+    static constexpr size_t ROW_FILLS = 0;
+    /// Address of the height of each column, from left to right
+    static constexpr size_t COLUMN_HEIGHTS = ROW_FILLS + H;
+    /// Address of the number of holes (empty tiles below the top of the column) of each column
+    static constexpr size_t COLUMN_HOLES = COLUMN_HEIGHTS + W;
+    /// Address of the total number of holes
+    static constexpr size_t NB_HOLES = COLUMN_HOLES + W;
+    /// Address of the bumpiness, the sum of height differences between adjacent columns
+    static constexpr size_t BUMPINESS = NB_HOLES + 1;
+    /// Number of features
+    static constexpr size_t SIZE = BUMPINESS + 1;
+
+    /// Values the features are computed from, trivially copyable so that they are saved with the state of a game
+    struct State {
+        int32_t rowFills[H];
+        int32_t columnTops[W];
+        int32_t columnHoles[W];
+        int32_t nbHoles;
+        int32_t bumpiness;
+    };
+
+private:
+
+    /// Features observed by learning agents, in the order given by the addresses above
+    ArchivableArray<double, Data::PrimitiveTypeArray<double>> features;
+
+    /// Number of blocks of each row
+    int rowFills[H];
+
+    /// Line of the highest block of each column, H for an empty column
+    int columnTops[W];
+
+    /// Number of holes of each column
+    int columnHoles[W];
+
+    /// Total number of holes
+    int nbHoles;
+
+    /// Sum of height differences between adjacent columns
+    int bumpiness;
+
+    /// Sets a feature value in the data source
+    void setFeature(size_t address, int value);
+
+    /// Height difference between columns x and x + 1
+    int heightDifference(int x) const;
+
+public:
+
+    /// Constructor, for an empty board.
+    TetrisFeatures();
+
+    /// Resets the features to those of an empty board.
+    void reset();
+
+    /// Updates the features after a block was locked at (x, y).
+    void addBlock(int x, int y);
+
+    /**
+     * \brief Recomputes all features from a board.
+     *
+     * \param board occupancy of the locked blocks, one bitmask per line where bit x is set if tile (x, line) is
+     * not empty.
+     * \param stride distance between two consecutive lines in board.
+     */
+    void update(const BoardLine<W>* board, size_t stride = 1);
+
+    /// Saves the values the features are computed from.
+    State save() const;
+
+    /// Restores saved features, only writing the observed features that changed.
+    void restore(const State& state);
+
+    /// Returns a const reference to the features data source.
+    const Data::PrimitiveTypeArray<double>& getFeatures() const;
+
+    /// Number of blocks of a row.
+    int getRowFill(int y) const;
+
+    /// Height of a column.
+    int getColumnHeight(int x) const;
+
+    /// Total number of holes.
+    int getNbHoles() const;
+
+    /// Sum of height differences between adjacent columns.
+    int getBumpiness() const;
+};
+
+
+#endif //GEGELATI_TETRIS_TETRISFEATURES_H
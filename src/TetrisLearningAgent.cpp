@@ -0,0 +1,537 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include "Checkpoint.h"
+#include "instructions.h"
+#include "Profiler.h"
+#include "ReplayExecutionEngine.h"
+#include "TetrisPool.h"
+#include "TetrisLearningAgent.h"
+
+const size_t TetrisLearningAgent::RACING_MIN_RUNG_SIZE = 20;
+
+/// Number of frames played by the evaluations of the calling thread, to measure the length of each evaluation
+static thread_local uint64_t nbThreadFrames = 0;
+
+TetrisLearningAgent::TetrisLearningAgent(Tetris<>& le, const Instructions::Set& iSet,
+                                         const Learn::LearningParameters& p, const TetrisParameters& tetrisParams,
+                                         const TPG::TPGFactory& factory)
+        : Learn::ParallelLearningAgent(le, iSet, p, factory), nbInferences(0), nbSkippedInferences(0),
+          racing(tetrisParams.racing), racingKeepRatio(tetrisParams.racingKeepRatio), nbPlayedEpisodes(0),
+          nbPlayedFrames(0), nbRacedEpisodes(0), seed(0),
+          reseedEachGeneration(tetrisParams.reseedEachGeneration), workerPool(nullptr),
+          workStealing(tetrisParams.workStealing), pinThreads(tetrisParams.pinThreads),
+          lockstepEpisodes(tetrisParams.lockstepEpisodes), idleTail(0), idleThreadTime(0), evaluationThreadTime(0) {
+    if(this->lockstepEpisodes){
+        fillBatchInstructionSet(this->batchSet, tetrisParams.observation);
+
+        // Checks once that the instructions and the data sources can be executed in lockstep
+        try {
+            BatchExecutionEngine engine(this->env, this->batchSet, {le.getDataSources()});
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Can't play episodes in lockstep : " << e.what() << std::endl;
+            this->lockstepEpisodes = false;
+        }
+    }
+}
+
+void TetrisLearningAgent::init(uint64_t seed) {
+    this->seed = seed;
+    Learn::ParallelLearningAgent::init(seed);
+}
+
+uint64_t TetrisLearningAgent::getSeed() const {
+    return this->seed;
+}
+
+void TetrisLearningAgent::setSeed(uint64_t seed) {
+    this->seed = seed;
+}
+
+void TetrisLearningAgent::reseed(uint64_t generationNumber) {
+    this->rng.setSeed(Data::Hash<uint64_t>()(this->seed) ^ Data::Hash<uint64_t>()(generationNumber));
+}
+
+void TetrisLearningAgent::setWorkerPool(WorkerPool* workerPool) {
+    this->workerPool = workerPool;
+}
+
+std::multimap<std::shared_ptr<Learn::EvaluationResult>, const TPG::TPGVertex*>
+TetrisLearningAgent::evaluateAllRoots(uint64_t generationNumber, Learn::LearningMode mode) {
+    if(this->workerPool == nullptr){
+        if(this->workStealing && this->maxNbThreads > 1 && this->learningEnvironment.isCopyable())
+            return evaluateAllRootsWithStealing(generationNumber, mode);
+        return Learn::ParallelLearningAgent::evaluateAllRoots(generationNumber, mode);
+    }
+
+    std::vector<std::shared_ptr<Learn::Job>> jobs;
+    for(auto jobQueue = this->makeJobs(mode); !jobQueue.empty(); jobQueue.pop())
+        jobs.push_back(jobQueue.front());
+
+    // Roots are sent as their index in the serialized graph
+    std::unordered_map<const TPG::TPGVertex*, uint64_t> vertexIndexes;
+    for(const TPG::TPGVertex* vertex : this->tpg->getVertices())
+        vertexIndexes.emplace(vertex, vertexIndexes.size());
+
+    // Roots evaluated enough times keep their previous result, as in evaluateJob
+    std::vector<std::shared_ptr<Learn::EvaluationResult>> results(jobs.size());
+    std::vector<std::shared_ptr<Learn::EvaluationResult>> previousResults(jobs.size());
+    std::vector<size_t> remoteJobs;
+    std::vector<uint64_t> remoteRoots;
+    for(size_t i = 0; i < jobs.size(); i++){
+        const TPG::TPGVertex* root = jobs[i]->getRoot();
+        if(mode == Learn::LearningMode::TRAINING && this->isRootEvalSkipped(*root, previousResults[i]))
+            results[i] = previousResults[i];
+        else {
+            remoteJobs.push_back(i);
+            remoteRoots.push_back(vertexIndexes.at(root));
+        }
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.generation = generationNumber;
+    std::vector<RemoteEvaluation> evaluations = this->workerPool->evaluate(
+            serializeCheckpoint(checkpoint, *this->tpg, nullptr), generationNumber, mode, remoteRoots);
+
+    // Roots left by the workers are evaluated here, filling the archive in job order as
+    // Learn::ParallelLearningAgent does with a single thread
+    TPG::TPGExecutionEngine tee(this->env, (mode == Learn::LearningMode::TRAINING) ? &this->archive : nullptr);
+    for(size_t r = 0; r < remoteJobs.size(); r++){
+        const size_t i = remoteJobs[r];
+        const RemoteEvaluation& evaluation = evaluations[r];
+
+        if(!evaluation.done){
+            this->archive.setRandomSeed(jobs[i]->getArchiveSeed());
+            results[i] = this->evaluateJob(tee, *jobs[i], generationNumber, mode, this->learningEnvironment);
+            continue;
+        }
+
+        results[i] = std::make_shared<Learn::EvaluationResult>(evaluation.score, evaluation.nbEpisodes);
+        if(previousResults[i] != nullptr)
+            *results[i] += *previousResults[i];
+        this->nbInferences += evaluation.nbInferences;
+        this->nbSkippedInferences += evaluation.nbSkippedInferences;
+    }
+
+    // Results are listed in job order, whatever the order of their evaluation
+    std::multimap<std::shared_ptr<Learn::EvaluationResult>, const TPG::TPGVertex*> evaluatedRoots;
+    for(size_t i = 0; i < jobs.size(); i++)
+        evaluatedRoots.emplace(results[i], jobs[i]->getRoot());
+    return evaluatedRoots;
+}
+
+bool TetrisLearningAgent::takeJob(std::vector<JobDeque>& deques, size_t thread, size_t& job) {
+    {
+        std::lock_guard<std::mutex> lock(deques[thread].mutex);
+        if(!deques[thread].jobs.empty()){
+            job = deques[thread].jobs.front();
+            deques[thread].jobs.pop_front();
+            return true;
+        }
+    }
+
+    // Steals the longest job of the fullest deque, the sizes being read again under lock
+    while(true){
+        size_t victim = deques.size();
+        size_t victimSize = 0;
+        for(size_t d = 0; d < deques.size(); d++){
+            std::lock_guard<std::mutex> lock(deques[d].mutex);
+            if(deques[d].jobs.size() > victimSize){
+                victim = d;
+                victimSize = deques[d].jobs.size();
+            }
+        }
+        if(victim == deques.size())
+            return false;
+
+        std::lock_guard<std::mutex> lock(deques[victim].mutex);
+        if(!deques[victim].jobs.empty()){
+            job = deques[victim].jobs.front();
+            deques[victim].jobs.pop_front();
+            return true;
+        }
+    }
+}
+
+std::multimap<std::shared_ptr<Learn::EvaluationResult>, const TPG::TPGVertex*>
+TetrisLearningAgent::evaluateAllRootsWithStealing(uint64_t generationNumber, Learn::LearningMode mode) {
+    std::vector<std::shared_ptr<Learn::Job>> jobs;
+    for(auto jobQueue = this->makeJobs(mode); !jobQueue.empty(); jobQueue.pop())
+        jobs.push_back(jobQueue.front());
+
+    // Longest roots of their previous evaluation first, new roots, whose length is unknown, before them
+    std::vector<std::pair<uint64_t, size_t>> order;
+    for(size_t i = 0; i < jobs.size(); i++){
+        auto length = this->rootLengths.find(jobs[i]->getRoot());
+        order.emplace_back(length != this->rootLengths.end() ? length->second : std::numeric_limits<uint64_t>::max(),
+                           i);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const std::pair<uint64_t, size_t>& a,
+                                                    const std::pair<uint64_t, size_t>& b){
+        return a.first > b.first;
+    });
+
+    const size_t nbThreads = std::max<size_t>(1, std::min(this->maxNbThreads, jobs.size()));
+    std::vector<JobDeque> deques(nbThreads);
+    for(size_t j = 0; j < order.size(); j++)
+        deques[j % nbThreads].jobs.push_back(order[j].second);
+
+    std::vector<std::shared_ptr<Learn::EvaluationResult>> results(jobs.size());
+    std::vector<uint64_t> lengths(jobs.size());
+    std::vector<Archive*> archives(jobs.size(), nullptr);
+    std::vector<std::chrono::steady_clock::time_point> threadEnds(nbThreads);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // The calling thread plays on the main environment, as in ParallelLearningAgent, other threads on clones
+    auto evaluateJobs = [&](size_t thread){
+        Learn::LearningEnvironment* le = (thread == 0) ? &this->learningEnvironment : this->learningEnvironment.clone();
+        Environment privateEnv(this->env.getInstructionSet(), le->getDataSources(), this->env.getNbRegisters(),
+                               this->env.getNbConstant());
+        TPG::TPGExecutionEngine tee(privateEnv, nullptr);
+
+        size_t i;
+        while(takeJob(deques, thread, i)){
+            // Dedicated archive for the job, merged in job order afterwards
+            if(mode == Learn::LearningMode::TRAINING){
+                archives[i] = new Archive(this->params.archiveSize, this->params.archivingProbability);
+                archives[i]->setRandomSeed(jobs[i]->getArchiveSeed());
+            }
+            tee.setArchive(archives[i]);
+
+            uint64_t firstFrame = nbThreadFrames;
+            results[i] = this->evaluateJob(tee, *jobs[i], generationNumber, mode, *le);
+            lengths[i] = nbThreadFrames - firstFrame;
+        }
+
+        threadEnds[thread] = std::chrono::steady_clock::now();
+        if(thread != 0)
+            delete le;
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t t = 1; t < nbThreads; t++){
+        threads.emplace_back(evaluateJobs, t);
+#ifdef __linux__
+        if(this->pinThreads){
+            const unsigned int nbCores = std::max(1u, std::thread::hardware_concurrency());
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET(t % nbCores, &cores);
+            pthread_setaffinity_np(threads.back().native_handle(), sizeof(cores), &cores);
+        }
+#endif
+    }
+    evaluateJobs(0);
+    for(std::thread& thread : threads)
+        thread.join();
+
+    // Idle tail : time spent by the threads waiting for the last one
+    auto firstEnd = *std::min_element(threadEnds.begin(), threadEnds.end());
+    auto lastEnd = *std::max_element(threadEnds.begin(), threadEnds.end());
+    this->idleTail += std::chrono::duration<double>(lastEnd - firstEnd).count();
+    for(auto threadEnd : threadEnds)
+        this->idleThreadTime += std::chrono::duration<double>(lastEnd - threadEnd).count();
+    this->evaluationThreadTime += nbThreads * std::chrono::duration<double>(lastEnd - start).count();
+
+    std::multimap<std::shared_ptr<Learn::EvaluationResult>, const TPG::TPGVertex*> evaluatedRoots;
+    std::map<uint64_t, Archive*> archiveMap;
+    for(size_t i = 0; i < jobs.size(); i++){
+        evaluatedRoots.emplace(results[i], jobs[i]->getRoot());
+        if(archives[i] != nullptr)
+            archiveMap.emplace(jobs[i]->getIdx(), archives[i]);
+    }
+    this->mergeArchiveMap(archiveMap);
+
+    // Lengths of the roots of the graph, for the next generation
+    if(mode == Learn::LearningMode::TRAINING){
+        this->rootLengths.clear();
+        for(size_t i = 0; i < jobs.size(); i++)
+            this->rootLengths[jobs[i]->getRoot()] = lengths[i];
+    }
+
+    return evaluatedRoots;
+}
+
+void TetrisLearningAgent::trainOneGeneration(uint64_t generationNumber) {
+    if(this->reseedEachGeneration)
+        reseed(generationNumber);
+
+    {
+        std::lock_guard<std::mutex> lock(this->racingMutex);
+        this->rungs.assign(this->params.nbIterationsPerPolicyEvaluation, std::vector<double>());
+    }
+    this->nbPlayedEpisodes = 0;
+    this->nbPlayedFrames = 0;
+    this->nbRacedEpisodes = 0;
+    this->idleTail = 0;
+    this->idleThreadTime = 0;
+    this->evaluationThreadTime = 0;
+
+    Learn::ParallelLearningAgent::trainOneGeneration(generationNumber);
+
+    // Roots removed by the decimation are deleted, and the roots of the next generation may reuse their addresses
+    std::unordered_map<const TPG::TPGVertex*, uint64_t> survivorLengths;
+    for(const TPG::TPGVertex* root : this->tpg->getRootVertices()){
+        auto length = this->rootLengths.find(root);
+        if(length != this->rootLengths.end())
+            survivorLengths.emplace(*length);
+    }
+    this->rootLengths.swap(survivorLengths);
+}
+
+bool TetrisLearningAgent::keepRacing(uint64_t nbEpisodes, double meanScore) const {
+    std::lock_guard<std::mutex> lock(this->racingMutex);
+
+    if(nbEpisodes >= this->rungs.size())
+        return true;
+
+    std::vector<double>& rung = this->rungs[nbEpisodes];
+
+    // Rank of the root among the roots that played as many episodes, from the best one
+    auto position = std::lower_bound(rung.begin(), rung.end(), meanScore, std::greater<double>());
+    const size_t rank = position - rung.begin();
+    rung.insert(position, meanScore);
+
+    return rung.size() < RACING_MIN_RUNG_SIZE || rank < this->racingKeepRatio * rung.size();
+}
+
+std::shared_ptr<Learn::EvaluationResult> TetrisLearningAgent::evaluateJob(TPG::TPGExecutionEngine& tee,
+                                                                          const Learn::Job& job,
+                                                                          uint64_t generationNumber,
+                                                                          Learn::LearningMode mode,
+                                                                          Learn::LearningEnvironment& le) const {
+    auto tetrisLE = dynamic_cast<Tetris<>*>(&le);
+    if(tetrisLE == nullptr)
+        return Learn::ParallelLearningAgent::evaluateJob(tee, job, generationNumber, mode, le);
+
+    ProfileScope rootScope(ProfilePhase::ROOT_EVALUATION);
+
+    // Only consider the first root of jobs as we are not in adversarial mode
+    const TPG::TPGVertex* root = job.getRoot();
+
+    // Skip the root evaluation process if enough evaluations were already performed, in training mode only
+    std::shared_ptr<Learn::EvaluationResult> previousEval;
+    if(mode == Learn::LearningMode::TRAINING && this->isRootEvalSkipped(*root, previousEval))
+        return previousEval;
+
+    if(this->lockstepEpisodes && mode != Learn::LearningMode::TRAINING)
+        return evaluateInLockstep(*root, generationNumber, mode, *tetrisLE);
+
+    double result = 0.0;
+    uint64_t nbInferences = 0;
+    uint64_t nbSkippedInferences = 0;
+
+    const bool racing = this->racing && mode == Learn::LearningMode::TRAINING;
+    uint64_t nbEpisodes = 0;
+
+    // Fills the archive of tee, if any, the recordings of skipped executions being replayed
+    Environment leEnv(this->env.getInstructionSet(), tetrisLE->getDataSources(), this->env.getNbRegisters(),
+                      this->env.getNbConstant());
+    ReplayExecutionEngine engine(leEnv, tee);
+
+    for(uint64_t i = 0; i < this->params.nbIterationsPerPolicyEvaluation; i++){
+        // Racing : stop here if the played episodes rank low
+        if(racing && i > 0 && !keepRacing(i, result / (double)i)){
+            this->nbRacedEpisodes += this->params.nbIterationsPerPolicyEvaluation - i;
+            break;
+        }
+
+        ProfileScope episodeScope(ProfilePhase::EPISODE);
+
+        // Same seeds as Learn::LearningAgent::evaluateJob
+        Data::Hash<uint64_t> hasher;
+        uint64_t hash = hasher(generationNumber) ^ hasher(i);
+
+        tetrisLE->reset(hash, mode);
+
+        uint64_t actionID = 0;
+        uint64_t observationVersion = tetrisLE->getObservationVersion();
+        bool hasAction = false;
+
+        uint64_t nbActions = 0;
+        uint64_t nbEpisodeInferences = 0;
+        for(; !tetrisLE->isTerminal() && nbActions < this->params.maxNbActionsPerEval; nbActions++){
+            // The TPG is deterministic, its action only changes with the observation
+            if(!hasAction || tetrisLE->getObservationVersion() != observationVersion){
+                ProfileScope inferenceScope(ProfilePhase::INFERENCE);
+                observationVersion = tetrisLE->getObservationVersion();
+                actionID = engine.execute(*root);
+                hasAction = true;
+                nbEpisodeInferences++;
+            }
+            else {
+                engine.replayLastExecution();
+                nbSkippedInferences++;
+            }
+
+            ProfileScope actionScope(ProfilePhase::DO_ACTION);
+            tetrisLE->doAction(actionID);
+        }
+        nbInferences += nbEpisodeInferences;
+
+        result += tetrisLE->getScore();
+        nbEpisodes++;
+        nbThreadFrames += nbActions;
+
+        // The game counters are read from the final state, the environment is not instrumented
+        if(Profiler::isEnabled()){
+            TetrisState<Tetris<>::WIDTH, Tetris<>::HEIGHT> state = tetrisLE->saveState();
+            Profiler::count(ProfileCounter::EPISODES, 1);
+            Profiler::count(ProfileCounter::FRAMES, nbActions);
+            Profiler::count(ProfileCounter::DECISIONS, nbEpisodeInferences);
+            Profiler::count(ProfileCounter::LOCKS, state.nbPlayedTetrominos);
+            Profiler::count(ProfileCounter::LINE_CLEARS, state.gameScore);
+            Profiler::count(ProfileCounter::FORBIDDEN_MOVES, state.nbForbiddenMoves);
+        }
+
+        if(racing){
+            this->nbPlayedEpisodes++;
+            this->nbPlayedFrames += nbActions;
+        }
+    }
+
+    this->nbInferences += nbInferences;
+    this->nbSkippedInferences += nbSkippedInferences;
+
+    auto evaluationResult = std::make_shared<Learn::EvaluationResult>(result / (double)nbEpisodes, nbEpisodes);
+
+    // Combine it with previous one if any
+    if(previousEval != nullptr)
+        *evaluationResult += *previousEval;
+
+    return evaluationResult;
+}
+
+std::shared_ptr<Learn::EvaluationResult> TetrisLearningAgent::evaluateInLockstep(const TPG::TPGVertex& root,
+                                                                                 uint64_t generationNumber,
+                                                                                 Learn::LearningMode mode,
+                                                                                 Tetris<>& le) const {
+    const uint64_t nbEpisodes = this->params.nbIterationsPerPolicyEvaluation;
+
+    // The first episode is played on the environment, the others on environments of the pool of the thread, reset
+    // below. Nothing is archived, so the ids of their data sources don't matter.
+    std::vector<TetrisPool<>::Handle> copies;
+    std::vector<Tetris<>*> games = {&le};
+    std::vector<std::vector<std::reference_wrapper<const Data::DataHandler>>> dataSources = {le.getDataSources()};
+    for(uint64_t i = 1; i < nbEpisodes; i++){
+        copies.push_back(TetrisPool<>::acquire(le.getActionMode(), le.getRandomizer(), le.getObservation()));
+        games.push_back(copies.back().get());
+        dataSources.push_back(games.back()->getDataSources());
+    }
+    BatchExecutionEngine engine(this->env, this->batchSet, dataSources);
+
+    // Same seeds as Learn::LearningAgent::evaluateJob
+    Data::Hash<uint64_t> hasher;
+    for(uint64_t i = 0; i < nbEpisodes; i++)
+        games[i]->reset(hasher(generationNumber) ^ hasher(i), mode);
+
+    std::vector<uint64_t> actionIDs(nbEpisodes, 0);
+    std::vector<uint64_t> observationVersions(nbEpisodes, 0);
+    std::vector<uint64_t> nbActions(nbEpisodes, 0);
+    std::vector<uint64_t> nbEpisodeInferences(nbEpisodes, 0);
+    uint64_t nbSkippedInferences = 0;
+
+    std::vector<size_t> playing;
+    std::vector<size_t> lanes;
+    for(uint64_t frame = 0; ; frame++){
+        // The TPG is only executed for the games whose observation changed
+        playing.clear();
+        lanes.clear();
+        for(size_t i = 0; i < nbEpisodes; i++){
+            if(games[i]->isTerminal() || frame >= this->params.maxNbActionsPerEval)
+                continue;
+
+            playing.push_back(i);
+            if(frame == 0 || games[i]->getObservationVersion() != observationVersions[i]){
+                observationVersions[i] = games[i]->getObservationVersion();
+                lanes.push_back(i);
+                nbEpisodeInferences[i]++;
+            }
+            else
+                nbSkippedInferences++;
+        }
+        if(playing.empty())
+            break;
+
+        if(!lanes.empty()){
+            ProfileScope inferenceScope(ProfilePhase::INFERENCE);
+            engine.executeFromRoot(root, lanes, actionIDs);
+        }
+
+        ProfileScope actionScope(ProfilePhase::DO_ACTION);
+        for(size_t i : playing){
+            games[i]->doAction(actionIDs[i]);
+            nbActions[i]++;
+        }
+    }
+
+    // Scores are summed in episode order, as in evaluateJob
+    double result = 0.0;
+    uint64_t nbInferences = 0;
+    for(uint64_t i = 0; i < nbEpisodes; i++){
+        result += games[i]->getScore();
+        nbInferences += nbEpisodeInferences[i];
+        nbThreadFrames += nbActions[i];
+
+        if(Profiler::isEnabled()){
+            TetrisState<Tetris<>::WIDTH, Tetris<>::HEIGHT> state = games[i]->saveState();
+            Profiler::count(ProfileCounter::EPISODES, 1);
+            Profiler::count(ProfileCounter::FRAMES, nbActions[i]);
+            Profiler::count(ProfileCounter::DECISIONS, nbEpisodeInferences[i]);
+            Profiler::count(ProfileCounter::LOCKS, state.nbPlayedTetrominos);
+            Profiler::count(ProfileCounter::LINE_CLEARS, state.gameScore);
+            Profiler::count(ProfileCounter::FORBIDDEN_MOVES, state.nbForbiddenMoves);
+        }
+    }
+
+    this->nbInferences += nbInferences;
+    this->nbSkippedInferences += nbSkippedInferences;
+
+    return std::make_shared<Learn::EvaluationResult>(result / (double)nbEpisodes, nbEpisodes);
+}
+
+uint64_t TetrisLearningAgent::getNbInferences() const {
+    return this->nbInferences;
+}
+
+uint64_t TetrisLearningAgent::getNbSkippedInferences() const {
+    return this->nbSkippedInferences;
+}
+
+void TetrisLearningAgent::resetInferenceCounters() {
+    this->nbInferences = 0;
+    this->nbSkippedInferences = 0;
+}
+
+uint64_t TetrisLearningAgent::getNbRacedEpisodes() const {
+    return this->nbRacedEpisodes;
+}
+
+double TetrisLearningAgent::getIdleTail() const {
+    return this->idleTail;
+}
+
+double TetrisLearningAgent::getIdleRatio() const {
+    if(this->evaluationThreadTime == 0)
+        return 0;
+
+    return this->idleThreadTime / this->evaluationThreadTime;
+}
+
+uint64_t TetrisLearningAgent::getNbSavedFrames() const {
+    if(this->nbPlayedEpisodes == 0)
+        return 0;
+
+    return this->nbRacedEpisodes * this->nbPlayedFrames / this->nbPlayedEpisodes;
+}
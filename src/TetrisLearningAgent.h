@@ -0,0 +1,223 @@
+#ifndef GEGELATI_TETRIS_TETRISLEARNINGAGENT_H
+#define GEGELATI_TETRIS_TETRISLEARNINGAGENT_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <gegelati.h>
+
+#include "BatchExecutionEngine.h"
+#include "Tetris.h"
+#include "TetrisParameters.h"
+#include "WorkerPool.h"
+
+/**
+ * \brief Parallel learning agent specialized for the Tetris learning environment.
+ *
+ * Root evaluation is the same as the one of Learn::LearningAgent, except that the TPG is only executed when the
+ * observation of the Tetris environment changed (see Tetris::getObservationVersion). On other frames, the previous
+ * action is played again, which is what the deterministic TPG would have chosen, and the archive recordings of the
+ * previous execution are replayed (see ReplayExecutionEngine), so that the archive gets the same recordings as if
+ * the TPG had been executed.
+ *
+ * When racing is enabled, training evaluations are raced in a successive halving fashion : after each episode, the
+ * mean score of the root is compared with those of the roots of the generation that already reached the same
+ * episode, and the remaining episodes are skipped if the root is not among the best ones.
+ *
+ * With work stealing, roots are evaluated by threads taking their jobs from their own deque, then from the deques of
+ * other threads. Jobs are sorted by the number of frames played by their root during its previous evaluation, longest
+ * first, and dealt in turn to the threads : long evaluations start early instead of delaying the end of the
+ * generation. Results and archive recordings are merged in job order, as in ParallelLearningAgent.
+ *
+ * With lockstep episodes, the episodes of validation and test evaluations are played together, their TPG executions
+ * being made by a BatchExecutionEngine. Training evaluations are played one episode at a time, so that the archive
+ * is filled in the same order.
+ *
+ * When a WorkerPool is set, roots are evaluated by its worker processes instead of threads. Workers don't fill the
+ * archive of the agent, only the roots left to the training process do, and racing is not applied to their
+ * evaluations.
+ */
+class TetrisLearningAgent : public Learn::ParallelLearningAgent {
+private:
+
+    /// Number of TPG executions done during evaluations
+    mutable std::atomic<uint64_t> nbInferences;
+
+    /// Number of TPG executions avoided during evaluations
+    mutable std::atomic<uint64_t> nbSkippedInferences;
+
+    /// Minimum number of roots reaching an episode before roots are stopped at this episode
+    static const size_t RACING_MIN_RUNG_SIZE;
+
+    /// Is racing enabled
+    const bool racing;
+
+    /// Fraction of the roots continuing their evaluation after each episode
+    const double racingKeepRatio;
+
+    /// Protects rungs
+    mutable std::mutex racingMutex;
+
+    /// Mean scores of the roots of the current generation, sorted in decreasing order, after each episode
+    mutable std::vector<std::vector<double>> rungs;
+
+    /// Number of episodes played and frames played during these episodes in the current generation
+    mutable std::atomic<uint64_t> nbPlayedEpisodes;
+    mutable std::atomic<uint64_t> nbPlayedFrames;
+
+    /// Number of episodes skipped by racing in the current generation
+    mutable std::atomic<uint64_t> nbRacedEpisodes;
+
+    /// Seed from which the random number generator is seeded, at the beginning of each generation or on resume
+    uint64_t seed;
+
+    /// Is the random number generator seeded at the beginning of each generation
+    const bool reseedEachGeneration;
+
+    /// Workers evaluating the roots, nullptr to evaluate them with threads
+    WorkerPool* workerPool;
+
+    /// Are roots evaluated with work stealing, and are the evaluation threads pinned to cores
+    const bool workStealing;
+    const bool pinThreads;
+
+    /// Are the episodes of validation and test evaluations played in lockstep
+    bool lockstepEpisodes;
+
+    /// Batch instructions of the lockstep episodes, matching the instruction set
+    BatchInstructionSet batchSet;
+
+    /// Number of frames played by each root during its last training evaluation, for the roots still in the graph
+    std::unordered_map<const TPG::TPGVertex*, uint64_t> rootLengths;
+
+    /// Time the first thread done waited for the last one, and total waiting time of the threads, in seconds, during
+    /// the evaluations of the current generation
+    double idleTail;
+    double idleThreadTime;
+
+    /// Total time of the threads during the evaluations of the current generation, in seconds
+    double evaluationThreadTime;
+
+    /// Jobs of a thread, as indexes in the jobs of the evaluation
+    struct JobDeque {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    /**
+     * \brief Takes the next job of a thread, from its own deque or from the fullest deque of the other threads.
+     *
+     * \param deques the deques of all threads.
+     * \param thread the index of the thread.
+     * \param job set to the index of the job.
+     * \return false if all deques are empty.
+     */
+    static bool takeJob(std::vector<JobDeque>& deques, size_t thread, size_t& job);
+
+    /// Evaluates all roots with work stealing between threads.
+    std::multimap<std::shared_ptr<Learn::EvaluationResult>, const TPG::TPGVertex*>
+    evaluateAllRootsWithStealing(uint64_t generationNumber, Learn::LearningMode mode);
+
+    /**
+     * \brief Records the mean score of a root after some episodes, and tells whether its evaluation continues.
+     *
+     * \param nbEpisodes number of episodes played by the root.
+     * \param meanScore mean score of these episodes.
+     * \return true if the root ranks among the racingKeepRatio best roots having played as many episodes.
+     */
+    bool keepRacing(uint64_t nbEpisodes, double meanScore) const;
+
+    /**
+     * \brief Evaluates a root with its episodes played in lockstep, on the environment and copies of it.
+     *
+     * Episodes have the same seeds as in evaluateJob, and the same actions and scores.
+     */
+    std::shared_ptr<Learn::EvaluationResult> evaluateInLockstep(const TPG::TPGVertex& root, uint64_t generationNumber,
+                                                                Learn::LearningMode mode, Tetris<>& le) const;
+
+public:
+
+    /**
+     * \brief Constructor, with the same parameters as Learn::ParallelLearningAgent.
+     *
+     * \param tetrisParams Tetris specific parameters, for racing, work stealing and lockstep episodes.
+     */
+    TetrisLearningAgent(Tetris<>& le, const Instructions::Set& iSet, const Learn::LearningParameters& p,
+                        const TetrisParameters& tetrisParams = TetrisParameters(),
+                        const TPG::TPGFactory& factory = TPG::TPGFactory());
+
+    /// Inherited via LearningAgent, also keeps the seed for the next generations.
+    void init(uint64_t seed = 0);
+
+    /// Seed from which the random number generator is seeded, at the beginning of each generation or on resume.
+    uint64_t getSeed() const;
+
+    /// Sets the seed from which the random number generator is seeded, at the beginning of each generation or on
+    /// resume.
+    void setSeed(uint64_t seed);
+
+    /**
+     * \brief Seeds the random number generator from the seed and a generation number.
+     *
+     * gegelati doesn't expose the state of the random number generator, so a training resumed from a checkpoint
+     * reseeds it before its first generation. With reseedEachGeneration (see TetrisParameters), every generation
+     * starts this way and the resumed training draws the same numbers as the original one.
+     */
+    void reseed(uint64_t generationNumber);
+
+    /**
+     * \brief Inherited via LearningAgent, also starts a new racing.
+     *
+     * The random number generator is first reseeded if reseedEachGeneration is set. Otherwise, it continues the
+     * sequence seeded by init(), as in Learn::ParallelLearningAgent.
+     */
+    virtual void trainOneGeneration(uint64_t generationNumber) override;
+
+    /// Evaluates roots with the workers of workerPool, or with threads if it is nullptr.
+    void setWorkerPool(WorkerPool* workerPool);
+
+    /**
+     * \brief Inherited via ParallelLearningAgent, evaluates the roots with the worker pool if one is set, or with
+     * work stealing between threads if enabled.
+     *
+     * Jobs are made as in ParallelLearningAgent, so that the same random numbers are drawn. Roots that are not
+     * evaluated by workers are evaluated by the calling thread.
+     */
+    virtual std::multimap<std::shared_ptr<Learn::EvaluationResult>, const TPG::TPGVertex*>
+    evaluateAllRoots(uint64_t generationNumber, Learn::LearningMode mode) override;
+
+    /// Inherited via LearningAgent, evaluates a root on a Tetris environment.
+    virtual std::shared_ptr<Learn::EvaluationResult> evaluateJob(TPG::TPGExecutionEngine& tee, const Learn::Job& job,
+                                                                 uint64_t generationNumber, Learn::LearningMode mode,
+                                                                 Learn::LearningEnvironment& le) const override;
+
+    /// Number of TPG executions done since the last reset of the counters.
+    uint64_t getNbInferences() const;
+
+    /// Number of TPG executions avoided since the last reset of the counters.
+    uint64_t getNbSkippedInferences() const;
+
+    /// Resets the inference counters.
+    void resetInferenceCounters();
+
+    /// Number of episodes skipped by racing during the last generation.
+    uint64_t getNbRacedEpisodes() const;
+
+    /// Time, in seconds, during which the first thread done with the evaluations of the last generation waited for the
+    /// last one, when work stealing.
+    double getIdleTail() const;
+
+    /// Fraction of the time of the threads spent waiting for the last one during the evaluations of the last
+    /// generation, when work stealing.
+    double getIdleRatio() const;
+
+    /// Estimation of the number of frames saved by racing during the last generation, from the mean
+    /// length of the played episodes.
+    uint64_t getNbSavedFrames() const;
+};
+
+
+#endif //GEGELATI_TETRIS_TETRISLEARNINGAGENT_H
@@ -0,0 +1,82 @@
+#include <iostream>
+
+#include <gegelati.h>
+
+#include "TetrisParameters.h"
+
+void loadTetrisParametersFromJson(const char* path, TetrisParameters& params) {
+    Json::Value root;
+    File::ParametersParser::readConfigFile(path, root);
+
+    if(root.isMember("actionMode")){
+        const std::string mode = root["actionMode"].asString();
+        if(mode == "frame")
+            params.actionMode = TetrisActionMode::FRAME;
+        else if(mode == "placement")
+            params.actionMode = TetrisActionMode::PLACEMENT;
+        else
+            std::cerr << "Unknown action mode \"" << mode << "\", keeping the current one." << std::endl;
+    }
+
+    if(root.isMember("randomizer")){
+        const std::string randomizer = root["randomizer"].asString();
+        if(randomizer == "uniform")
+            params.randomizer = TetrominoRandomizer::UNIFORM;
+        else if(randomizer == "bag")
+            params.randomizer = TetrominoRandomizer::BAG;
+        else
+            std::cerr << "Unknown randomizer \"" << randomizer << "\", keeping the current one." << std::endl;
+    }
+
+    if(root.isMember("observation")){
+        const std::string observation = root["observation"].asString();
+        if(observation == "colours")
+            params.observation = TetrisObservation::COLOURS;
+        else if(observation == "occupancy")
+            params.observation = TetrisObservation::OCCUPANCY;
+        else
+            std::cerr << "Unknown observation \"" << observation << "\", keeping the current one." << std::endl;
+    }
+
+    if(root.isMember("racing"))
+        params.racing = root["racing"].asBool();
+
+    if(root.isMember("racingKeepRatio"))
+        params.racingKeepRatio = root["racingKeepRatio"].asDouble();
+
+    if(root.isMember("workStealing"))
+        params.workStealing = root["workStealing"].asBool();
+
+    if(root.isMember("pinThreads"))
+        params.pinThreads = root["pinThreads"].asBool();
+
+    if(root.isMember("workerTimeout"))
+        params.workerTimeout = root["workerTimeout"].asUInt64();
+
+    if(root.isMember("lockstepEpisodes"))
+        params.lockstepEpisodes = root["lockstepEpisodes"].asBool();
+
+    if(root.isMember("recordEpisodes"))
+        params.recordEpisodes = root["recordEpisodes"].asBool();
+
+    if(root.isMember("dotExportInterval"))
+        params.dotExportInterval = root["dotExportInterval"].asUInt64();
+
+    if(root.isMember("dotExportOnImprovement"))
+        params.dotExportOnImprovement = root["dotExportOnImprovement"].asBool();
+
+    if(root.isMember("dotExportQueueSize"))
+        params.dotExportQueueSize = root["dotExportQueueSize"].asUInt64();
+
+    if(root.isMember("checkpointInterval"))
+        params.checkpointInterval = root["checkpointInterval"].asUInt64();
+
+    if(root.isMember("reseedEachGeneration"))
+        params.reseedEachGeneration = root["reseedEachGeneration"].asBool();
+
+    if(root.isMember("profile"))
+        params.profile = root["profile"].asBool();
+
+    if(root.isMember("profileTrace"))
+        params.profileTrace = root["profileTrace"].asBool();
+}
@@ -0,0 +1,77 @@
+#ifndef GEGELATI_TETRIS_TETRISPARAMETERS_H
+#define GEGELATI_TETRIS_TETRISPARAMETERS_H
+
+#include "Tetris.h"
+
+/**
+ * \brief Parameters of the Tetris environment and of its evaluation.
+ *
+ * These parameters are not known by gegelati, they are loaded from their own json file
+ * (see tetrisParams.json) next to the learning parameters of params.json.
+ */
+struct TetrisParameters {
+    /// Meaning of the actions of the environment, "frame" or "placement" in the json file
+    TetrisActionMode actionMode = TetrisActionMode::FRAME;
+
+    /// Way of drawing the tetrominos, "uniform" or "bag" in the json file
+    TetrominoRandomizer randomizer = TetrominoRandomizer::UNIFORM;
+
+    /// Data sources observed by the TPG, and matching instruction set, "colours" or "occupancy" in the json file
+    TetrisObservation observation = TetrisObservation::COLOURS;
+
+    /// Stop evaluating roots whose first episodes rank low compared to other roots of the generation
+    bool racing = false;
+
+    /// Fraction of the roots continuing their evaluation after each episode, when racing
+    double racingKeepRatio = 0.5;
+
+    /// Evaluate roots with work stealing between threads, longest roots of the previous generation first
+    bool workStealing = true;
+
+    /// Pin each evaluation thread to a core, when work stealing
+    bool pinThreads = false;
+
+    /// Number of seconds a worker process may take to evaluate a root before it is dropped, 0 for no limit
+    uint64_t workerTimeout = 600;
+
+    /// Play the episodes of validation and test evaluations of a root in lockstep, with a BatchExecutionEngine
+    bool lockstepEpisodes = false;
+
+    /// Save the game played by the best root of each generation in an episode file
+    bool recordEpisodes = true;
+
+    /// Number of generations between two dot exports of the graph, 0 for no export
+    uint64_t dotExportInterval = 1;
+
+    /// Only export the graph when the best root score improved since the last export
+    bool dotExportOnImprovement = false;
+
+    /// Maximum number of graph copies waiting to be exported before training waits for the export thread
+    uint64_t dotExportQueueSize = 4;
+
+    /// Number of generations between two checkpoints, 0 for no checkpoint
+    uint64_t checkpointInterval = 10;
+
+    /// Seed the random number generator of the learning agent at the beginning of each generation, so that a
+    /// training resumed from a checkpoint draws the same random numbers
+    bool reseedEachGeneration = false;
+
+    /// Write the time spent in each phase of the training and the game counters of each generation in profile.csv
+    bool profile = false;
+
+    /// Also write the phases of each thread in the profile_trace.json Chrome trace, when profiling
+    bool profileTrace = false;
+};
+
+/**
+ * \brief Loads Tetris parameters from a json file.
+ *
+ * Parameters missing from the file keep their current value.
+ *
+ * \param path path of the json file.
+ * \param params the parameters to fill.
+ */
+void loadTetrisParametersFromJson(const char* path, TetrisParameters& params);
+
+
+#endif //GEGELATI_TETRIS_TETRISPARAMETERS_H
@@ -0,0 +1,99 @@
+#include <new>
+
+#include "TetrisPool.h"
+
+template <int W, int H>
+TetrisPool<W, H>::ThreadPool::ThreadPool(bool& destroyed) : destroyed(destroyed) {}
+
+template <int W, int H>
+TetrisPool<W, H>::ThreadPool::~ThreadPool() {
+    // Environments deleted from now on release their memory directly
+    this->destroyed = true;
+
+    for(auto& modeEnvironments : this->environments){
+        for(auto& randomizerEnvironments : modeEnvironments){
+            for(auto& environments : randomizerEnvironments){
+                for(auto le : environments)
+                    delete le;
+            }
+        }
+    }
+
+    for(auto block : this->freeBlocks)
+        ::operator delete(block);
+}
+
+template <int W, int H>
+typename TetrisPool<W, H>::ThreadPool* TetrisPool<W, H>::getThreadPool() {
+    // The flag is trivially destructible, so it can still be read while the thread destroys its pool
+    static thread_local bool destroyed = false;
+    static thread_local ThreadPool pool(destroyed);
+
+    return destroyed ? nullptr : &pool;
+}
+
+template <int W, int H>
+typename TetrisPool<W, H>::Handle TetrisPool<W, H>::acquire(TetrisActionMode actionMode, TetrominoRandomizer randomizer,
+                                                             TetrisObservation observation) {
+    ThreadPool* pool = getThreadPool();
+    if(pool == nullptr)
+        return Handle(new Tetris<W, H>(actionMode, randomizer, observation));
+
+    auto& environments = pool->environments[(int)actionMode][(int)randomizer][(int)observation];
+    if(environments.empty())
+        return Handle(new Tetris<W, H>(actionMode, randomizer, observation));
+
+    Tetris<W, H>* le = environments.back();
+    environments.pop_back();
+    return Handle(le);
+}
+
+template <int W, int H>
+typename TetrisPool<W, H>::Handle TetrisPool<W, H>::acquire(const Tetris<W, H>& model) {
+    Handle le = acquire(model.getActionMode(), model.getRandomizer(), model.getObservation());
+    le->restoreState(model.saveState());
+    return le;
+}
+
+template <int W, int H>
+void TetrisPool<W, H>::Release::operator()(Tetris<W, H>* le) const {
+    ThreadPool* pool = getThreadPool();
+
+    if(pool != nullptr){
+        auto& environments = pool->environments[(int)le->getActionMode()][(int)le->getRandomizer()]
+                                                [(int)le->getObservation()];
+        if(environments.size() < MAX_POOL_SIZE){
+            environments.push_back(le);
+            return;
+        }
+    }
+
+    delete le;
+}
+
+template <int W, int H>
+void* TetrisPool<W, H>::allocate(size_t size) {
+    ThreadPool* pool = getThreadPool();
+
+    if(pool != nullptr && size == sizeof(Tetris<W, H>) && !pool->freeBlocks.empty()){
+        void* block = pool->freeBlocks.back();
+        pool->freeBlocks.pop_back();
+        return block;
+    }
+
+    return ::operator new(size);
+}
+
+template <int W, int H>
+void TetrisPool<W, H>::deallocate(void* ptr, size_t size) {
+    ThreadPool* pool = getThreadPool();
+
+    if(pool != nullptr && size == sizeof(Tetris<W, H>) && pool->freeBlocks.size() < MAX_POOL_SIZE){
+        pool->freeBlocks.push_back(ptr);
+        return;
+    }
+
+    ::operator delete(ptr);
+}
+
+TETRIS_INSTANTIATE(TetrisPool)
@@ -0,0 +1,85 @@
+#ifndef GEGELATI_TETRIS_TETRISPOOL_H
+#define GEGELATI_TETRIS_TETRISPOOL_H
+
+#include <memory>
+#include <vector>
+
+#include "Tetris.h"
+
+/**
+ * \brief Per thread pool of Tetris environments.
+ *
+ * The pool keeps, for each thread :
+ * - the memory of deleted Tetris environments, reused by the next allocations (for instance by Tetris::clone()).
+ * - idle Tetris environments, with their data sources already built, handed out by acquire().
+ *
+ * Environments handed out by acquire() have data sources of their own, with new ids : they replace copies of
+ * environments whose data sources are not archived, for instance the games played in lockstep.
+ *
+ * Nothing is shared between threads, so no synchronization is needed.
+ *
+ * \tparam W width of the grid.
+ * \tparam H height of the grid.
+ */
+template <int W = TETRIS_WIDTH, int H = TETRIS_HEIGHT>
+class TetrisPool {
+public:
+
+    /// Gives an environment back to the pool of the calling thread.
+    struct Release {
+        void operator()(Tetris<W, H>* le) const;
+    };
+
+    /// Environment borrowed from the pool, given back when destroyed
+    using Handle = std::unique_ptr<Tetris<W, H>, Release>;
+
+    /// Maximum number of memory blocks and of idle environments kept by each thread
+    static constexpr size_t MAX_POOL_SIZE = 64;
+
+    /**
+     * \brief Borrows an environment from the pool of the calling thread.
+     *
+     * The environment is in an unspecified state, it must be reset or restored before use. A new environment is
+     * built when the pool has none, or was already destroyed at thread exit.
+     *
+     * \param actionMode action mode of the environment.
+     * \param randomizer tetromino randomizer of the environment.
+     * \param observation data sources observed in the environment.
+     */
+    static Handle acquire(TetrisActionMode actionMode = TetrisActionMode::FRAME,
+                          TetrominoRandomizer randomizer = TetrominoRandomizer::UNIFORM,
+                          TetrisObservation observation = TetrisObservation::COLOURS);
+
+    /// Borrows an environment from the pool of the calling thread, in the same state as model.
+    static Handle acquire(const Tetris<W, H>& model);
+
+    /// Allocates memory for a Tetris environment.
+    static void* allocate(size_t size);
+
+    /// Frees memory allocated by allocate().
+    static void deallocate(void* ptr, size_t size);
+
+private:
+
+    /// Content of the pool of a thread
+    struct ThreadPool {
+        /// Set when the pool is destroyed at thread exit
+        bool& destroyed;
+
+        /// Memory of deleted environments
+        std::vector<void*> freeBlocks;
+
+        /// Idle environments, for each action mode, randomizer and observation
+        std::vector<Tetris<W, H>*> environments[2][2][2];
+
+        explicit ThreadPool(bool& destroyed);
+
+        ~ThreadPool();
+    };
+
+    /// Pool of the calling thread, nullptr if it was already destroyed.
+    static ThreadPool* getThreadPool();
+};
+
+
+#endif //GEGELATI_TETRIS_TETRISPOOL_H
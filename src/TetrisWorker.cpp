@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Checkpoint.h"
+#include "instructions.h"
+#include "Socket.h"
+#include "TetrisLearningAgent.h"
+#include "TetrisWorker.h"
+#include "TetrominoSequence.h"
+#include "WorkerPool.h"
+
+/// Number of attempts to connect to the training process, one per second
+static const int CONNECTION_ATTEMPTS = 60;
+
+/**
+ * \brief Answers the GRAPH and JOB messages of the training process.
+ *
+ * \throws std::runtime_error if the connection is lost or a message is invalid.
+ */
+static void serveJobs(MessageSocket& socket, TetrisLearningAgent& la, Tetris<>& le) {
+    TPG::TPGGraph& graph = *la.getTPGGraph();
+    TPG::TPGExecutionEngine tee(graph.getEnvironment());
+
+    uint64_t generationNumber = 0;
+    Learn::LearningMode mode = Learn::LearningMode::TRAINING;
+    std::vector<const TPG::TPGVertex*> vertices;
+
+    uint64_t type;
+    std::vector<uint64_t> message;
+    while(socket.receive(type, message)){
+        if(type == (uint64_t)WorkerMessage::GRAPH && message.size() >= 2){
+            generationNumber = message[0];
+            mode = (Learn::LearningMode)message[1];
+            Checkpoint checkpoint;
+            deserializeCheckpoint((const uint8_t*)(message.data() + 2), (message.size() - 2) * sizeof(uint64_t),
+                                  checkpoint, graph);
+            vertices = graph.getVertices();
+
+            // Tetromino sequences of the previous evaluation seeds won't be used anymore
+            TetrominoSequenceCache::clear();
+        }
+        else if(type == (uint64_t)WorkerMessage::JOB && message.size() == 1 && message[0] < vertices.size()){
+            la.resetInferenceCounters();
+            Learn::Job job({vertices[message[0]]});
+            std::shared_ptr<Learn::EvaluationResult> result = la.evaluateJob(tee, job, generationNumber, mode, le);
+
+            std::vector<uint64_t> answer = {message[0], 0, result->getNbEvaluation(), la.getNbInferences(),
+                                            la.getNbSkippedInferences()};
+            double score = result->getResult();
+            memcpy(&answer[1], &score, sizeof(double));
+            socket.send((uint64_t)WorkerMessage::RESULT, answer);
+        }
+        else
+            throw std::runtime_error("Unexpected message from the training process.");
+    }
+}
+
+int runWorker(const std::string& address, Learn::LearningParameters params) {
+    // The training process may not listen yet
+    std::unique_ptr<MessageSocket> socket;
+    for(int attempt = 1; socket == nullptr; attempt++){
+        try {
+            socket = MessageSocket::connect(address);
+        }
+        catch (const std::runtime_error& e) {
+            if(attempt == CONNECTION_ATTEMPTS){
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+
+    uint64_t type;
+    std::vector<uint64_t> hello;
+    try {
+        if(!socket->receive(type, hello) || type != (uint64_t)WorkerMessage::HELLO || hello.size() != 10
+           || hello[0] != WorkerPool::PROTOCOL_VERSION){
+            std::cerr << "Unexpected answer from " << address << ", is it a training process of the same version ?"
+                      << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if(hello[1] != (uint64_t)Tetris<>::WIDTH || hello[2] != (uint64_t)Tetris<>::HEIGHT){
+        std::cerr << "The training process plays on a " << hello[1] << " * " << hello[2] << " grid, this worker on a "
+                  << Tetris<>::WIDTH << " * " << Tetris<>::HEIGHT << " grid." << std::endl;
+        return 1;
+    }
+
+    // The graph is only valid in an environment of the same size
+    if(hello[8] != params.nbRegisters || hello[9] != params.nbProgramConstant){
+        std::cerr << "The training process uses " << hello[8] << " registers and " << hello[9]
+                  << " program constants, this worker " << params.nbRegisters << " and " << params.nbProgramConstant
+                  << ", are they reading the same params.json ?" << std::endl;
+        return 1;
+    }
+
+    // Tetris variant and evaluation length of the training process, roots being evaluated entirely
+    TetrisParameters tetrisParams;
+    tetrisParams.actionMode = (TetrisActionMode)hello[3];
+    tetrisParams.randomizer = (TetrominoRandomizer)hello[4];
+    tetrisParams.observation = (TetrisObservation)hello[5];
+    tetrisParams.racing = false;
+    params.nbIterationsPerPolicyEvaluation = hello[6];
+    params.maxNbActionsPerEval = hello[7];
+
+    Instructions::Set set;
+    fillInstructionSet(set, tetrisParams.observation);
+
+    int exitCode = 0;
+    {
+        Tetris<> le(tetrisParams.actionMode, tetrisParams.randomizer, tetrisParams.observation);
+        TetrisLearningAgent la(le, set, params, tetrisParams);
+
+        try {
+            serveJobs(*socket, la, le);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Worker stopped : " << e.what() << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    // Cleanup instructions
+    for (unsigned int i = 0; i < set.getNbInstructions(); i++) {
+        delete (&set.getInstruction(i));
+    }
+
+    return exitCode;
+}
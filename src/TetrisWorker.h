@@ -0,0 +1,22 @@
+#ifndef GEGELATI_TETRIS_TETRISWORKER_H
+#define GEGELATI_TETRIS_TETRISWORKER_H
+
+#include <string>
+
+#include <gegelati.h>
+
+/**
+ * \brief Evaluates roots for a training process, until it closes the connection (see WorkerPool).
+ *
+ * The worker plays the Tetris variant given by the training process, with the registers and constants of params,
+ * and evaluates roots as TetrisLearningAgent does, without racing.
+ *
+ * \param address address of the training process, connected to for up to CONNECTION_ATTEMPTS seconds.
+ * \param params learning parameters of the training, the number of episodes and frames being those of the training
+ * process.
+ * \return the exit code of the worker : 0 when the training process closed the connection, 1 on error.
+ */
+int runWorker(const std::string& address, Learn::LearningParameters params);
+
+
+#endif //GEGELATI_TETRIS_TETRISWORKER_H
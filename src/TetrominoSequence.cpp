@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <numeric>
+
+#include "TetrominoSequence.h"
+
+TetrominoGenerator::TetrominoGenerator(uint64_t seed, TetrominoRandomizer randomizer) : randomizer(randomizer),
+        bag(), bagIndex(7) {
+    this->rng.setSeed(seed);
+}
+
+int TetrominoGenerator::next() {
+    if(this->randomizer == TetrominoRandomizer::UNIFORM)
+        return this->rng.getInt32(1, 7);
+
+    if(this->bagIndex == 7){
+        // New bag, shuffled with Fisher-Yates
+        std::iota(std::begin(this->bag), std::end(this->bag), 1);
+        for(int i = 6; i > 0; i--)
+            std::swap(this->bag[i], this->bag[this->rng.getInt32(0, i)]);
+        this->bagIndex = 0;
+    }
+
+    return this->bag[this->bagIndex++];
+}
+
+std::mutex TetrominoSequenceCache::mutex;
+
+std::map<std::pair<uint64_t, TetrominoRandomizer>, TetrominoSequenceCache::Entry> TetrominoSequenceCache::sequences;
+
+std::shared_ptr<const TetrominoSequenceCache::Sequence> TetrominoSequenceCache::get(uint64_t seed,
+                                                                                     TetrominoRandomizer randomizer,
+                                                                                     uint64_t part) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Entry& entry = sequences[std::make_pair(seed, randomizer)];
+    if(entry.parts.empty())
+        entry.generator = TetrominoGenerator(seed, randomizer);
+
+    // Parts are generated in order, each one continuing the previous one
+    while(entry.parts.size() <= part){
+        auto newPart = std::make_shared<Sequence>(SEQUENCE_LENGTH);
+        for(auto& type : *newPart)
+            type = (uint8_t)entry.generator.next();
+        entry.parts.push_back(newPart);
+    }
+
+    return entry.parts[part];
+}
+
+void TetrominoSequenceCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    sequences.clear();
+}
+
+TetrominoSource::TetrominoSource() : seed(0), randomizer(TetrominoRandomizer::UNIFORM), part(0), nbGenerated(0) {}
+
+void TetrominoSource::reset(uint64_t seed, TetrominoRandomizer randomizer) {
+    restore(seed, randomizer, 0);
+}
+
+void TetrominoSource::restore(uint64_t seed, TetrominoRandomizer randomizer, uint64_t nbGenerated) {
+    const uint64_t part = nbGenerated / TetrominoSequenceCache::SEQUENCE_LENGTH;
+    if(this->sequence == nullptr || this->seed != seed || this->randomizer != randomizer || this->part != part)
+        this->sequence = TetrominoSequenceCache::get(seed, randomizer, part);
+
+    this->seed = seed;
+    this->randomizer = randomizer;
+    this->part = part;
+    this->nbGenerated = nbGenerated;
+}
+
+int TetrominoSource::next() {
+    const uint64_t index = this->nbGenerated++;
+
+    if(index / TetrominoSequenceCache::SEQUENCE_LENGTH != this->part){
+        this->part = index / TetrominoSequenceCache::SEQUENCE_LENGTH;
+        this->sequence = TetrominoSequenceCache::get(this->seed, this->randomizer, this->part);
+    }
+
+    return (*this->sequence)[index % TetrominoSequenceCache::SEQUENCE_LENGTH];
+}
+
+uint64_t TetrominoSource::getSeed() const {
+    return this->seed;
+}
+
+uint64_t TetrominoSource::getNbGenerated() const {
+    return this->nbGenerated;
+}
@@ -0,0 +1,140 @@
+#ifndef GEGELATI_TETRIS_TETROMINOSEQUENCE_H
+#define GEGELATI_TETRIS_TETROMINOSEQUENCE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <gegelati.h>
+
+/// Way of drawing the sequence of tetrominos of a game
+enum class TetrominoRandomizer {
+    /// Each tetromino type is drawn uniformly
+    UNIFORM,
+    /// The 7 tetromino types are drawn in a random order, then again in a new random order, and so on
+    BAG
+};
+
+/**
+ * \brief Random generator of tetromino types, from 1 to 7.
+ */
+class TetrominoGenerator {
+private:
+
+    /// Randomizer used to draw tetrominos
+    TetrominoRandomizer randomizer;
+
+    /// Randomness control
+    Mutator::RNG rng;
+
+    /// Current bag, for the bag randomizer
+    uint8_t bag[7];
+
+    /// Index of the next tetromino of the bag, 7 when the bag is empty
+    int bagIndex;
+
+public:
+
+    /**
+     * \brief Constructor.
+     *
+     * \param seed seed of the generated sequence.
+     * \param randomizer way of drawing the tetrominos.
+     */
+    TetrominoGenerator(uint64_t seed = 0, TetrominoRandomizer randomizer = TetrominoRandomizer::UNIFORM);
+
+    /// Draws the next tetromino type.
+    int next();
+};
+
+/**
+ * \brief Read-only tetromino sequences shared by all the games using the same seed.
+ *
+ * The sequence of a seed and randomizer is the one drawn by a TetrominoGenerator with the same seed and randomizer.
+ * It is stored in parts of SEQUENCE_LENGTH tetrominos, each part being generated by the first game needing it and
+ * then shared, across threads, with all other games. The generator of the next parts is kept with the sequence.
+ */
+class TetrominoSequenceCache {
+public:
+
+    /// Part of a sequence of tetromino types
+    using Sequence = std::vector<uint8_t>;
+
+    /// Number of tetrominos of each part of a sequence
+    static constexpr size_t SEQUENCE_LENGTH = 1024;
+
+    /**
+     * \brief Gets a part of the sequence of a seed and randomizer, generating it if needed.
+     *
+     * \param seed the seed of the sequence.
+     * \param randomizer the way of drawing the tetrominos.
+     * \param part the index of the part, holding the tetrominos from part * SEQUENCE_LENGTH.
+     */
+    static std::shared_ptr<const Sequence> get(uint64_t seed, TetrominoRandomizer randomizer, uint64_t part = 0);
+
+    /// Forgets all sequences, games already using one keep the part they read.
+    static void clear();
+
+private:
+
+    /// Parts of a sequence generated so far, and generator of the next ones
+    struct Entry {
+        std::vector<std::shared_ptr<const Sequence>> parts;
+        TetrominoGenerator generator;
+    };
+
+    /// Protects sequences
+    static std::mutex mutex;
+
+    /// Cached sequences, by seed and randomizer
+    static std::map<std::pair<uint64_t, TetrominoRandomizer>, Entry> sequences;
+};
+
+/**
+ * \brief Source of the tetrominos of a game.
+ *
+ * Tetrominos are read from the shared sequence of the game seed, one part after the other, so that moving to any
+ * point of the sequence only looks up its part.
+ */
+class TetrominoSource {
+private:
+
+    /// Seed of the game
+    uint64_t seed;
+
+    /// Way of drawing the tetrominos
+    TetrominoRandomizer randomizer;
+
+    /// Part of the shared sequence of the seed holding the next tetromino, and its index
+    std::shared_ptr<const TetrominoSequenceCache::Sequence> sequence;
+    uint64_t part;
+
+    /// Number of tetrominos generated since reset
+    uint64_t nbGenerated;
+
+public:
+
+    /// Constructor, before any reset.
+    TetrominoSource();
+
+    /// Restarts the sequence of tetrominos of a seed.
+    void reset(uint64_t seed, TetrominoRandomizer randomizer);
+
+    /// Moves to a point of the sequence of tetrominos of a seed.
+    void restore(uint64_t seed, TetrominoRandomizer randomizer, uint64_t nbGenerated);
+
+    /// Gets the next tetromino type.
+    int next();
+
+    /// Seed of the current sequence.
+    uint64_t getSeed() const;
+
+    /// Number of tetrominos generated since reset.
+    uint64_t getNbGenerated() const;
+};
+
+
+#endif //GEGELATI_TETRIS_TETROMINOSEQUENCE_H
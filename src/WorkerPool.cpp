@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "Tetris.h"
+#include "WorkerPool.h"
+
+const size_t WorkerPool::MAX_JOBS_PER_WORKER = 4;
+
+const int WorkerPool::WAIT_FOR_WORKERS = 60;
+
+WorkerPool::WorkerPool(const std::string& address, const Learn::LearningParameters& params,
+                       const TetrisParameters& tetrisParams) : address(address), listener(address),
+                       timeout(tetrisParams.workerTimeout), nbConnectedWorkers(0),
+                       lastWorkerTime(std::chrono::steady_clock::now()) {
+    this->hello = {PROTOCOL_VERSION, (uint64_t)Tetris<>::WIDTH, (uint64_t)Tetris<>::HEIGHT,
+                   (uint64_t)tetrisParams.actionMode, (uint64_t)tetrisParams.randomizer,
+                   (uint64_t)tetrisParams.observation, params.nbIterationsPerPolicyEvaluation,
+                   params.maxNbActionsPerEval, params.nbRegisters, params.nbProgramConstant};
+}
+
+WorkerPool::~WorkerPool() {
+    // Workers exit when their connection is closed
+    this->workers.clear();
+
+#ifndef _WIN32
+    for(int pid : this->localWorkers)
+        waitpid(pid, nullptr, 0);
+#endif
+}
+
+void WorkerPool::spawnLocalWorkers(const std::string& executable, uint64_t nbWorkers) {
+#ifndef _WIN32
+    for(uint64_t i = 0; i < nbWorkers; i++){
+        int pid = fork();
+        if(pid < 0)
+            throw std::runtime_error("Can't start local worker : " + std::string(strerror(errno)) + ".");
+
+        if(pid == 0){
+            execlp(executable.c_str(), executable.c_str(), "--worker", this->address.c_str(), (char*)nullptr);
+            std::cerr << "Can't start local worker " << executable << " : " << strerror(errno) << std::endl;
+            _exit(1);
+        }
+
+        this->localWorkers.push_back(pid);
+    }
+#else
+    throw std::runtime_error("Local workers are not supported on this system.");
+#endif
+}
+
+const std::string& WorkerPool::getAddress() const {
+    return this->address;
+}
+
+void WorkerPool::acceptWorkers(const std::vector<uint64_t>* graphMessage) {
+    for(std::unique_ptr<MessageSocket> socket = this->listener.accept(); socket != nullptr;
+        socket = this->listener.accept()){
+        try {
+            socket->send((uint64_t)WorkerMessage::HELLO, this->hello);
+            if(graphMessage != nullptr)
+                socket->send((uint64_t)WorkerMessage::GRAPH, *graphMessage);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Can't set up new worker : " << e.what() << std::endl;
+            continue;
+        }
+
+        this->workers.push_back({this->nbConnectedWorkers++, std::move(socket), {}});
+        std::cout << "Worker " << this->workers.back().id << " connected, " << this->workers.size()
+                  << " workers" << std::endl;
+    }
+}
+
+void WorkerPool::dropWorker(size_t index, std::deque<size_t>& pendingJobs, const std::string& reason) {
+    Worker& worker = this->workers[index];
+    std::cerr << "Worker " << worker.id << " dropped (" << reason << "), " << worker.jobs.size()
+              << " roots to evaluate again" << std::endl;
+
+    for(auto job = worker.jobs.rbegin(); job != worker.jobs.rend(); job++)
+        pendingJobs.push_front(job->index);
+    this->workers.erase(this->workers.begin() + index);
+}
+
+std::vector<RemoteEvaluation> WorkerPool::evaluate(const std::vector<uint64_t>& graph, uint64_t generationNumber,
+                                                   Learn::LearningMode mode, const std::vector<uint64_t>& roots) {
+    std::vector<RemoteEvaluation> evaluations(roots.size());
+    if(roots.empty())
+        return evaluations;
+
+    std::vector<uint64_t> graphMessage = {generationNumber, (uint64_t)mode};
+    graphMessage.insert(graphMessage.end(), graph.begin(), graph.end());
+
+    // Workers connected since the previous evaluation get the graph with the others
+    acceptWorkers(nullptr);
+    for(size_t w = this->workers.size(); w-- > 0;){
+        try {
+            this->workers[w].socket->send((uint64_t)WorkerMessage::GRAPH, graphMessage);
+        }
+        catch (const std::runtime_error& e) {
+            std::deque<size_t> noJobs;
+            dropWorker(w, noJobs, e.what());
+        }
+    }
+
+    std::deque<size_t> pendingJobs;
+    for(size_t i = 0; i < roots.size(); i++)
+        pendingJobs.push_back(i);
+    size_t nbEvaluated = 0;
+
+    bool waiting = false;
+    std::vector<uint64_t> message;
+
+    while(nbEvaluated < roots.size()){
+        // Hands out jobs, in root order
+        for(size_t w = this->workers.size(); w-- > 0;){
+            Worker& worker = this->workers[w];
+            try {
+                while(worker.jobs.size() < MAX_JOBS_PER_WORKER && !pendingJobs.empty()){
+                    worker.socket->send((uint64_t)WorkerMessage::JOB, &roots[pendingJobs.front()], 1);
+                    worker.jobs.push_back({pendingJobs.front(), std::chrono::steady_clock::now()});
+                    pendingJobs.pop_front();
+                }
+            }
+            catch (const std::runtime_error& e) {
+                dropWorker(w, pendingJobs, e.what());
+            }
+        }
+
+        // Leaves the remaining roots to the caller when no worker shows up
+        if(this->workers.empty()){
+            if(!waiting)
+                std::cerr << "No worker connected, waiting for workers on " << this->address << std::endl;
+            waiting = true;
+            if(std::chrono::steady_clock::now() - this->lastWorkerTime > std::chrono::seconds(WAIT_FOR_WORKERS)){
+                std::cerr << "No worker connected, " << pendingJobs.size() << " roots evaluated locally" << std::endl;
+                break;
+            }
+        }
+        else {
+            this->lastWorkerTime = std::chrono::steady_clock::now();
+            waiting = false;
+        }
+
+#ifndef _WIN32
+        std::vector<pollfd> descriptors = {{this->listener.getDescriptor(), POLLIN, 0}};
+        for(const Worker& worker : this->workers)
+            descriptors.push_back({worker.socket->getDescriptor(), POLLIN, 0});
+
+        if(poll(descriptors.data(), descriptors.size(), 1000) < 0 && errno != EINTR)
+            throw std::runtime_error("Can't wait for workers : " + std::string(strerror(errno)) + ".");
+
+        // Results, from the last worker so that dropping one doesn't move the next ones
+        for(size_t w = this->workers.size(); w-- > 0;){
+            if(descriptors[w + 1].revents == 0)
+                continue;
+
+            Worker& worker = this->workers[w];
+            uint64_t type;
+            try {
+                if(!worker.socket->receive(type, message)){
+                    dropWorker(w, pendingJobs, "disconnected");
+                    continue;
+                }
+            }
+            catch (const std::runtime_error& e) {
+                dropWorker(w, pendingJobs, e.what());
+                continue;
+            }
+
+            if(type != (uint64_t)WorkerMessage::RESULT || message.size() != 5 || worker.jobs.empty()
+               || message[0] != roots[worker.jobs.front().index]){
+                dropWorker(w, pendingJobs, "unexpected message");
+                continue;
+            }
+
+            RemoteEvaluation& evaluation = evaluations[worker.jobs.front().index];
+            evaluation.done = true;
+            memcpy(&evaluation.score, &message[1], sizeof(double));
+            evaluation.nbEpisodes = message[2];
+            evaluation.nbInferences = message[3];
+            evaluation.nbSkippedInferences = message[4];
+            worker.jobs.pop_front();
+            nbEvaluated++;
+
+            // The worker only starts its next job now
+            if(!worker.jobs.empty())
+                worker.jobs.front().startTime = std::max(worker.jobs.front().startTime,
+                                                         std::chrono::steady_clock::now());
+        }
+
+        // Workers still connected but not answering, for instance hung or on an unreachable machine
+        if(this->timeout.count() > 0){
+            const auto now = std::chrono::steady_clock::now();
+            for(size_t w = this->workers.size(); w-- > 0;){
+                const Worker& worker = this->workers[w];
+                if(!worker.jobs.empty() && now - worker.jobs.front().startTime > this->timeout)
+                    dropWorker(w, pendingJobs, "timeout");
+            }
+        }
+
+        if(descriptors[0].revents != 0)
+            acceptWorkers(&graphMessage);
+#else
+        throw std::runtime_error("Workers are not supported on this system.");
+#endif
+    }
+
+    return evaluations;
+}
@@ -0,0 +1,177 @@
+#ifndef GEGELATI_TETRIS_WORKERPOOL_H
+#define GEGELATI_TETRIS_WORKERPOOL_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gegelati.h>
+
+#include "Socket.h"
+#include "TetrisParameters.h"
+
+/**
+ * \brief Messages exchanged between the training process and its workers.
+ *
+ * The training process sends HELLO when a worker connects, then a GRAPH at the beginning of each evaluation and
+ * JOB messages. The worker answers each JOB with a RESULT, in the same order.
+ */
+enum class WorkerMessage : uint64_t {
+    /// Protocol version, grid width and height, action mode, randomizer, observation, number of episodes per
+    /// evaluation, maximum number of frames per episode, number of registers and of program constants
+    HELLO,
+    /// Generation number, learning mode and checkpoint of the graph (see serializeCheckpoint())
+    GRAPH,
+    /// Index of the root to evaluate in the vertices of the graph
+    JOB,
+    /// Index of the root, bits of its mean score, number of episodes, of TPG executions and of skipped executions
+    RESULT
+};
+
+/// Evaluation of a root by a worker
+struct RemoteEvaluation {
+    /// Was the root evaluated by a worker
+    bool done = false;
+
+    /// Mean score of the played episodes
+    double score = 0;
+
+    uint64_t nbEpisodes = 0;
+    uint64_t nbInferences = 0;
+    uint64_t nbSkippedInferences = 0;
+};
+
+/**
+ * \brief Worker processes evaluating roots for the training process, connected through a socket.
+ *
+ * Workers are started with "tetris --worker <address>", on any machine reaching the address, or by
+ * spawnLocalWorkers(). They can connect at any time, and each one evaluates one root at a time. Jobs are handed out
+ * as workers return results, so fast and slow workers share the work.
+ *
+ * A worker that disconnects, for instance because its process died, or that doesn't return a result within the
+ * worker timeout, for instance because its process hangs or its machine is unreachable, is dropped and its pending
+ * jobs are handed out to the other workers. As the score of a root only depends on the graph, the root, the generation and the learning
+ * mode, results don't depend on which worker evaluated which root.
+ */
+class WorkerPool {
+public:
+
+    /// Version of the messages, checked by workers
+    static constexpr uint64_t PROTOCOL_VERSION = 2;
+
+    /**
+     * \brief Listens for workers.
+     *
+     * \param address address on which workers connect (see MessageSocket).
+     * \param params learning parameters, for the number of episodes and frames of evaluations.
+     * \param tetrisParams parameters of the Tetris environment played by workers, and worker timeout.
+     * \throws std::runtime_error if the address can't be listened on.
+     */
+    WorkerPool(const std::string& address, const Learn::LearningParameters& params,
+               const TetrisParameters& tetrisParams);
+
+    /// Destructor, disconnecting the workers, which then exit, and waiting for local workers.
+    ~WorkerPool();
+
+    /**
+     * \brief Starts worker processes on this machine.
+     *
+     * \param executable path of the training executable, started with "--worker <address>".
+     * \param nbWorkers number of workers to start.
+     * \throws std::runtime_error if a process can't be started.
+     */
+    void spawnLocalWorkers(const std::string& executable, uint64_t nbWorkers);
+
+    /**
+     * \brief Evaluates roots with the workers.
+     *
+     * When no worker was connected during the last WAIT_FOR_WORKERS seconds, the remaining roots are left to the
+     * caller.
+     *
+     * \param graph the graph, serialized with serializeCheckpoint().
+     * \param generationNumber generation of the evaluation, from which the episode seeds are drawn.
+     * \param mode learning mode of the evaluation.
+     * \param roots indexes of the roots to evaluate in the vertices of the graph.
+     * \return the evaluation of each root, not done for the roots left to the caller.
+     */
+    std::vector<RemoteEvaluation> evaluate(const std::vector<uint64_t>& graph, uint64_t generationNumber,
+                                           Learn::LearningMode mode, const std::vector<uint64_t>& roots);
+
+    /// Address on which workers connect.
+    const std::string& getAddress() const;
+
+private:
+
+    /// Number of jobs sent to a worker before its first result, hiding the network latency
+    static const size_t MAX_JOBS_PER_WORKER;
+
+    /// Number of seconds to wait for a worker before leaving the remaining roots to the caller
+    static const int WAIT_FOR_WORKERS;
+
+    /// Job sent to a worker
+    struct Job {
+        /// Index of the root in the roots being evaluated
+        size_t index;
+
+        /// Time from which the result is waited for : when the job was sent, or when the worker returned the
+        /// previous job if it was busy with it
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    /// Connected worker
+    struct Worker {
+        /// Number of the worker, in messages
+        uint64_t id;
+
+        std::unique_ptr<MessageSocket> socket;
+
+        /// Jobs sent to the worker, in order
+        std::deque<Job> jobs;
+    };
+
+    /// Address on which workers connect
+    std::string address;
+
+    /// Socket on which workers connect
+    SocketListener listener;
+
+    /// Content of the HELLO message
+    std::vector<uint64_t> hello;
+
+    /// Time a worker may take to return the result of a job, zero for no limit
+    std::chrono::seconds timeout;
+
+    /// Connected workers
+    std::vector<Worker> workers;
+
+    /// Number of workers connected so far
+    uint64_t nbConnectedWorkers;
+
+    /// Last time a worker was connected, workers being waited for up to WAIT_FOR_WORKERS seconds after it
+    std::chrono::steady_clock::time_point lastWorkerTime;
+
+    /// Process IDs of the local workers
+    std::vector<int> localWorkers;
+
+    /**
+     * \brief Accepts the pending connections of workers.
+     *
+     * \param graphMessage GRAPH message sent to the new workers, nullptr between evaluations.
+     */
+    void acceptWorkers(const std::vector<uint64_t>* graphMessage);
+
+    /**
+     * \brief Drops a worker, its jobs being handed out again.
+     *
+     * \param index index of the worker in workers.
+     * \param pendingJobs jobs not handed out yet, in which the jobs of the worker are put back first.
+     * \param reason message explaining why the worker is dropped.
+     */
+    void dropWorker(size_t index, std::deque<size_t>& pendingJobs, const std::string& reason);
+};
+
+
+#endif //GEGELATI_TETRIS_WORKERPOOL_H
@@ -1,9 +1,78 @@
 #include <cmath>
+#include <string>
 
 #include "instructions.h"
 #include "Tetris.h"
 
-void fillInstructionSet(Instructions::Set& set) {
+/**
+ * Fraction of the N values that are not empty tiles.
+ *
+ * Tiles are counted in independent lanes that the compiler can map to vector registers, the partial counts being
+ * exact whatever the order in which they are summed.
+ */
+template <int N>
+double density(const double values[N]) {
+    constexpr int LANES = 4;
+    double counts[LANES] = {0, 0, 0, 0};
+
+    int i = 0;
+    for(; i + LANES <= N; i += LANES){
+        for(int lane = 0; lane < LANES; lane++)
+            counts[lane] += (values[i + lane] > 0) ? 1.0 : 0.0;
+    }
+    for(; i < N; i++)
+        counts[0] += (values[i] > 0) ? 1.0 : 0.0;
+
+    return (counts[0] + counts[1] + counts[2] + counts[3]) / N;
+}
+
+/**
+ * Fraction of the N tiles of an occupancy plane that are occupied.
+ *
+ * Tiles are 0 or 1, so they are summed directly, a loop that release builds vectorize on bytes.
+ */
+template <int N>
+double occupancy(const uint8_t tiles[N]) {
+    int count = 0;
+    for(int i = 0; i < N; i++)
+        count += tiles[i];
+
+    return (double)count / N;
+}
+
+/// Fraction of the N tiles that are occupied in one plane or the other.
+template <int N>
+double occupancyUnion(const uint8_t tiles[N], const uint8_t others[N]) {
+    int count = 0;
+    for(int i = 0; i < N; i++)
+        count += tiles[i] | others[i];
+
+    return (double)count / N;
+}
+
+/// Adds instructions to an instruction set
+struct InstructionAdder {
+    Instructions::Set& set;
+
+    template <typename... Ts, class F>
+    void add(F function, const std::string& code) {
+        this->set.add(*(new Instructions::LambdaInstruction<Ts...>(function, code)));
+    }
+};
+
+/// Adds the batch counterparts of instructions to a batch instruction set, with the same functions
+struct BatchInstructionAdder {
+    BatchInstructionSet& set;
+
+    template <typename... Ts, class F>
+    void add(F function, const std::string&) {
+        this->set.add<Ts...>(function);
+    }
+};
+
+/// Adds the instructions of the observation, in the same order whatever the adder.
+template <int W, int H, class Adder>
+void addInstructions(Adder& adder, TetrisObservation observation) {
     auto minus = [](double a, double b) -> double { return a - b; };
     auto add = [](double a, double b) -> double { return a + b; };
     auto mult = [](double a, double b) -> double { return a * b; };
@@ -12,40 +81,84 @@ void fillInstructionSet(Instructions::Set& set) {
     auto exp = [](double a) -> double { return std::exp(a); };
     auto cos = [](double a) -> double { return std::cos(a); };
     auto lt = [](double a, double b) -> double { return a < b ? a : b; };
+    auto multByConst = [](double a, Data::Constant c) -> double { return a*(double)c; };
 
-    auto lineDensity = [](const double line[10]) -> double {
-        int count = 0;
-        for(int i = 0; i < 10; i++){
-            if(line[i] > 0)
-                count++;
-        }
+    // Registers and board features are doubles whatever the observation
+    adder.template add<double, double>(minus, "$0 = $1 - $2;");
+    adder.template add<double, double>(add, "$0 = $1 + $2;");
+    adder.template add<double, double>(mult, "$0 = $1 * $2;");
+    adder.template add<double, double>(div, "$0 = $1 / $2;");
+    adder.template add<double>(exp, "$0 = exp($1);");
+    adder.template add<double>(ln, "$0 = log($1);");
+    adder.template add<double>(cos, "$0 = cos($1);");
+    adder.template add<double, double>(lt, "$0 = $1 < $2 ? $1 : $2;");
 
-        return (double)count / 10.0;
-    };
+    // C templates of the line and column instructions, with the grid geometry baked in. Each line is enclosed in
+    // its own block, as a program may use the same instruction several times.
+    const std::string w = std::to_string(W);
+    const std::string h = std::to_string(H);
 
-    auto columnDensity = [](const double col[20][1]) -> double {
-        int count = 0;
-        for(int i = 0; i < 20; i++){
-            if(col[i][0] > 0)
-                count++;
-        }
+    if(observation == TetrisObservation::COLOURS){
+        // Lines are read in the grid, columns in its transposed copy, both as contiguous arrays. Columns are single
+        // lines of the transposed copy, so that their W addresses never straddle two columns.
+        auto lineDensity = [](const double line[W]) -> double { return density<W>(line); };
+        auto columnDensity = [](const double col[1][H]) -> double { return density<H>(col[0]); };
 
-        return (double)count / 20.0;
-    };
+        const std::string lineDensityCode = "{ int count = 0; for(int i = 0; i < " + w
+                + "; i++){ if($1[i] > 0) count++; } $0 = (double)count / " + w + "; }";
+        const std::string columnDensityCode = "{ int count = 0; for(int i = 0; i < " + h
+                + "; i++){ if($1[0][i] > 0) count++; } $0 = (double)count / " + h + "; }";
 
-    auto multByConst = [](double a, Data::Constant c) -> double { return a*(double)c; };
+        adder.template add<const double[W]>(lineDensity, lineDensityCode);
+        adder.template add<const double[1][H]>(columnDensity, columnDensityCode);
+    }
+    else {
+        // Lines are read in the locked or active planes, columns in the transposed locked plane, as single lines of
+        // it. The union of a locked line and of an active line tells how full the line would be once the tetromino
+        // locks.
+        auto lineOccupancy = [](const uint8_t line[W]) -> double { return occupancy<W>(line); };
+        auto columnOccupancy = [](const uint8_t col[1][H]) -> double { return occupancy<H>(col[0]); };
+        auto lineUnion = [](const uint8_t line[W], const uint8_t other[W]) -> double {
+            return occupancyUnion<W>(line, other);
+        };
+
+        const std::string lineOccupancyCode = "{ int count = 0; for(int i = 0; i < " + w
+                + "; i++){ count += $1[i]; } $0 = (double)count / " + w + "; }";
+        const std::string columnOccupancyCode = "{ int count = 0; for(int i = 0; i < " + h
+                + "; i++){ count += $1[0][i]; } $0 = (double)count / " + h + "; }";
+        const std::string lineUnionCode = "{ int count = 0; for(int i = 0; i < " + w
+                + "; i++){ count += $1[i] | $2[i]; } $0 = (double)count / " + w + "; }";
+
+        adder.template add<const uint8_t[W]>(lineOccupancy, lineOccupancyCode);
+        adder.template add<const uint8_t[1][H]>(columnOccupancy, columnOccupancyCode);
+        adder.template add<const uint8_t[W], const uint8_t[W]>(lineUnion, lineUnionCode);
+    }
+
+    adder.template add<double, Data::Constant>(multByConst, "$0 = $1 * (double)$2;");
+}
+
+template <int W, int H>
+void fillInstructionSet(Instructions::Set& set, TetrisObservation observation) {
+    InstructionAdder adder{set};
+    addInstructions<W, H>(adder, observation);
+}
 
+template <int W, int H>
+void fillBatchInstructionSet(BatchInstructionSet& batchSet, TetrisObservation observation) {
+    BatchInstructionAdder adder{batchSet};
+    addInstructions<W, H>(adder, observation);
+}
 
-    set.add(*(new Instructions::LambdaInstruction<double, double>(minus, "$0 = $1 - $2;")));
-    set.add(*(new Instructions::LambdaInstruction<double, double>(add, "$0 = $1 + $2;")));
-    set.add(*(new Instructions::LambdaInstruction<double, double>(mult, "$0 = $1 * $2;")));
-    set.add(*(new Instructions::LambdaInstruction<double, double>(div, "$0 = $1 / $2;")));
-    set.add(*(new Instructions::LambdaInstruction<double>(exp, "$0 = exp($1);")));
-    set.add(*(new Instructions::LambdaInstruction<double>(ln, "$0 = log($1);")));
-    set.add(*(new Instructions::LambdaInstruction<double>(cos, "$0 = cos($1);")));
-    set.add(*(new Instructions::LambdaInstruction<double, double>(lt, "$0 = $1 < $2 ? $1 : $2;")));
+template void fillInstructionSet<10, 20>(Instructions::Set& set, TetrisObservation observation);
+template void fillInstructionSet<12, 24>(Instructions::Set& set, TetrisObservation observation);
+template void fillInstructionSet<16, 32>(Instructions::Set& set, TetrisObservation observation);
 
-    set.add(*(new Instructions::LambdaInstruction<const double[10]>(lineDensity)));
-    set.add(*(new Instructions::LambdaInstruction<const double [20][1]>(columnDensity)));
-    set.add(*(new Instructions::LambdaInstruction<double, Data::Constant>(multByConst)));
-}
\ No newline at end of file
+template void fillBatchInstructionSet<10, 20>(BatchInstructionSet& batchSet, TetrisObservation observation);
+template void fillBatchInstructionSet<12, 24>(BatchInstructionSet& batchSet, TetrisObservation observation);
+template void fillBatchInstructionSet<16, 32>(BatchInstructionSet& batchSet, TetrisObservation observation);
+#if !((TETRIS_WIDTH == 10 && TETRIS_HEIGHT == 20) || (TETRIS_WIDTH == 12 && TETRIS_HEIGHT == 24) \
+    || (TETRIS_WIDTH == 16 && TETRIS_HEIGHT == 32))
+template void fillInstructionSet<TETRIS_WIDTH, TETRIS_HEIGHT>(Instructions::Set& set, TetrisObservation observation);
+template void fillBatchInstructionSet<TETRIS_WIDTH, TETRIS_HEIGHT>(BatchInstructionSet& batchSet,
+                                                                  TetrisObservation observation);
+#endif
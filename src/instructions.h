@@ -3,10 +3,28 @@
 
 #include <gegelati.h>
 
+#include "BatchExecutionEngine.h"
+#include "Tetris.h"
+
 /**
 * Fill the given instruction set.
+*
+* The line and column instructions match the observation of Tetris<W, H> : with colours, they take doubles from the
+* grid and its transposed copy, with occupancy they take uint8_t tiles from the occupancy planes. Columns are 1 * H
+* operands, one of the W lines of a transposed copy, rather than H tiles that may straddle two columns.
+* Every instruction has a C template, so that trained graphs can be turned into native code by the gegelati code
+* generator (see mainCodegen.cpp).
+*/
+template <int W = TETRIS_WIDTH, int H = TETRIS_HEIGHT>
+void fillInstructionSet(Instructions::Set& set, TetrisObservation observation = TetrisObservation::COLOURS);
+
+/**
+* Fill the given batch instruction set with the counterparts of the instructions of fillInstructionSet, in the same
+* order and with the same functions, for the BatchExecutionEngine.
 */
-void fillInstructionSet(Instructions::Set& set);
+template <int W = TETRIS_WIDTH, int H = TETRIS_HEIGHT>
+void fillBatchInstructionSet(BatchInstructionSet& batchSet,
+                             TetrisObservation observation = TetrisObservation::COLOURS);
 
 
 #endif //GEGELATI_TETRIS_INSTRUCTIONS_H
@@ -1,53 +1,144 @@
+#include <cinttypes>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <gegelati.h>
 
 #include "Tetris.h"
 #include "Render.h"
+#include "Episode.h"
+#include "AsyncDotExporter.h"
+#include "Checkpoint.h"
+#include "PolicySnapshot.h"
+#include "Profiler.h"
+#include "ReplayMailbox.h"
 #include "instructions.h"
+#include "TetrisParameters.h"
+#include "TetrisLearningAgent.h"
+#include "TetrisWorker.h"
+#include "WorkerPool.h"
+
+int main(int argc, char *argv[]){
+
+    // Command line : tetris [checkpoint] [--listen address] [--local-workers n], or tetris --worker address
+    std::string checkpointPath;
+    std::string listenAddress;
+    std::string workerAddress;
+    uint64_t nbLocalWorkers = 0;
+
+    for(int i = 1; i < argc; i++){
+        if(argv[i][0] != '-')
+            checkpointPath = argv[i];
+        else if(i + 1 < argc && strcmp(argv[i], "--listen") == 0)
+            listenAddress = argv[++i];
+        else if(i + 1 < argc && strcmp(argv[i], "--local-workers") == 0)
+            nbLocalWorkers = std::stoull(argv[++i]);
+        else if(i + 1 < argc && strcmp(argv[i], "--worker") == 0)
+            workerAddress = argv[++i];
+        else {
+            std::cerr << "Usage : " << argv[0] << " [checkpoint] [--listen address] [--local-workers n]" << std::endl
+                      << "        " << argv[0] << " --worker address" << std::endl;
+            return 1;
+        }
+    }
+
+    // Loads parameters from params.json
+    Learn::LearningParameters params;
+    File::ParametersParser::loadParametersFromJson(ROOT_DIR "/params.json", params);
 
-int main(){
+    // Worker process, evaluating roots for a training process
+    if(!workerAddress.empty())
+        return runWorker(workerAddress, params);
 
     std::cout << "Start Tetris learning application" << std::endl;
 
     /* === Learning environment and agent setup === */
 
-    // Loads the instruction set for the program
-    Instructions::Set set;
-    fillInstructionSet(set);
+    // Loads Tetris specific parameters from tetrisParams.json
+    TetrisParameters tetrisParams;
+    loadTetrisParametersFromJson(ROOT_DIR "/tetrisParams.json", tetrisParams);
 
-    // Loads parameters from params.json
-    Learn::LearningParameters params;
-    File::ParametersParser::loadParametersFromJson(ROOT_DIR "/params.json", params);
+    // Loads the instruction set for the program, matching the observation of the environment
+    Instructions::Set set;
+    fillInstructionSet(set, tetrisParams.observation);
 
     // Instantiates the learning environment
-    Tetris le;
-
-    std::cout << "Number of threads: " << params.nbThreads << std::endl;
+    Tetris<> le(tetrisParams.actionMode, tetrisParams.randomizer, tetrisParams.observation);
+
+    // Worker processes evaluating the roots, local workers connecting on a Unix socket by default
+    std::unique_ptr<WorkerPool> workerPool;
+    if(listenAddress.empty() && nbLocalWorkers > 0)
+        listenAddress = "unix:tetris_workers.sock";
+    if(!listenAddress.empty()){
+        // Racing depends on the order of the evaluations, which workers don't keep
+        tetrisParams.racing = false;
+        try {
+            workerPool = std::make_unique<WorkerPool>(listenAddress, params, tetrisParams);
+            workerPool->spawnLocalWorkers(argv[0], nbLocalWorkers);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Can't start workers : " << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "Roots evaluated by workers connecting on " << listenAddress << std::endl;
+    }
+    else
+        std::cout << "Number of threads: " << params.nbThreads << std::endl;
 
     // Instantiate and init the learning agent
-    Learn::ParallelLearningAgent la(le, set, params);
+    TetrisLearningAgent la(le, set, params, tetrisParams);
 //    Learn::LearningAgent la(le, set, params);
     la.init();
+    la.setWorkerPool(workerPool.get());
+
+    // Training state saved in checkpoints
+    Checkpoint checkpoint;
+    checkpoint.actionMode = tetrisParams.actionMode;
+    checkpoint.randomizer = tetrisParams.randomizer;
+    checkpoint.observation = tetrisParams.observation;
+    checkpoint.seed = la.getSeed();
+    uint64_t firstGeneration = 0;
+
+    // Resumes training from the checkpoint given on the command line
+    if(!checkpointPath.empty()){
+        try {
+            loadCheckpoint(checkpointPath, checkpoint, *la.getTPGGraph());
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Can't resume training : " << e.what() << std::endl;
+            return 1;
+        }
+
+        if(checkpoint.width != Tetris<>::WIDTH || checkpoint.height != Tetris<>::HEIGHT
+           || checkpoint.actionMode != tetrisParams.actionMode || checkpoint.randomizer != tetrisParams.randomizer
+           || checkpoint.observation != tetrisParams.observation){
+            std::cerr << "Can't resume training : the checkpoint was saved with another Tetris variant." << std::endl;
+            return 1;
+        }
 
-    const TPG::TPGVertex* bestRoot = nullptr;
+        la.setSeed(checkpoint.seed);
+        firstGeneration = checkpoint.generation + 1;
+        la.reseed(firstGeneration);
+        std::cout << "Resume training after generation " << checkpoint.generation << " (best game score : "
+                  << checkpoint.gameScoreRecord << ")" << std::endl;
+    }
 
     /* === Render environment for replays === */
 
+    std::atomic<bool> exitProgram = false; // (set to true by the replay thread when its window is closed)
+
 #ifndef NO_REPLAY
-    std::atomic<bool> exitProgram = true; // (set to false by other thread)
-    std::atomic<bool> resetDisplay = false;
-    std::atomic<uint64_t> generation = 0;
+    // Snapshots of the best policy of each generation, replayed by the replay thread
+    ReplayMailbox replayMailbox;
 
     int speedReplay = 30;   // in frames/seconds
 
-    std::thread replayThread(playFromRoot, std::ref(exitProgram), std::ref(resetDisplay), &bestRoot,
-                             std::ref(set), std::ref(le), std::ref(params), std::ref(generation), 0, speedReplay);
-
-    while(exitProgram); // replayThread will set exitProgram at false
-#else
-    std::atomic<bool> exitProgram = false;
+    std::thread replayThread(playFromRoot, std::ref(exitProgram), std::ref(replayMailbox), std::ref(set), le,
+                             std::ref(params), 0, speedReplay);
 #endif
     /* === Log logFile setup === */
 
@@ -62,14 +153,25 @@ int main(){
     else
         std::cerr << "Can't save logs, logFile opening failed" << std::endl;
 
-    // Create an exporter for all graphs
-    File::TPGGraphDotExporter dotExporter("out_0000.dot", *la.getTPGGraph());
+    // Per generation timers and counters, as configured in tetrisParams.json
+    ProfilerLogger profilerLogger(la);
+    if(tetrisParams.profile)
+        Profiler::start("profile.csv", tetrisParams.profileTrace ? "profile_trace.json" : "");
+
+    // Create an exporter writing copies of the graph in the background
+    AsyncDotExporter asyncDotExporter(tetrisParams.dotExportQueueSize);
+    double lastExportedScore = -std::numeric_limits<double>::infinity();
 
     // Logging best policy stat.
     std::ofstream stats;
     stats.open("bestPolicyStats.md");
     Log::LAPolicyStatsLogger policyStatsLogger(la, stats);
 
+    // Environment and execution engine recording the game of the best root of each generation
+    Tetris<> recordLE(le);
+    Environment recordEnv(set, recordLE.getDataSources(), params.nbRegisters, params.nbProgramConstant);
+    TPG::TPGExecutionEngine recordTee(recordEnv);
+
     // Export parameters before starting training.
     // These may differ from imported parameters because of LE or machine specific
     // settings such as thread count of number of actions.
@@ -77,31 +179,85 @@ int main(){
 
     /* === Training === */
 
-    for(int i = 0; i < params.nbGenerations && !exitProgram; i++){
+    for(uint64_t i = firstGeneration; i < params.nbGenerations && !exitProgram; i++){
+
+        ProfileScope generationScope(ProfilePhase::GENERATION);
+
+        // Export the graph of the current generation, as configured in tetrisParams.json
+        if(tetrisParams.dotExportInterval > 0 && i % tetrisParams.dotExportInterval == 0){
+            ProfileScope exportScope(ProfilePhase::DOT_EXPORT);
+            auto bestRoot = la.getBestRoot();
+            bool improved = bestRoot.second != nullptr && bestRoot.second->getResult() > lastExportedScore;
+            if(!tetrisParams.dotExportOnImprovement || improved){
+                char dotFile[40];
+                snprintf(dotFile, sizeof(dotFile), "out_%04" PRIu64 ".dot", i);
+                asyncDotExporter.push(std::make_unique<PolicySnapshot>(*la.getTPGGraph(), i), dotFile);
+                if(improved)
+                    lastExportedScore = bestRoot.second->getResult();
+            }
+        }
 
-        // Change name for exported TPG dot logFile for current generation
-        char buff[13];
-        sprintf(buff, "out_%04d.dot", i);
-        dotExporter.setNewFilePath(buff);
-        dotExporter.print();
+        // Tetromino sequences of the previous generation seeds won't be used anymore
+        TetrominoSequenceCache::clear();
 
         la.trainOneGeneration(i);
 
         std::cout << "Best game score : " << le.getGameScoreRecord() << "   Average number of forbidden moves : " << le.getAverageForbiddenMoves() << std::endl;
+        std::cout << "TPG inferences : " << la.getNbInferences() << "   Skipped inferences : " << la.getNbSkippedInferences() << std::endl;
+
+        // Saves a checkpoint every checkpointInterval generations, and after the last one
+        checkpoint.generation = i;
+        checkpoint.gameScoreRecord = le.getGameScoreRecord();
+        checkpoint.averageForbiddenMoves = le.getAverageForbiddenMoves();
+        if(tetrisParams.checkpointInterval > 0 && ((i + 1) % tetrisParams.checkpointInterval == 0
+                                                   || i + 1 == params.nbGenerations || exitProgram)){
+            ProfileScope checkpointScope(ProfilePhase::CHECKPOINT);
+            try {
+                saveCheckpoint("checkpoint.bin", checkpoint, *la.getTPGGraph(), la.getBestRoot().first);
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << "Can't save checkpoint : " << e.what() << std::endl;
+            }
+        }
+
         le.resetGlobalData();
+        la.resetInferenceCounters();
+        if(tetrisParams.racing)
+            std::cout << "Racing skipped episodes : " << la.getNbRacedEpisodes() << "   Saved frames : " << la.getNbSavedFrames() << std::endl;
+        if(tetrisParams.workStealing && workerPool == nullptr)
+            std::cout << "Idle tail : " << la.getIdleTail() << "s   Idle threads : " << 100 * la.getIdleRatio() << "%" << std::endl;
+
+        // Saves the game of the best root, played with the seed of the replays
+        if(tetrisParams.recordEpisodes){
+            ProfileScope recordScope(ProfilePhase::RECORD);
+            char episodeFile[40];
+            snprintf(episodeFile, sizeof(episodeFile), "out_%04" PRIu64 ".episode", i);
+            try {
+                recordEpisode(recordTee, *la.getBestRoot().first, recordLE, 0, Learn::LearningMode::VALIDATION,
+                              params.maxNbActionsPerEval).save(episodeFile);
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << "Can't save episode : " << e.what() << std::endl;
+            }
+        }
 
 #ifndef NO_REPLAY
-        generation = i;
+        // The replay thread gets its own copy of the best policy, training goes on without waiting for it
         if (!exitProgram){
-            bestRoot = la.getBestRoot().first;
-            resetDisplay = true;
-
-            while(resetDisplay);    // We let the Render use le to create a replay
+            ProfileScope replayScope(ProfilePhase::REPLAY_HANDOFF);
+            replayMailbox.post(std::make_unique<PolicySnapshot>(*la.getTPGGraph(), *la.getBestRoot().first, i));
         }
 #endif
 
+        generationScope.stop();
+        Profiler::endGeneration(i);
+
     }
 
+    // Wait for the pending exports
+    asyncDotExporter.close();
+    Profiler::stop();
+
     // Keep best policy
     la.keepBestPolicy();
 
@@ -109,7 +265,7 @@ int main(){
     la.getTPGGraph()->clearProgramIntrons();
 
     // Export the graph
-    dotExporter.setNewFilePath("out_best.dot");
+    File::TPGGraphDotExporter dotExporter("out_best.dot", *la.getTPGGraph());
     dotExporter.print();
 
     // Export stats on the best policy
@@ -122,11 +278,6 @@ int main(){
     bestStats.close();
     stats.close();
 
-    // Cleanup instructions
-    for (unsigned int i = 0; i < set.getNbInstructions(); i++) {
-        delete (&set.getInstruction(i));
-    }
-
     logFile.close();
 
 #ifndef NO_REPLAY
@@ -134,5 +285,10 @@ int main(){
     replayThread.join();
 #endif
 
+    // Cleanup instructions, once the replay thread no longer executes programs
+    for (unsigned int i = 0; i < set.getNbInstructions(); i++) {
+        delete (&set.getInstruction(i));
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gegelati.h>
+
+#include "Tetris.h"
+#include "AllocationCounter.h"
+#include "BatchExecutionEngine.h"
+#include "Checkpoint.h"
+#include "instructions.h"
+#include "ReplayExecutionEngine.h"
+#include "TetrisParameters.h"
+#include "TetrisPool.h"
+
+/// Results of the benchmarked operations, read so that the compiler can't remove them
+static volatile uint64_t sink = 0;
+
+/// Tetris environment giving access to the protected steps of the game
+class BenchTetris : public Tetris<> {
+public:
+    using Tetris<>::Tetris;
+    using Tetris<>::clearLines;
+    using Tetris<>::setTileAt;
+};
+
+/**
+ * \brief Runs op(i) for i in [0, nbOps), after op(i) for i in [0, nbWarmUpOps) that are not measured.
+ *
+ * \return the number of operations, their total time, the time, number of allocations and allocated bytes per
+ * operation.
+ */
+template <typename Op>
+Json::Value benchmark(const char* name, uint64_t nbOps, uint64_t nbWarmUpOps, Op op){
+    nbOps = std::max<uint64_t>(nbOps, 1);
+    std::cerr << "Running " << name << " (" << nbOps << " ops)" << std::endl;
+
+    for(uint64_t i = 0; i < nbWarmUpOps; i++)
+        op(i);
+
+    uint64_t allocations = AllocationCounter::getNbAllocations();
+    uint64_t bytes = AllocationCounter::getNbAllocatedBytes();
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < nbOps; i++)
+        op(i);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    allocations = AllocationCounter::getNbAllocations() - allocations;
+    bytes = AllocationCounter::getNbAllocatedBytes() - bytes;
+
+    Json::Value result;
+    result["ops"] = (Json::UInt64)nbOps;
+    result["seconds"] = seconds;
+    result["nsPerOp"] = seconds * 1e9 / nbOps;
+    result["opsPerSecond"] = nbOps / seconds;
+    result["allocationsPerOp"] = (double)allocations / nbOps;
+    result["bytesPerOp"] = (double)bytes / nbOps;
+    return result;
+}
+
+int main(int argc, char *argv[]){
+
+    // Benchmark setup, from the command line
+    std::string policyPath;     // Empty for a random graph
+    std::string outputPath;     // Empty for the standard output
+    double scale = 1;           // Factor applied to the number of operations of each benchmark
+
+    for(int i = 1; i < argc; i += 2){
+        if(i + 1 == argc){
+            std::cerr << "Usage : " << argv[0] << " [--policy checkpoint or dot file] [--output json file]"
+                      << " [--scale factor]" << std::endl;
+            return 1;
+        }
+
+        if(strcmp(argv[i], "--policy") == 0)
+            policyPath = argv[i + 1];
+        else if(strcmp(argv[i], "--output") == 0)
+            outputPath = argv[i + 1];
+        else if(strcmp(argv[i], "--scale") == 0)
+            scale = std::stod(argv[i + 1]);
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    auto nbOps = [scale](double nb){ return (uint64_t)(nb * scale); };
+
+    // Loads parameters from params.json
+    Learn::LearningParameters params;
+    File::ParametersParser::loadParametersFromJson(ROOT_DIR "/params.json", params);
+
+    // Loads Tetris specific parameters from tetrisParams.json, the action mode is the one of the policy
+    TetrisParameters tetrisParams;
+    loadTetrisParametersFromJson(ROOT_DIR "/tetrisParams.json", tetrisParams);
+
+    // Loads the instruction set for the program, matching the observation of the environment
+    Instructions::Set set;
+    fillInstructionSet(set, tetrisParams.observation);
+
+    // Environment benchmarks are played in frame mode, with fixed random actions
+    BenchTetris le(TetrisActionMode::FRAME, tetrisParams.randomizer, tetrisParams.observation);
+
+    std::mt19937 engine(0);
+    std::vector<uint64_t> actions(4096);
+    for(uint64_t& action : actions)
+        action = engine() % le.getNbActions();
+
+    // Mid-game state : the board after 2000 frames of random actions
+    le.reset(0);
+    for(uint64_t i = 0; i < 2000 && !le.isTerminal(); i++)
+        le.doAction(actions[i]);
+    const TetrisState<Tetris<>::WIDTH, Tetris<>::HEIGHT> midGame = le.saveState();
+
+    // Same state with its 4 bottom lines full, cleared by the clearLines benchmark
+    for(int y = Tetris<>::HEIGHT - 4; y < Tetris<>::HEIGHT; y++){
+        for(int x = 0; x < Tetris<>::WIDTH; x++)
+            le.setTileAt(x, y, 1);
+    }
+    const TetrisState<Tetris<>::WIDTH, Tetris<>::HEIGHT> fullLines = le.saveState();
+
+    /* === Environment benchmarks === */
+
+    Json::Value results;
+    results["width"] = Tetris<>::WIDTH;
+    results["height"] = Tetris<>::HEIGHT;
+    results["policy"] = policyPath.empty() ? "random" : policyPath;
+    Json::Value& benchmarks = results["benchmarks"];
+
+    benchmarks["reset"] = benchmark("reset", nbOps(200000), nbOps(20000), [&](uint64_t i){
+        le.reset(i % 64);
+    });
+
+    le.restoreState(midGame);
+    benchmarks["clone"] = benchmark("clone", nbOps(200000), nbOps(20000), [&](uint64_t){
+        delete le.clone();
+    });
+
+    benchmarks["acquire"] = benchmark("acquire", nbOps(200000), nbOps(20000), [&](uint64_t){
+        TetrisPool<>::Handle copy = TetrisPool<>::acquire(le);
+        sink = sink + copy->isTerminal();
+    });
+
+    benchmarks["checkActiveTetromino"] = benchmark("checkActiveTetromino", nbOps(10000000), nbOps(1000000),
+                                                   [&](uint64_t){
+        sink = sink + le.checkActiveTetromino();
+    });
+
+    benchmarks["restoreState"] = benchmark("restoreState", nbOps(1000000), nbOps(100000), [&](uint64_t){
+        le.restoreState(fullLines);
+    });
+
+    // The lines must be full again before each clear, so the time of restoreState is included
+    benchmarks["clearLines"] = benchmark("clearLines", nbOps(1000000), nbOps(100000), [&](uint64_t){
+        le.restoreState(fullLines);
+        le.clearLines();
+    });
+    benchmarks["clearLines"]["includesRestoreState"] = true;
+
+    // Games are reset with a new seed when they end
+    uint64_t nbGames = 0;
+    le.reset(nbGames);
+    benchmarks["doAction"] = benchmark("doAction", nbOps(10000000), nbOps(1000000), [&](uint64_t i){
+        if(le.isTerminal())
+            le.reset(++nbGames);
+        le.doAction(actions[i % actions.size()]);
+    });
+
+    le.reset(++nbGames);
+    benchmarks["rotate"] = benchmark("rotate", nbOps(10000000), nbOps(1000000), [&](uint64_t){
+        if(le.isTerminal())
+            le.reset(++nbGames);
+        le.doAction(2);
+    });
+
+    // Archive recordings of successive frames, kept as an archive would : packed copies made by the data sources,
+    // and full copies of the same arrays for comparison
+    auto fullCopy = [](const Data::DataHandler& dataSource) -> Data::DataHandler* {
+        if(auto grid = dynamic_cast<const Data::PrimitiveTypeArray2D<double>*>(&dataSource))
+            return new Data::PrimitiveTypeArray2D<double>(*grid);
+        if(auto plane = dynamic_cast<const Data::PrimitiveTypeArray2D<uint8_t>*>(&dataSource))
+            return new Data::PrimitiveTypeArray2D<uint8_t>(*plane);
+        return new Data::PrimitiveTypeArray<double>(dynamic_cast<const Data::PrimitiveTypeArray<double>&>(dataSource));
+    };
+    std::vector<Data::DataHandler*> recordings;
+    for(bool packed : {true, false}){
+        const char* name = packed ? "archiveRecording" : "archiveRecordingFullCopy";
+        le.reset(++nbGames);
+        benchmarks[name] = benchmark(name, nbOps(100000), 0, [&](uint64_t i){
+            if(le.isTerminal())
+                le.reset(++nbGames);
+            le.doAction(actions[i % actions.size()]);
+            for(const Data::DataHandler& dataSource : le.getDataSources())
+                recordings.push_back(packed ? dataSource.clone() : fullCopy(dataSource));
+        });
+        benchmarks[name]["includesDoAction"] = true;
+
+        for(Data::DataHandler* recording : recordings)
+            delete recording;
+        recordings.clear();
+    }
+
+    /* === Inference benchmarks === */
+
+    Tetris<> policyLE(tetrisParams.actionMode, tetrisParams.randomizer, tetrisParams.observation);
+    Environment env(set, policyLE.getDataSources(), params.nbRegisters, params.nbProgramConstant);
+    TPG::TPGGraph graph(env);
+    const TPG::TPGVertex* root;
+
+    if(!policyPath.empty()){
+        try {
+            root = loadPolicy(policyPath, env, graph);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    else {
+        // Initial graph of a training with seed 0, its first root being benchmarked
+        Mutator::RNG rng(0);
+        params.mutation.tpg.nbActions = policyLE.getNbActions();
+        Mutator::TPGMutator::initRandomTPG(graph, params.mutation, rng);
+        root = graph.getRootVertices().front();
+    }
+    TPG::TPGExecutionEngine tee(env);
+
+    policyLE.reset(0);
+    for(uint64_t i = 0; i < 20 && !policyLE.isTerminal(); i++)
+        policyLE.doAction(0);
+
+    benchmarks["executeFromRoot"] = benchmark("executeFromRoot", nbOps(200000), nbOps(20000), [&](uint64_t){
+        auto vertexList = tee.executeFromRoot(*root);
+        sink = sink + ((const TPG::TPGAction*)vertexList.back())->getActionID();
+    });
+
+    // Full episodes of the policy, the TPG being only executed when its observation changed. The previous benchmark
+    // warmed the execution engine up, and each episode has its own seed, so there is no warm-up.
+    uint64_t nbFrames = 0;
+    uint64_t nbDecisions = 0;
+    benchmarks["episode"] = benchmark("episode", nbOps(200), 0, [&](uint64_t i){
+        policyLE.reset(i, Learn::LearningMode::TESTING);
+
+        uint64_t actionID = 0;
+        uint64_t observationVersion = policyLE.getObservationVersion();
+        for(uint64_t frame = 0; frame < params.maxNbActionsPerEval && !policyLE.isTerminal(); frame++){
+            if(frame == 0 || policyLE.getObservationVersion() != observationVersion){
+                observationVersion = policyLE.getObservationVersion();
+                auto vertexList = tee.executeFromRoot(*root);
+                actionID = ((const TPG::TPGAction*)vertexList.back())->getActionID();
+                nbDecisions++;
+            }
+            policyLE.doAction(actionID);
+            nbFrames++;
+        }
+    });
+
+    Json::Value& episode = benchmarks["episode"];
+    episode["frames"] = (Json::UInt64)nbFrames;
+    episode["decisions"] = (Json::UInt64)nbDecisions;
+    episode["framesPerSecond"] = nbFrames / episode["seconds"].asDouble();
+    episode["decisionsPerSecond"] = nbDecisions / episode["seconds"].asDouble();
+
+    // Archive filled by episodes skipping unchanged observations, their recordings being replayed, and by the same
+    // episodes executing the TPG on every frame. Half the recordings are kept, so that the random number generator
+    // of the archives is used.
+    Archive skippingArchive(params.archiveSize, 0.5, 0);
+    Archive executingArchive(params.archiveSize, 0.5, 0);
+    {
+        TPG::TPGExecutionEngine archiveTee(env, &skippingArchive);
+        TPG::TPGExecutionEngine executingTee(env, &executingArchive);
+        ReplayExecutionEngine replayEngine(env, archiveTee);
+        for(uint64_t i = 0; i < 4; i++){
+            policyLE.reset(i, Learn::LearningMode::TESTING);
+            uint64_t actionID = 0;
+            uint64_t observationVersion = policyLE.getObservationVersion();
+            for(uint64_t frame = 0; frame < params.maxNbActionsPerEval && !policyLE.isTerminal(); frame++){
+                if(frame == 0 || policyLE.getObservationVersion() != observationVersion){
+                    observationVersion = policyLE.getObservationVersion();
+                    actionID = replayEngine.execute(*root);
+                }
+                else
+                    replayEngine.replayLastExecution();
+                policyLE.doAction(actionID);
+            }
+
+            policyLE.reset(i, Learn::LearningMode::TESTING);
+            for(uint64_t frame = 0; frame < params.maxNbActionsPerEval && !policyLE.isTerminal(); frame++){
+                auto vertexList = executingTee.executeFromRoot(*root);
+                policyLE.doAction(((const TPG::TPGAction*)vertexList.back())->getActionID());
+            }
+        }
+    }
+
+    uint64_t nbDivergentRecordings = 0;
+    for(size_t i = 0; i < std::max(skippingArchive.getNbRecordings(), executingArchive.getNbRecordings()); i++){
+        if(i >= skippingArchive.getNbRecordings() || i >= executingArchive.getNbRecordings()){
+            nbDivergentRecordings++;
+            continue;
+        }
+        const ArchiveRecording& skipping = skippingArchive.at(i);
+        const ArchiveRecording& executing = executingArchive.at(i);
+        if(skipping.prog != executing.prog || skipping.dataHash != executing.dataHash
+           || skipping.result != executing.result)
+            nbDivergentRecordings++;
+    }
+    Json::Value& archiveReplay = results["checks"]["archiveReplay"];
+    archiveReplay["recordings"] = (Json::UInt64)executingArchive.getNbRecordings();
+    archiveReplay["divergentRecordings"] = (Json::UInt64)nbDivergentRecordings;
+    if(nbDivergentRecordings > 0)
+        std::cerr << nbDivergentRecordings << " archive recordings differ when skipping executions" << std::endl;
+
+    // Lockstep execution of the root for games at different stages, each game having its own execution engine to
+    // check the actions of the lockstep execution
+    const size_t nbLockstepGames = 8;
+    BatchInstructionSet batchSet;
+    fillBatchInstructionSet(batchSet, tetrisParams.observation);
+
+    std::vector<TetrisPool<>::Handle> games;
+    std::vector<std::vector<std::reference_wrapper<const Data::DataHandler>>> dataSources;
+    std::vector<std::unique_ptr<Environment>> gameEnvs;
+    std::vector<std::unique_ptr<TPG::TPGExecutionEngine>> gameTees;
+    for(size_t g = 0; g < nbLockstepGames; g++){
+        games.push_back(TetrisPool<>::acquire(policyLE));
+        dataSources.push_back(games.back()->getDataSources());
+        gameEnvs.emplace_back(new Environment(set, dataSources.back(), params.nbRegisters, params.nbProgramConstant));
+        gameTees.emplace_back(new TPG::TPGExecutionEngine(*gameEnvs.back()));
+    }
+
+    uint64_t nbDivergentDecisions = 0;
+    try {
+        BatchExecutionEngine engine(env, batchSet, dataSources);
+        std::vector<size_t> lanes;
+        std::vector<uint64_t> actionIDs(nbLockstepGames, 0);
+
+        for(size_t g = 0; g < nbLockstepGames; g++){
+            games[g]->reset(g, Learn::LearningMode::TESTING);
+            for(uint64_t i = 0; i < 25 * g && !games[g]->isTerminal(); i++)
+                games[g]->doAction(actions[i % actions.size()]);
+            lanes.push_back(g);
+        }
+
+        benchmarks["executeFromRootLockstep"] = benchmark("executeFromRootLockstep", nbOps(200000 / nbLockstepGames),
+                                                          nbOps(20000 / nbLockstepGames), [&](uint64_t){
+            engine.executeFromRoot(*root, lanes, actionIDs);
+            sink = sink + actionIDs[0];
+        });
+        Json::Value& lockstep = benchmarks["executeFromRootLockstep"];
+        lockstep["games"] = (Json::UInt64)nbLockstepGames;
+        lockstep["nsPerDecision"] = lockstep["nsPerOp"].asDouble() / nbLockstepGames;
+
+        // Episodes played in lockstep, each decision being checked against executeFromRoot
+        uint64_t nbCheckedDecisions = 0;
+        std::vector<uint64_t> observationVersions(nbLockstepGames, 0);
+        for(size_t g = 0; g < nbLockstepGames; g++)
+            games[g]->reset(g, Learn::LearningMode::TESTING);
+
+        for(uint64_t frame = 0; frame < params.maxNbActionsPerEval; frame++){
+            lanes.clear();
+            bool playing = false;
+            for(size_t g = 0; g < nbLockstepGames; g++){
+                if(games[g]->isTerminal())
+                    continue;
+                playing = true;
+                if(frame == 0 || games[g]->getObservationVersion() != observationVersions[g]){
+                    observationVersions[g] = games[g]->getObservationVersion();
+                    lanes.push_back(g);
+                }
+            }
+            if(!playing)
+                break;
+
+            engine.executeFromRoot(*root, lanes, actionIDs);
+            for(size_t g : lanes){
+                auto vertexList = gameTees[g]->executeFromRoot(*root);
+                if(((const TPG::TPGAction*)vertexList.back())->getActionID() != actionIDs[g])
+                    nbDivergentDecisions++;
+                nbCheckedDecisions++;
+            }
+
+            for(size_t g = 0; g < nbLockstepGames; g++){
+                if(!games[g]->isTerminal())
+                    games[g]->doAction(actionIDs[g]);
+            }
+        }
+        lockstep["checkedDecisions"] = (Json::UInt64)nbCheckedDecisions;
+        lockstep["divergentDecisions"] = (Json::UInt64)nbDivergentDecisions;
+        if(nbDivergentDecisions > 0)
+            std::cerr << nbDivergentDecisions << " lockstep decisions differ from executeFromRoot" << std::endl;
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << "Can't execute the policy in lockstep : " << e.what() << std::endl;
+    }
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "  ";
+    if(outputPath.empty()){
+        std::cout << Json::writeString(writer, results) << std::endl;
+    }
+    else {
+        std::ofstream output(outputPath);
+        output << Json::writeString(writer, results) << std::endl;
+        if(!output){
+            std::cerr << "Can't write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+
+    // Cleanup instructions
+    for (unsigned int i = 0; i < set.getNbInstructions(); i++) {
+        delete (&set.getInstruction(i));
+    }
+
+    return (nbDivergentDecisions == 0 && nbDivergentRecordings == 0) ? 0 : 1;
+}
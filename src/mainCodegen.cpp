@@ -0,0 +1,64 @@
+#include <iostream>
+#include <stdexcept>
+
+#include <gegelati.h>
+
+#include "Tetris.h"
+#include "Checkpoint.h"
+#include "PolicySnapshot.h"
+#include "instructions.h"
+#include "TetrisParameters.h"
+
+int main(int argc, char *argv[]){
+
+    if(argc < 3){
+        std::cerr << "Usage : " << argv[0] << " <checkpoint or dot file> <output directory>" << std::endl;
+        return 1;
+    }
+
+    // Loads parameters from params.json
+    Learn::LearningParameters params;
+    File::ParametersParser::loadParametersFromJson(ROOT_DIR "/params.json", params);
+
+    // Loads Tetris specific parameters from tetrisParams.json, the action mode must be the one used for training
+    TetrisParameters tetrisParams;
+    loadTetrisParametersFromJson(ROOT_DIR "/tetrisParams.json", tetrisParams);
+
+    // Loads the instruction set for the program, matching the observation of the environment
+    Instructions::Set set;
+    fillInstructionSet(set, tetrisParams.observation);
+
+    Tetris<> le(tetrisParams.actionMode, tetrisParams.randomizer, tetrisParams.observation);
+
+    // Loads the policy
+    Environment env(set, le.getDataSources(), params.nbRegisters, params.nbProgramConstant);
+    TPG::TPGGraph graph(env);
+    const TPG::TPGVertex* root;
+    try {
+        root = loadPolicy(argv[1], env, graph);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // Only the policy of the best root is generated, the other roots of a dot file being dropped
+    PolicySnapshot policy(graph, *root, 0);
+
+    // Generates tetris_policy.c/h and tetris_policy_program.c/h in the output directory, the data sources being read
+    // by the generated code through the in1 (grid), in2 (features) and in3 (columns) pointers
+    std::string outputDirectory = std::string(argv[2]) + "/";
+    CodeGen::TPGGenerationEngineFactory factory(CodeGen::TPGGenerationEngineFactory::switchMode);
+    std::unique_ptr<CodeGen::TPGGenerationEngine> generator = factory.create("tetris_policy", policy.getGraph(),
+                                                                             outputDirectory);
+    generator->generateTPGGraph();
+
+    std::cout << "Policy of " << argv[1] << " generated in " << outputDirectory << std::endl;
+
+    // Cleanup instructions
+    for (unsigned int i = 0; i < set.getNbInstructions(); i++) {
+        delete (&set.getInstruction(i));
+    }
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gegelati.h>
+
+#include "Tetris.h"
+#include "BatchExecutionEngine.h"
+#include "Checkpoint.h"
+#include "instructions.h"
+#include "TetrisPool.h"
+#include "TetrisParameters.h"
+
+/// Result of a single evaluation game
+struct GameResult {
+    double score = 0;
+    int lines = 0;
+    int pieces = 0;
+    uint64_t frames = 0;
+    uint64_t decisions = 0;
+};
+
+/// Value at percentile p (in [0, 100]) of sorted values, rounded to the closest rank
+double percentile(const std::vector<double>& sortedValues, double p){
+    size_t rank = (size_t)(p / 100 * (sortedValues.size() - 1) + 0.5);
+    return sortedValues[std::min(rank, sortedValues.size() - 1)];
+}
+
+/// Mean, median, 5th and 95th percentiles of values
+Json::Value distribution(std::vector<double> values){
+    std::sort(values.begin(), values.end());
+
+    double sum = 0;
+    for(double value : values)
+        sum += value;
+
+    Json::Value stats;
+    stats["mean"] = sum / values.size();
+    stats["median"] = percentile(values, 50);
+    stats["p5"] = percentile(values, 5);
+    stats["p95"] = percentile(values, 95);
+    stats["min"] = values.front();
+    stats["max"] = values.back();
+    return stats;
+}
+
+int main(int argc, char *argv[]){
+
+    if(argc < 2){
+        std::cerr << "Usage : " << argv[0] << " <checkpoint or dot file> [--seeds n] [--first-seed s] [--threads t]"
+                  << " [--max-frames f] [--lockstep k]" << std::endl;
+        return 1;
+    }
+
+    // Evaluation setup, from the command line
+    std::string policyPath(argv[1]);
+    uint64_t nbSeeds = 1000;
+    uint64_t firstSeed = 0;
+    uint64_t nbThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t maxNbFrames = 0;   // 0 for the maxNbActionsPerEval of params.json
+    uint64_t nbLockstepGames = 1;   // Games played in lockstep by each thread
+
+    for(int i = 2; i + 1 < argc; i += 2){
+        uint64_t value = std::stoull(argv[i + 1]);
+        if(strcmp(argv[i], "--seeds") == 0)
+            nbSeeds = value;
+        else if(strcmp(argv[i], "--first-seed") == 0)
+            firstSeed = value;
+        else if(strcmp(argv[i], "--threads") == 0)
+            nbThreads = std::max<uint64_t>(value, 1);
+        else if(strcmp(argv[i], "--max-frames") == 0)
+            maxNbFrames = value;
+        else if(strcmp(argv[i], "--lockstep") == 0)
+            nbLockstepGames = std::max<uint64_t>(value, 1);
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if(nbSeeds == 0){
+        std::cerr << "At least one seed must be evaluated." << std::endl;
+        return 1;
+    }
+
+    // Loads parameters from params.json
+    Learn::LearningParameters params;
+    File::ParametersParser::loadParametersFromJson(ROOT_DIR "/params.json", params);
+    if(maxNbFrames == 0)
+        maxNbFrames = params.maxNbActionsPerEval;
+
+    // Loads Tetris specific parameters from tetrisParams.json, the action mode must be the one used for training
+    TetrisParameters tetrisParams;
+    loadTetrisParametersFromJson(ROOT_DIR "/tetrisParams.json", tetrisParams);
+
+    // Loads the instruction set for the program, matching the observation of the environment
+    Instructions::Set set;
+    fillInstructionSet(set, tetrisParams.observation);
+
+    // Learning environment cloned by each worker
+    Tetris<> le(tetrisParams.actionMode, tetrisParams.randomizer, tetrisParams.observation);
+
+    // Loads the policy
+    Environment env(set, le.getDataSources(), params.nbRegisters, params.nbProgramConstant);
+    TPG::TPGGraph graph(env);
+    const TPG::TPGVertex* root;
+    try {
+        root = loadPolicy(policyPath, env, graph);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // Batch instructions of the games played in lockstep
+    BatchInstructionSet batchSet;
+    if(nbLockstepGames > 1){
+        fillBatchInstructionSet(batchSet, tetrisParams.observation);
+        try {
+            BatchExecutionEngine engine(env, batchSet, {le.getDataSources()});
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Can't play games in lockstep : " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    /* === Evaluation === */
+
+    std::vector<GameResult> results(nbSeeds);
+    std::atomic<uint64_t> nextSeedIndex(0);
+
+    // Result of a finished game
+    auto setResult = [](const Tetris<>& game, GameResult& result){
+        TetrisState<Tetris<>::WIDTH, Tetris<>::HEIGHT> state = game.saveState();
+        result.score = game.getScore();
+        result.lines = state.gameScore;
+        result.pieces = state.nbPlayedTetrominos;
+        result.frames = state.nbPlayedFrames;
+    };
+
+    // Each worker plays games on its own environment with its own execution engine, seeds being handed out one
+    // at a time
+    auto worker = [&](){
+        Tetris<> workerLE(le);
+        Environment workerEnv(set, workerLE.getDataSources(), params.nbRegisters, params.nbProgramConstant);
+        TPG::TPGExecutionEngine tee(workerEnv);
+
+        for(uint64_t i = nextSeedIndex++; i < nbSeeds; i = nextSeedIndex++){
+            GameResult& result = results[i];
+            workerLE.reset(firstSeed + i, Learn::LearningMode::TESTING);
+
+            uint64_t actionID = 0;
+            uint64_t observationVersion = workerLE.getObservationVersion();
+            for(uint64_t frame = 0; frame < maxNbFrames && !workerLE.isTerminal(); frame++){
+                // The TPG is only executed when its observation changed, its action being the same otherwise
+                if(frame == 0 || workerLE.getObservationVersion() != observationVersion){
+                    observationVersion = workerLE.getObservationVersion();
+                    auto vertexList = tee.executeFromRoot(*root);
+                    actionID = ((const TPG::TPGAction*)vertexList.back())->getActionID();
+                    result.decisions++;
+                }
+                workerLE.doAction(actionID);
+            }
+
+            setResult(workerLE, result);
+        }
+    };
+
+    // Same games, nbLockstepGames at a time, executing the TPG for all of them at once. A game that ends is replaced
+    // with the next seed, so that all games keep playing until the seeds run out.
+    auto lockstepWorker = [&](){
+        std::vector<TetrisPool<>::Handle> games;
+        std::vector<std::vector<std::reference_wrapper<const Data::DataHandler>>> dataSources;
+        for(uint64_t g = 0; g < nbLockstepGames; g++){
+            games.push_back(TetrisPool<>::acquire(le));
+            dataSources.push_back(games.back()->getDataSources());
+        }
+        BatchExecutionEngine engine(env, batchSet, dataSources);
+
+        std::vector<uint64_t> seedIndexes(nbLockstepGames, nbSeeds);
+        std::vector<uint64_t> frames(nbLockstepGames, 0);
+        std::vector<uint64_t> observationVersions(nbLockstepGames, 0);
+        std::vector<uint64_t> actionIDs(nbLockstepGames, 0);
+
+        // Starts the next game of a lane, false when there is no seed left
+        auto startGame = [&](size_t g){
+            while(true){
+                uint64_t i = nextSeedIndex++;
+                seedIndexes[g] = i;
+                if(i >= nbSeeds)
+                    return false;
+
+                games[g]->reset(firstSeed + i, Learn::LearningMode::TESTING);
+                frames[g] = 0;
+                if(maxNbFrames > 0 && !games[g]->isTerminal())
+                    return true;
+                setResult(*games[g], results[i]);
+            }
+        };
+
+        std::vector<size_t> playing;
+        for(size_t g = 0; g < nbLockstepGames; g++){
+            if(startGame(g))
+                playing.push_back(g);
+        }
+
+        std::vector<size_t> lanes;
+        while(!playing.empty()){
+            // The TPG is only executed for the games whose observation changed
+            lanes.clear();
+            for(size_t g : playing){
+                if(frames[g] == 0 || games[g]->getObservationVersion() != observationVersions[g]){
+                    observationVersions[g] = games[g]->getObservationVersion();
+                    lanes.push_back(g);
+                    results[seedIndexes[g]].decisions++;
+                }
+            }
+            engine.executeFromRoot(*root, lanes, actionIDs);
+
+            size_t nbPlaying = 0;
+            for(size_t g : playing){
+                games[g]->doAction(actionIDs[g]);
+                frames[g]++;
+                if(frames[g] < maxNbFrames && !games[g]->isTerminal()){
+                    playing[nbPlaying++] = g;
+                    continue;
+                }
+
+                setResult(*games[g], results[seedIndexes[g]]);
+                if(startGame(g))
+                    playing[nbPlaying++] = g;
+            }
+            playing.resize(nbPlaying);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    if(nbLockstepGames > 1){
+        for(uint64_t t = 1; t < std::min(nbThreads, nbSeeds); t++)
+            workers.emplace_back(lockstepWorker);
+        lockstepWorker();
+    }
+    else {
+        for(uint64_t t = 1; t < std::min(nbThreads, nbSeeds); t++)
+            workers.emplace_back(worker);
+        worker();
+    }
+    for(std::thread& thread : workers)
+        thread.join();
+
+    double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    /* === Statistics === */
+
+    std::vector<double> scores, lines, pieces;
+    uint64_t nbFrames = 0;
+    uint64_t nbDecisions = 0;
+    for(const GameResult& result : results){
+        scores.push_back(result.score);
+        lines.push_back(result.lines);
+        pieces.push_back(result.pieces);
+        nbFrames += result.frames;
+        nbDecisions += result.decisions;
+    }
+
+    Json::Value stats;
+    stats["policy"] = policyPath;
+    stats["nbGames"] = (Json::UInt64)nbSeeds;
+    stats["firstSeed"] = (Json::UInt64)firstSeed;
+    stats["maxNbFrames"] = (Json::UInt64)maxNbFrames;
+    stats["nbThreads"] = (Json::UInt64)std::min(nbThreads, nbSeeds);
+    stats["nbLockstepGames"] = (Json::UInt64)nbLockstepGames;
+    stats["score"] = distribution(scores);
+    stats["linesCleared"] = distribution(lines);
+    stats["piecesPlayed"] = distribution(pieces);
+    stats["frames"] = (Json::UInt64)nbFrames;
+    stats["decisions"] = (Json::UInt64)nbDecisions;
+    stats["seconds"] = duration;
+    stats["framesPerSecond"] = nbFrames / duration;
+    stats["decisionsPerSecond"] = nbDecisions / duration;
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "  ";
+    std::cout << Json::writeString(writer, stats) << std::endl;
+
+    // Cleanup instructions
+    for (unsigned int i = 0; i < set.getNbInstructions(); i++) {
+        delete (&set.getInstruction(i));
+    }
+
+    return 0;
+}
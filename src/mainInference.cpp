@@ -5,51 +5,52 @@
 
 #include "Tetris.h"
 #include "Render.h"
+#include "PolicySnapshot.h"
+#include "ReplayMailbox.h"
+#include "Checkpoint.h"
 #include "instructions.h"
+#include "TetrisParameters.h"
 #include <SFML/System.hpp>
 
 int main(int argc, char *argv[]){
 
     std::string dotFilePath(argv[1]);
-    std::cout << "Start Tetris TPG inference from dot file " << dotFilePath << std::endl;
+    std::cout << "Start Tetris TPG inference from file " << dotFilePath << std::endl;
 
     /* === Learning environment and agent setup === */
 
-    // Loads the instruction set for the program
-    Instructions::Set set;
-    fillInstructionSet(set);
-
     // Loads parameters from params.json
     Learn::LearningParameters params;
     File::ParametersParser::loadParametersFromJson(ROOT_DIR "/params.json", params);
 
+    // Loads Tetris specific parameters from tetrisParams.json, the action mode must be the one used for training
+    TetrisParameters tetrisParams;
+    loadTetrisParametersFromJson(ROOT_DIR "/tetrisParams.json", tetrisParams);
+
+    // Loads the instruction set for the program, matching the observation of the environment
+    Instructions::Set set;
+    fillInstructionSet(set, tetrisParams.observation);
+
     // Instantiates the learning environment
-    Tetris le;
+    Tetris<> le(tetrisParams.actionMode, tetrisParams.randomizer, tetrisParams.observation);
     size_t seed = 90;
 
-    // Loads graph from dot file
+    // Loads graph from a checkpoint (memory mapped) or from a dot file
     Environment dotEnv(set, le.getDataSources(), params.nbRegisters, params.nbProgramConstant);
     TPG::TPGGraph dotGraph(dotEnv);
-    File::TPGGraphDotImporter dot(dotFilePath.c_str(), dotEnv, dotGraph);
-    dot.importGraph();
 
-    // Prepares for inference
-    TPG::TPGExecutionEngine tee(dotEnv);
-    const TPG::TPGVertex* root(dotGraph.getRootVertices().back());
+    // Prepares for inference, with the best root of the checkpoint or the last root of the graph
+    const TPG::TPGVertex* root = loadPolicy(dotFilePath, dotEnv, dotGraph);
 
     // Loads Render and display setup
     int replaySpeed = 20;
 
-    std::atomic<bool> exitProgram = true; // (set to false by other thread)
-    std::atomic<bool> resetDisplay = false; // Not used here
-    std::atomic<uint64_t> generation = 0;   // Not used here
-
-    std::thread replayThread(playFromRoot, std::ref(exitProgram), std::ref(resetDisplay), &root,
-                             std::ref(set), std::ref(le), std::ref(params), std::ref(generation), seed, replaySpeed);
-
-    while(exitProgram); // replayThread will set exitProgram at false
+    std::atomic<bool> exitProgram = false; // (set to true by the replay thread when its window is closed)
+    ReplayMailbox replayMailbox;
+    replayMailbox.post(std::make_unique<PolicySnapshot>(dotGraph, *root, 0));
 
-    resetDisplay = true;
+    std::thread replayThread(playFromRoot, std::ref(exitProgram), std::ref(replayMailbox), std::ref(set), le,
+                             std::ref(params), seed, replaySpeed);
 
     replayThread.join();
 
@@ -0,0 +1,200 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <gegelati.h>
+
+#include "Tetris.h"
+#include "Checkpoint.h"
+#include "instructions.h"
+#include "TetrisParameters.h"
+
+// Policy generated by tetris_codegen from POLICY_FILE (see CMakeLists.txt)
+extern "C" {
+#include "tetris_policy.h"
+
+    /// Data sources read by the generated policy : the grid, the features and the columns of the environment
+    double* in1;
+    double* in2;
+    double* in3;
+}
+
+/// Actions played during a game and time spent choosing them
+struct Game {
+    std::vector<uint64_t> actions;
+    uint64_t decisions = 0;
+    double inferenceSeconds = 0;
+};
+
+/**
+ * \brief Plays a game, the policy choosing its actions through decide().
+ *
+ * As in the other targets, the policy is only executed when the observation changed, its action being the same
+ * otherwise.
+ */
+template <typename Decide>
+Game playGame(Tetris<>& le, uint64_t seed, uint64_t maxNbFrames, Decide decide){
+    Game game;
+    le.reset(seed, Learn::LearningMode::TESTING);
+
+    uint64_t actionID = 0;
+    uint64_t observationVersion = le.getObservationVersion();
+    for(uint64_t frame = 0; frame < maxNbFrames && !le.isTerminal(); frame++){
+        if(frame == 0 || le.getObservationVersion() != observationVersion){
+            observationVersion = le.getObservationVersion();
+            auto start = std::chrono::steady_clock::now();
+            actionID = decide();
+            game.inferenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            game.decisions++;
+        }
+        game.actions.push_back(actionID);
+        le.doAction(actionID);
+    }
+
+    return game;
+}
+
+/// Copies the values of a data source, the generated code reading plain arrays
+void copyDataSource(const Data::DataHandler& source, std::vector<double>& values){
+    for(size_t i = 0; i < values.size(); i++)
+        values[i] = *source.getDataAt(typeid(double), i).getSharedPointer<const double>();
+}
+
+int main(int argc, char *argv[]){
+
+    // Benchmark setup, from the command line
+    uint64_t nbSeeds = 100;
+    uint64_t firstSeed = 0;
+    uint64_t maxNbFrames = 0;   // 0 for the maxNbActionsPerEval of params.json
+
+    for(int i = 1; i < argc; i += 2){
+        if(i + 1 == argc){
+            std::cerr << "Usage : " << argv[0] << " [--seeds n] [--first-seed s] [--max-frames f]" << std::endl;
+            return 1;
+        }
+
+        uint64_t value = std::stoull(argv[i + 1]);
+        if(strcmp(argv[i], "--seeds") == 0)
+            nbSeeds = value;
+        else if(strcmp(argv[i], "--first-seed") == 0)
+            firstSeed = value;
+        else if(strcmp(argv[i], "--max-frames") == 0)
+            maxNbFrames = value;
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    // Loads parameters from params.json
+    Learn::LearningParameters params;
+    File::ParametersParser::loadParametersFromJson(ROOT_DIR "/params.json", params);
+    if(maxNbFrames == 0)
+        maxNbFrames = params.maxNbActionsPerEval;
+
+    // Loads Tetris specific parameters from tetrisParams.json, the action mode must be the one used for training
+    TetrisParameters tetrisParams;
+    loadTetrisParametersFromJson(ROOT_DIR "/tetrisParams.json", tetrisParams);
+
+    // Loads the instruction set for the program, matching the observation of the environment
+    Instructions::Set set;
+    fillInstructionSet(set, tetrisParams.observation);
+
+    // The harness feeds the generated code with double arrays
+    if(tetrisParams.observation != TetrisObservation::COLOURS){
+        std::cerr << "Native policies are only benchmarked with the colours observation." << std::endl;
+        return 1;
+    }
+
+    Tetris<> le(tetrisParams.actionMode, tetrisParams.randomizer, tetrisParams.observation);
+
+    // Loads the policy the native code was generated from, for the interpreted execution
+    Environment env(set, le.getDataSources(), params.nbRegisters, params.nbProgramConstant);
+    TPG::TPGGraph graph(env);
+    const TPG::TPGVertex* root;
+    try {
+        root = loadPolicy(POLICY_FILE, env, graph);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    TPG::TPGExecutionEngine tee(env);
+
+    // Arrays read by the native policy, filled from the data sources before each decision
+    const Data::DataHandler& gridSource = le.getDataSources()[0].get();
+    const Data::DataHandler& featuresSource = le.getDataSources()[1].get();
+    const Data::DataHandler& columnsSource = le.getDataSources()[2].get();
+    std::vector<double> grid(gridSource.getAddressSpace(typeid(double)));
+    std::vector<double> features(featuresSource.getAddressSpace(typeid(double)));
+    std::vector<double> columns(columnsSource.getAddressSpace(typeid(double)));
+    in1 = grid.data();
+    in2 = features.data();
+    in3 = columns.data();
+
+    auto interpreted = [&]() -> uint64_t {
+        auto vertexList = tee.executeFromRoot(*root);
+        return ((const TPG::TPGAction*)vertexList.back())->getActionID();
+    };
+
+    // The copy of the data sources is part of the cost of the native policy
+    auto native = [&]() -> uint64_t {
+        copyDataSource(gridSource, grid);
+        copyDataSource(featuresSource, features);
+        copyDataSource(columnsSource, columns);
+        return (uint64_t)inferenceTPG();
+    };
+
+    /* === Benchmark === */
+
+    uint64_t nbDecisions = 0;
+    uint64_t nbNativeDecisions = 0;
+    uint64_t nbDivergentGames = 0;
+    double interpretedSeconds = 0;
+    double nativeSeconds = 0;
+
+    for(uint64_t seed = firstSeed; seed < firstSeed + nbSeeds; seed++){
+        Game interpretedGame = playGame(le, seed, maxNbFrames, interpreted);
+        Game nativeGame = playGame(le, seed, maxNbFrames, native);
+
+        nbDecisions += interpretedGame.decisions;
+        nbNativeDecisions += nativeGame.decisions;
+        interpretedSeconds += interpretedGame.inferenceSeconds;
+        nativeSeconds += nativeGame.inferenceSeconds;
+
+        if(nativeGame.actions != interpretedGame.actions){
+            size_t frame = 0;
+            while(frame < nativeGame.actions.size() && frame < interpretedGame.actions.size()
+                  && nativeGame.actions[frame] == interpretedGame.actions[frame])
+                frame++;
+            std::cerr << "Seed " << seed << " : native policy diverged at frame " << frame << std::endl;
+            nbDivergentGames++;
+        }
+    }
+
+    Json::Value stats;
+    stats["policy"] = POLICY_FILE;
+    stats["nbGames"] = (Json::UInt64)nbSeeds;
+    stats["firstSeed"] = (Json::UInt64)firstSeed;
+    stats["maxNbFrames"] = (Json::UInt64)maxNbFrames;
+    stats["decisions"] = (Json::UInt64)nbDecisions;
+    stats["divergentGames"] = (Json::UInt64)nbDivergentGames;
+    stats["interpreted"]["seconds"] = interpretedSeconds;
+    stats["interpreted"]["decisionsPerSecond"] = nbDecisions / interpretedSeconds;
+    stats["native"]["seconds"] = nativeSeconds;
+    stats["native"]["decisionsPerSecond"] = nbNativeDecisions / nativeSeconds;
+    stats["speedup"] = interpretedSeconds / nativeSeconds;
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "  ";
+    std::cout << Json::writeString(writer, stats) << std::endl;
+
+    // Cleanup instructions
+    for (unsigned int i = 0; i < set.getNbInstructions(); i++) {
+        delete (&set.getInstruction(i));
+    }
+
+    return (nbDivergentGames == 0) ? 0 : 1;
+}
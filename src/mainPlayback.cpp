@@ -0,0 +1,91 @@
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <SFML/System.hpp>
+
+#include "Tetris.h"
+#include "Render.h"
+#include "Episode.h"
+
+/// Plays an episode on a W * H grid, displaying it at replaySpeed frames/seconds if replaySpeed > 0
+template <int W, int H>
+int playEpisode(const Episode& episode, int replaySpeed){
+    Tetris<W, H> le(episode.getActionMode(), episode.getRandomizer());
+    le.reset(episode.getSeed(), episode.getMode());
+
+    Render<W, H>* render = nullptr;
+    if(replaySpeed > 0){
+        render = new Render<W, H>(le);
+        render->initialise();
+    }
+
+    for(uint64_t actionID : episode.getActions()){
+        le.doAction(actionID);
+
+        if(render != nullptr){
+            render->update();
+            sf::sleep(sf::seconds(1.f / (float)replaySpeed));
+        }
+    }
+
+    if(render != nullptr){
+        render->close();
+        delete render;
+    }
+
+    std::cout << "Frames : " << episode.getActions().size() << "   Cleared lines : " << le.getGameScore()
+              << "   Game over : " << le.isTerminal() << std::endl;
+
+    if(le.getGameScore() != episode.getGameScore()){
+        std::cerr << "Replay diverged, " << episode.getGameScore() << " cleared lines were recorded." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/// Plays an episode with the compiled grid of the same size
+int playEpisode(const Episode& episode, int replaySpeed){
+    const int w = episode.getWidth();
+    const int h = episode.getHeight();
+
+    if(w == 10 && h == 20)
+        return playEpisode<10, 20>(episode, replaySpeed);
+    if(w == 12 && h == 24)
+        return playEpisode<12, 24>(episode, replaySpeed);
+    if(w == 16 && h == 32)
+        return playEpisode<16, 32>(episode, replaySpeed);
+    if(w == TETRIS_WIDTH && h == TETRIS_HEIGHT)
+        return playEpisode<TETRIS_WIDTH, TETRIS_HEIGHT>(episode, replaySpeed);
+
+    std::cerr << "No " << w << " * " << h << " grid compiled, configure with -DTETRIS_WIDTH=" << w
+              << " -DTETRIS_HEIGHT=" << h << "." << std::endl;
+    return 1;
+}
+
+int main(int argc, char *argv[]){
+
+    if(argc < 2){
+        std::cerr << "Usage : " << argv[0] << " <episode file> [--display [frames/seconds]]" << std::endl;
+        return 1;
+    }
+
+    // Replay speed, no display by default
+    int replaySpeed = 0;
+    if(argc > 2 && strcmp(argv[2], "--display") == 0)
+        replaySpeed = (argc > 3) ? atoi(argv[3]) : 30;
+
+    try {
+        Episode episode = Episode::load(argv[1]);
+
+        std::cout << "Playback of " << argv[1] << " : " << episode.getWidth() << " * " << episode.getHeight()
+                  << " grid, seed " << episode.getSeed() << std::endl;
+
+        return playEpisode(episode, replaySpeed);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
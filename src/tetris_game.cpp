@@ -9,7 +9,7 @@
 
 int main()
 {
-    Tetris game;
+    Tetris<> game;
     game.playSolo();
 
     return 0;